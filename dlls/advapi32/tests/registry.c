@@ -4534,6 +4534,50 @@ static void test_RegRenameKey(void)
     RegCloseKey(key);
 }
 
+static void test_enum_many_subkeys(void)
+{
+    char name[32], expect[32];
+    HKEY key, subkey;
+    DWORD size, i;
+    LSTATUS ret;
+
+    ret = RegCreateKeyExA(hkey_main, "ManySubkeys", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, NULL);
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+
+    /* create enough subkeys in reverse order to get them hashed */
+    for (i = 300; i > 0; i--)
+    {
+        sprintf(name, "subkey%03lu", i);
+        ret = RegCreateKeyExA(key, name, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &subkey, NULL);
+        ok(!ret, "Unexpected return value %ld.\n", ret);
+        RegCloseKey(subkey);
+    }
+    ret = RegDeleteKeyA(key, "subkey150");
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+    ret = RegRenameKey(key, L"subkey300", L"subkey000");
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+    ret = RegOpenKeyA(key, "SUBKEY123", &subkey);
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+    RegCloseKey(subkey);
+    ret = RegOpenKeyA(key, "subkey150", &subkey);
+    ok(ret == ERROR_FILE_NOT_FOUND, "Unexpected return value %ld.\n", ret);
+
+    for (i = 0; i < 299; i++)
+    {
+        sprintf(expect, "subkey%03lu", i < 150 ? i : i + 1);
+        size = sizeof(name);
+        ret = RegEnumKeyExA(key, i, name, &size, NULL, NULL, NULL, NULL);
+        ok(!ret, "%lu: Unexpected return value %ld.\n", i, ret);
+        ok(!strcmp(name, expect), "%lu: got %s, expected %s.\n", i, name, expect);
+    }
+    size = sizeof(name);
+    ret = RegEnumKeyExA(key, i, name, &size, NULL, NULL, NULL, NULL);
+    ok(ret == ERROR_NO_MORE_ITEMS, "Unexpected return value %ld.\n", ret);
+
+    delete_key(key);
+    RegCloseKey(key);
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -4575,6 +4619,7 @@ START_TEST(registry)
     test_EnumDynamicTimeZoneInformation();
     test_perflib_key();
     test_RegRenameKey();
+    test_enum_many_subkeys();
 
     /* cleanup */
     delete_key( hkey_main );
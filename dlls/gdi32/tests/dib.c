@@ -26,6 +26,7 @@
 #include "winbase.h"
 #include "wingdi.h"
 #include "winuser.h"
+#include "winreg.h"
 #include "wincrypt.h"
 #include "mmsystem.h" /* DIBINDEX */
 
@@ -3529,11 +3530,280 @@ static void test_simple_graphics(void)
     DeleteDC(mem_dc);
 }
 
+static DWORD blend_channel( DWORD dst, DWORD src, DWORD alpha )
+{
+    return ((dst & 0xff) * (255 - alpha) + 127) / 255 + src;
+}
+
+static DWORD blend_color( DWORD dst, DWORD src, DWORD alpha )
+{
+    return ((src & 0xff) * alpha + (dst & 0xff) * (255 - alpha) + 127) / 255;
+}
+
+/* reference AlphaBlend result for a 32-bpp pixel in a8r8g8b8 layout, channels may overflow */
+static DWORD blend_pixel( DWORD dst, DWORD src, BLENDFUNCTION blend, BOOL *overflow )
+{
+    DWORD a, r, g, b, alpha = blend.SourceConstantAlpha;
+
+    if (!(blend.AlphaFormat & AC_SRC_ALPHA))
+    {
+        *overflow = FALSE;
+        return (blend_color( dst, src, alpha ) | blend_color( dst >> 8, src >> 8, alpha ) << 8 |
+                blend_color( dst >> 16, src >> 16, alpha ) << 16 | blend_color( dst >> 24, src >> 24, alpha ) << 24);
+    }
+    b = ((src & 0xff) * alpha + 127) / 255;
+    g = (((src >> 8) & 0xff) * alpha + 127) / 255;
+    r = (((src >> 16) & 0xff) * alpha + 127) / 255;
+    a = ((src >> 24) * alpha + 127) / 255;
+    b = blend_channel( dst, b, a );
+    g = blend_channel( dst >> 8, g, a );
+    r = blend_channel( dst >> 16, r, a );
+    a = blend_channel( dst >> 24, a, a );
+    *overflow = (b > 255 || g > 255 || r > 255);
+    return b | g << 8 | r << 16 | a << 24;
+}
+
+static void test_alpha_blend_rows(void)
+{
+    static const BYTE alphas[] = { 255, 128, 1 };
+    static const DWORD bitfields[] = { 0x000000ff, 0x0000ff00, 0x00ff0000 };
+    char bmibuf[sizeof(BITMAPINFO) + 2 * sizeof(RGBQUAD)];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    DWORD *src_bits, *dst_bits, src[16], dst[16], expect, seed = 12345;
+    HBITMAP src_dib, dst_dib;
+    HDC src_dc, dst_dc;
+    BLENDFUNCTION blend;
+    BOOL overflow;
+    int i, j, k, width, fmt;
+
+    memset( bmibuf, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = 16;
+    bmi->bmiHeader.biHeight = -1;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biBitCount = 32;
+    bmi->bmiHeader.biCompression = BI_RGB;
+
+    src_dc = CreateCompatibleDC( 0 );
+    src_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    ok( src_dib != NULL, "CreateDIBSection failed\n" );
+    SelectObject( src_dc, src_dib );
+
+    for (fmt = 0; fmt < 2; fmt++)
+    {
+        /* BI_RGB is a8r8g8b8, the bitfields have red and blue swapped and no alpha */
+        if (fmt)
+        {
+            bmi->bmiHeader.biCompression = BI_BITFIELDS;
+            memcpy( bmi->bmiColors, bitfields, sizeof(bitfields) );
+        }
+        dst_dc = CreateCompatibleDC( 0 );
+        dst_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+        ok( dst_dib != NULL, "CreateDIBSection failed\n" );
+        SelectObject( dst_dc, dst_dib );
+
+        for (i = 0; i < ARRAY_SIZE(alphas) * 3; i++)
+        {
+            blend.BlendOp = AC_SRC_OVER;
+            blend.BlendFlags = 0;
+            blend.SourceConstantAlpha = alphas[i % ARRAY_SIZE(alphas)];
+            blend.AlphaFormat = i < ARRAY_SIZE(alphas) ? 0 : AC_SRC_ALPHA;
+
+            /* widths around the 4-pixel steps, at a destination offset that is not aligned */
+            for (width = 1; width <= 13; width++)
+            {
+                for (j = 0; j < 16; j++)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    src[j] = (seed >> 8) | (seed << 24);
+                    /* the last pass uses premultiplied sources, the others are allowed to overflow */
+                    if (i >= 2 * ARRAY_SIZE(alphas))
+                    {
+                        DWORD a = src[j] >> 24;
+                        src[j] = (a << 24) | ((src[j] >> 16) & 0xff) * a / 255 << 16 |
+                                 ((src[j] >> 8) & 0xff) * a / 255 << 8 | (src[j] & 0xff) * a / 255;
+                    }
+                    seed = seed * 1103515245 + 12345;
+                    dst[j] = (seed >> 8) | (seed << 24);
+                    if (fmt) dst[j] &= 0x00ffffff;
+                }
+                memcpy( src_bits, src, sizeof(src) );
+                memcpy( dst_bits, dst, sizeof(dst) );
+
+                GdiAlphaBlend( dst_dc, 3, 0, width, 1, src_dc, 1, 0, width, 1, blend );
+                GdiFlush();
+
+                for (j = 0; j < 16; j++)
+                {
+                    if (j < 3 || j >= 3 + width)
+                    {
+                        ok( dst_bits[j] == dst[j], "%u/%u/%u: pixel %u changed to %08lx\n",
+                            fmt, i, width, j, dst_bits[j] );
+                        continue;
+                    }
+                    k = j - 3 + 1;
+                    if (fmt)
+                    {
+                        DWORD d = (dst[j] & 0xff) << 16 | (dst[j] & 0xff00) | (dst[j] >> 16 & 0xff);
+                        expect = blend_pixel( d, src[k], blend, &overflow );
+                        expect = (expect & 0xff) << 16 | (expect & 0xff00) | (expect >> 16 & 0xff);
+                    }
+                    else expect = blend_pixel( dst[j], src[k], blend, &overflow );
+
+                    /* Windows may saturate the overflowing channels instead of carrying */
+                    ok( dst_bits[j] == expect || broken( overflow ),
+                        "%u/%u/%u: pixel %u %08lx + %08lx got %08lx expected %08lx\n",
+                        fmt, i, width, j, dst[j], src[k], dst_bits[j], expect );
+                }
+            }
+        }
+        DeleteDC( dst_dc );
+        DeleteObject( dst_dib );
+    }
+
+    DeleteDC( src_dc );
+    DeleteObject( src_dib );
+}
+
+static DWORD hash_bits( const DWORD *bits, unsigned int count )
+{
+    DWORD hash = 0x811c9dc5;
+    unsigned int i;
+
+    for (i = 0; i < count; i++) hash = (hash ^ bits[i]) * 0x01000193;
+    return hash;
+}
+
+/* run large solid, gradient and blend operations, return a hash of the result after each of them */
+static void draw_large_operations( DWORD hashes[3] )
+{
+    static const int width = 1024, height = 512;
+    char bmibuf[sizeof(BITMAPINFO)];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    TRIVERTEX vert[2] = {{ 1, 2, 0x1200, 0xff00, 0x3400, 0x8000 }, { 1021, 509, 0xee00, 0x0100, 0x9900, 0x4000 }};
+    GRADIENT_RECT rect = { 0, 1 };
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 200, AC_SRC_ALPHA };
+    DWORD *bits, *src_bits, seed = 1;
+    HBITMAP dib, src_dib;
+    HDC hdc, src_dc;
+    HBRUSH brush;
+    int i;
+
+    memset( bmibuf, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = width;
+    bmi->bmiHeader.biHeight = -height;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biBitCount = 32;
+    bmi->bmiHeader.biCompression = BI_RGB;
+
+    hdc = CreateCompatibleDC( 0 );
+    dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    ok( dib != NULL, "CreateDIBSection failed\n" );
+    SelectObject( hdc, dib );
+    src_dc = CreateCompatibleDC( 0 );
+    src_dib = CreateDIBSection( 0, bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    ok( src_dib != NULL, "CreateDIBSection failed\n" );
+    SelectObject( src_dc, src_dib );
+
+    for (i = 0; i < width * height; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        bits[i] = seed ^ (seed >> 16);
+        seed = seed * 1103515245 + 12345;
+        src_bits[i] = seed ^ (seed >> 16);
+    }
+
+    brush = CreateSolidBrush( RGB( 0x35, 0x9a, 0xc6 ));
+    SelectObject( hdc, brush );
+    PatBlt( hdc, 3, 1, 1000, 500, PATINVERT );
+    GdiFlush();
+    hashes[0] = hash_bits( bits, width * height );
+
+    GdiGradientFill( hdc, vert, 2, &rect, 1, GRADIENT_FILL_RECT_H );
+    GdiFlush();
+    hashes[1] = hash_bits( bits, width * height );
+
+    GdiAlphaBlend( hdc, 2, 3, 1019, 505, src_dc, 1, 1, 1019, 505, blend );
+    GdiFlush();
+    hashes[2] = hash_bits( bits, width * height );
+
+    DeleteDC( hdc );
+    DeleteDC( src_dc );
+    DeleteObject( dib );
+    DeleteObject( src_dib );
+    DeleteObject( brush );
+}
+
+static void test_large_operations_child( char **argv )
+{
+    DWORD hashes[3], expect;
+    int i;
+
+    draw_large_operations( hashes );
+    for (i = 0; i < 3; i++)
+    {
+        expect = strtoul( argv[3 + i], NULL, 16 );
+        ok( hashes[i] == expect, "%u: got hash %08lx, expected %08lx\n", i, hashes[i], expect );
+    }
+}
+
+/* Wine can split large operations into bands processed by several threads, check that the
+ * results are the same as when the operations run serially in the calling thread */
+static void test_large_operations(void)
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[MAX_PATH + 64];
+    DWORD hashes[3], disposition;
+    char **argv;
+    HKEY key;
+    LONG ret;
+
+    draw_large_operations( hashes );
+
+    ret = RegCreateKeyExA( HKEY_CURRENT_USER, "Software\\Wine\\GDI", 0, NULL, 0,
+                           KEY_SET_VALUE, NULL, &key, &disposition );
+    if (ret)
+    {
+        skip( "can't create GDI key, error %ld\n", ret );
+        return;
+    }
+    ret = RegSetValueExA( key, "DibThreads", 0, REG_SZ, (const BYTE *)"4", 2 );
+    ok( !ret, "RegSetValueExA failed, error %ld\n", ret );
+
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" dib large %08lx %08lx %08lx", argv[0], hashes[0], hashes[1], hashes[2] );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    ok( CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info ),
+        "CreateProcess failed, error %lu\n", GetLastError() );
+    wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+
+    RegDeleteValueA( key, "DibThreads" );
+    RegCloseKey( key );
+    if (disposition == REG_CREATED_NEW_KEY) RegDeleteKeyA( HKEY_CURRENT_USER, "Software\\Wine\\GDI" );
+}
+
 START_TEST(dib)
 {
+    char **argv;
+    int argc;
+
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 6 && !strcmp( argv[2], "large" ))
+    {
+        test_large_operations_child( argv );
+        return;
+    }
+
     CryptAcquireContextW(&crypt_prov, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
 
     test_simple_graphics();
+    test_alpha_blend_rows();
+    test_large_operations();
 
     CryptReleaseContext(crypt_prov, 0);
 }
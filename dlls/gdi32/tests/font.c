@@ -7589,6 +7589,71 @@ static void test_char_width(void)
     ReleaseDC(NULL, dc);
 }
 
+struct text_extent_thread_params
+{
+    HFONT hfont;
+    const WCHAR *str;
+    int len;
+    const INT *dxs;
+    LONG mismatches;
+};
+
+static DWORD WINAPI text_extent_thread( void *arg )
+{
+    struct text_extent_thread_params *params = arg;
+    INT dxs[64];
+    ABC abc[64];
+    HDC hdc = CreateCompatibleDC( 0 );
+    int i, j;
+
+    SelectObject( hdc, params->hfont );
+    for (i = 0; i < 50; i++)
+    {
+        GetTextExtentExPointW( hdc, params->str, params->len, 0, NULL, dxs, NULL );
+        GetCharABCWidthsW( hdc, 'a', 'z', abc );
+        for (j = 0; j < params->len; j++)
+            if (dxs[j] != params->dxs[j]) InterlockedIncrement( &params->mismatches );
+    }
+    DeleteDC( hdc );
+    return 0;
+}
+
+static void test_text_extent_threads(void)
+{
+    static const WCHAR str[] = L"The quick brown fox jumps over the lazy dog 0123456789";
+    struct text_extent_thread_params params;
+    HANDLE threads[4];
+    INT dxs[64];
+    LOGFONTA lf;
+    HDC hdc;
+    int i;
+
+    memset( &lf, 0, sizeof(lf) );
+    strcpy( lf.lfFaceName, "Tahoma" );
+    lf.lfHeight = -17;
+
+    hdc = CreateCompatibleDC( 0 );
+    params.hfont = CreateFontIndirectA( &lf );
+    ok( params.hfont != NULL, "CreateFontIndirect failed\n" );
+    SelectObject( hdc, params.hfont );
+    GetTextExtentExPointW( hdc, str, ARRAY_SIZE(str) - 1, 0, NULL, dxs, NULL );
+    DeleteDC( hdc );
+
+    params.str = str;
+    params.len = ARRAY_SIZE(str) - 1;
+    params.dxs = dxs;
+    params.mismatches = 0;
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        threads[i] = CreateThread( NULL, 0, text_extent_thread, &params, 0, NULL );
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        WaitForSingleObject( threads[i], INFINITE );
+        CloseHandle( threads[i] );
+    }
+    ok( !params.mismatches, "got %ld mismatching extents\n", params.mismatches );
+    DeleteObject( params.hfont );
+}
+
 static void test_GetCharacterPlacement_kerning(void)
 {
     LOGFONTA lf;
@@ -7848,6 +7913,7 @@ START_TEST(font)
     test_ttf_names();
     test_lang_names();
     test_char_width();
+    test_text_extent_threads();
     test_select_object();
 
     /* These tests should be last test until RemoveFontResource
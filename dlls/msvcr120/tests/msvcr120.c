@@ -1417,10 +1417,10 @@ static void test_StructuredTaskCollection(void)
 {
     HANDLE chore_start_evt, chore_evt1, chore_evt2;
     _StructuredTaskCollection task_coll;
-    struct chore chore1, chore2;
+    struct chore chore1, chore2, chores[64];
     DWORD main_thread_id;
     Context *context;
-    int status;
+    int i, status;
     DWORD ret;
     BOOL b;
 
@@ -1590,6 +1590,22 @@ static void test_StructuredTaskCollection(void)
     ok(status == 2, "_StructuredTaskCollection::_RunAndWait failed: %d\n", status);
     call_func1(p__StructuredTaskCollection_dtor, &task_coll);
 
+    /* test that all chores are executed when many are scheduled */
+    call_func2(p__StructuredTaskCollection_ctor, &task_coll, NULL);
+    for (i = 0; i < ARRAY_SIZE(chores); i++)
+    {
+        chore_ctor(&chores[i]);
+        call_func2(p__StructuredTaskCollection__Schedule, &task_coll, &chores[i].chore);
+    }
+    ok(task_coll.count == ARRAY_SIZE(chores), "Wrong chore count: %ld != %d\n",
+            task_coll.count, (int)ARRAY_SIZE(chores));
+
+    status = p__StructuredTaskCollection__RunAndWait(&task_coll, NULL);
+    ok(status == 1, "_StructuredTaskCollection::_RunAndWait failed: %d\n", status);
+    for (i = 0; i < ARRAY_SIZE(chores); i++)
+        ok(chores[i].executed, "Chore #%d was not executed\n", i);
+    call_func1(p__StructuredTaskCollection_dtor, &task_coll);
+
     CloseHandle(chore_start_evt);
     CloseHandle(chore_evt1);
     CloseHandle(chore_evt2);
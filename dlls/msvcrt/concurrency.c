@@ -27,6 +27,7 @@
 #include "wine/exception.h"
 #include "wine/list.h"
 #include "msvcrt.h"
+#include "cppexcept.h"
 #include "cxx.h"
 
 #if _MSVCR_VER >= 100
@@ -127,6 +128,12 @@ typedef struct Scheduler {
         void, (Scheduler*,void (__cdecl*)(void*),void*), (this,proc,data))
 #endif
 
+/* chores scheduled by the contexts running on a virtual processor */
+struct vproc_queue {
+    SRWLOCK lock;
+    struct list chores;
+};
+
 typedef struct {
     Scheduler scheduler;
     LONG ref;
@@ -137,7 +144,10 @@ typedef struct {
     int shutdown_size;
     HANDLE *shutdown_events;
     CRITICAL_SECTION cs;
-    struct list scheduled_chores;
+    struct vproc_queue *queues;
+    TP_POOL *pool;
+    TP_CALLBACK_ENVIRON env;
+    TP_WORK *chore_work;
 } ThreadScheduler;
 extern const vtable_ptr ThreadScheduler_vtable;
 
@@ -168,6 +178,8 @@ typedef struct
 } SpinWait;
 
 #define FINISHED_INITIAL 0x80000000
+#define STRUCTURED_TASK_COLLECTION_CANCELLED 0x2
+#define STRUCTURED_TASK_COLLECTION_STATUS_MASK 0x7
 typedef struct
 {
     void *unk1;
@@ -194,6 +206,13 @@ struct scheduled_chore {
     _UnrealizedChore *chore;
 };
 
+typedef enum
+{
+    TASK_COLLECTION_NOT_COMPLETE,
+    TASK_COLLECTION_SUCCESS,
+    TASK_COLLECTION_CANCELLED
+} _TaskCollectionStatus;
+
 /* keep in sync with msvcp90/msvcp90.h */
 typedef struct cs_queue
 {
@@ -864,19 +883,24 @@ static void remove_scheduled_chores(Scheduler *scheduler, const ExternalContextB
 {
     ThreadScheduler *tscheduler = (ThreadScheduler*)scheduler;
     struct scheduled_chore *sc, *next;
+    struct vproc_queue *queue;
+    unsigned int i;
 
     if (tscheduler->scheduler.vtable != &ThreadScheduler_vtable)
         return;
 
-    EnterCriticalSection(&tscheduler->cs);
-    LIST_FOR_EACH_ENTRY_SAFE(sc, next, &tscheduler->scheduled_chores,
-                             struct scheduled_chore, entry) {
-        if (sc->chore->task_collection->context == &context->context) {
-            list_remove(&sc->entry);
-            operator_delete(sc);
+    for (i = 0; i < tscheduler->virt_proc_no; i++) {
+        queue = &tscheduler->queues[i];
+        AcquireSRWLockExclusive(&queue->lock);
+        LIST_FOR_EACH_ENTRY_SAFE(sc, next, &queue->chores,
+                                 struct scheduled_chore, entry) {
+            if (sc->chore->task_collection->context == &context->context) {
+                list_remove(&sc->entry);
+                operator_delete(sc);
+            }
         }
+        ReleaseSRWLockExclusive(&queue->lock);
     }
-    LeaveCriticalSection(&tscheduler->cs);
 }
 
 static void ExternalContextBase_dtor(ExternalContextBase *this)
@@ -1211,11 +1235,17 @@ static void ThreadScheduler_dtor(ThreadScheduler *this)
     this->cs.DebugInfo->Spare[0] = 0;
     DeleteCriticalSection(&this->cs);
 
-    if (!list_empty(&this->scheduled_chores))
-        ERR("scheduled chore list is not empty\n");
-    LIST_FOR_EACH_ENTRY_SAFE(sc, next, &this->scheduled_chores,
-            struct scheduled_chore, entry)
-        operator_delete(sc);
+    CloseThreadpoolWork(this->chore_work);
+    CloseThreadpool(this->pool);
+
+    for(i=0; i<this->virt_proc_no; i++) {
+        if (!list_empty(&this->queues[i].chores))
+            ERR("scheduled chore list is not empty\n");
+        LIST_FOR_EACH_ENTRY_SAFE(sc, next, &this->queues[i].chores,
+                struct scheduled_chore, entry)
+            operator_delete(sc);
+    }
+    operator_delete(this->queues);
 }
 
 DEFINE_THISCALL_WRAPPER(ThreadScheduler_Id, 4)
@@ -1369,7 +1399,7 @@ void __thiscall ThreadScheduler_ScheduleTask_loc(ThreadScheduler *this,
     arg->scheduler = this;
     ThreadScheduler_Reference(this);
 
-    work = CreateThreadpoolWork(schedule_task_proc, arg, NULL);
+    work = CreateThreadpoolWork(schedule_task_proc, arg, &this->env);
     if(!work) {
         scheduler_resource_allocation_error e;
 
@@ -1419,9 +1449,20 @@ Scheduler* __thiscall ThreadScheduler_vector_dtor(ThreadScheduler *this, unsigne
     return &this->scheduler;
 }
 
+static void WINAPI chore_work_proc(PTP_CALLBACK_INSTANCE, void*, PTP_WORK);
+
+static void ThreadScheduler_ctor_cleanup(ThreadScheduler *this)
+{
+    this->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection(&this->cs);
+    operator_delete(this->queues);
+    SchedulerPolicy_dtor(&this->policy);
+}
+
 static ThreadScheduler* ThreadScheduler_ctor(ThreadScheduler *this,
         const SchedulerPolicy *policy)
 {
+    unsigned int i, min_concurrency, max_concurrency;
     SYSTEM_INFO si;
 
     TRACE("(%p)->()\n", this);
@@ -1442,7 +1483,39 @@ static ThreadScheduler* ThreadScheduler_ctor(ThreadScheduler *this,
     InitializeCriticalSection(&this->cs);
     this->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": ThreadScheduler");
 
-    list_init(&this->scheduled_chores);
+    this->queues = operator_new(this->virt_proc_no * sizeof(*this->queues));
+    for(i=0; i<this->virt_proc_no; i++) {
+        InitializeSRWLock(&this->queues[i].lock);
+        list_init(&this->queues[i].chores);
+    }
+
+    /* every scheduler gets its own pool so that its concurrency limits are honored */
+    if(!(this->pool = CreateThreadpool(NULL))) {
+        scheduler_resource_allocation_error e;
+        scheduler_resource_allocation_error_ctor_name(&e, NULL,
+                HRESULT_FROM_WIN32(GetLastError()));
+        ThreadScheduler_ctor_cleanup(this);
+        _CxxThrowException(&e, &scheduler_resource_allocation_error_exception_type);
+    }
+    min_concurrency = SchedulerPolicy_GetPolicyValue(&this->policy, MinConcurrency);
+    max_concurrency = SchedulerPolicy_GetPolicyValue(&this->policy, MaxConcurrency);
+    if(max_concurrency != -1)
+        SetThreadpoolThreadMaximum(this->pool, max_concurrency);
+    SetThreadpoolThreadMinimum(this->pool, min(min_concurrency, this->virt_proc_no));
+
+    memset(&this->env, 0, sizeof(this->env));
+    this->env.Version = 1;
+    this->env.Pool = this->pool;
+
+    this->chore_work = CreateThreadpoolWork(chore_work_proc, this, &this->env);
+    if(!this->chore_work) {
+        scheduler_resource_allocation_error e;
+        scheduler_resource_allocation_error_ctor_name(&e, NULL,
+                HRESULT_FROM_WIN32(GetLastError()));
+        CloseThreadpool(this->pool);
+        ThreadScheduler_ctor_cleanup(this);
+        _CxxThrowException(&e, &scheduler_resource_allocation_error_exception_type);
+    }
     return this;
 }
 
@@ -1873,8 +1946,20 @@ DEFINE_THISCALL_WRAPPER(_StructuredTaskCollection_ctor, 8)
 _StructuredTaskCollection* __thiscall _StructuredTaskCollection_ctor(
         _StructuredTaskCollection *this, /*_CancellationTokenState*/void *token)
 {
-    FIXME("(%p): stub\n", this);
-    return NULL;
+    TRACE("(%p %p)\n", this, token);
+
+    if (token)
+        FIXME("cancellation tokens not supported\n");
+
+    this->unk1 = NULL;
+    this->unk2 = 0x1fffffff;
+    this->unk3 = NULL;
+    this->context = NULL;
+    this->count = 0;
+    this->finished = FINISHED_INITIAL;
+    this->exception = NULL;
+    this->event = NULL;
+    return this;
 }
 
 #endif /* _MSVCR_VER >= 110 */
@@ -1900,6 +1985,53 @@ static ThreadScheduler *get_thread_scheduler_from_context(Context *context)
     return NULL;
 }
 
+static BOOL is_task_collection_canceled(_StructuredTaskCollection *this)
+{
+    return ((ULONG_PTR)this->exception & STRUCTURED_TASK_COLLECTION_CANCELLED) != 0;
+}
+
+/* Chores are pushed to the head of the queue of the virtual processor
+ * running the current context. A virtual processor pops its own chores
+ * from the head, and steals the oldest chores of other ones from the tail. */
+static struct vproc_queue *get_vproc_queue(ThreadScheduler *scheduler)
+{
+    ExternalContextBase *context = (ExternalContextBase*)try_get_current_context();
+    unsigned int id = 0;
+
+    if (context && context->context.vtable == &ExternalContextBase_vtable)
+        id = context->id;
+    return &scheduler->queues[id % scheduler->virt_proc_no];
+}
+
+static _UnrealizedChore *pick_chore(ThreadScheduler *scheduler)
+{
+    struct vproc_queue *queue = get_vproc_queue(scheduler);
+    unsigned int i, idx = queue - scheduler->queues;
+    struct list *entry = NULL;
+    struct scheduled_chore *sc;
+    _UnrealizedChore *chore;
+
+    for (i = 0; i < scheduler->virt_proc_no && !entry; i++)
+    {
+        queue = &scheduler->queues[(idx + i) % scheduler->virt_proc_no];
+        if (list_empty(&queue->chores))
+            continue;
+
+        AcquireSRWLockExclusive(&queue->lock);
+        entry = i ? list_tail(&queue->chores) : list_head(&queue->chores);
+        if (entry)
+            list_remove(entry);
+        ReleaseSRWLockExclusive(&queue->lock);
+    }
+    if (!entry)
+        return NULL;
+
+    sc = LIST_ENTRY(entry, struct scheduled_chore, entry);
+    chore = sc->chore;
+    operator_delete(sc);
+    return chore;
+}
+
 static void CALLBACK chore_wrapper_finally(BOOL normal, void *data)
 {
     _UnrealizedChore *chore = data;
@@ -1921,61 +2053,104 @@ static void CALLBACK chore_wrapper_finally(BOOL normal, void *data)
             new_finished = prev_finished + 1;
     } while (InterlockedCompareExchange(ptr, new_finished, prev_finished)
              != prev_finished);
+    RtlWakeAddressAll((const void *)ptr);
+}
+
+static void cancel_task_collection(_StructuredTaskCollection *this)
+{
+    ULONG_PTR exception;
+
+    do {
+        exception = (ULONG_PTR)this->exception;
+    } while (InterlockedCompareExchangePointer(&this->exception,
+                (void*)(exception | STRUCTURED_TASK_COLLECTION_CANCELLED),
+                (void*)exception) != (void*)exception);
+}
+
+/* Stores the first C++ exception thrown by a chore in the task collection,
+ * it's rethrown by _RunAndWait once all the chores have finished. */
+static LONG CALLBACK execute_chore_except(EXCEPTION_POINTERS *pexc, void *_data)
+{
+    _StructuredTaskCollection *task_collection = _data;
+    ULONG_PTR exception, new_exception;
+    exception_ptr *ptr;
+
+    if (pexc->ExceptionRecord->ExceptionCode != CXX_EXCEPTION)
+        return EXCEPTION_CONTINUE_SEARCH;
+
+    cancel_task_collection(task_collection);
+
+    ptr = operator_new(sizeof(*ptr));
+    exception_ptr_from_record(ptr, pexc->ExceptionRecord);
+
+    do {
+        exception = (ULONG_PTR)task_collection->exception;
+        if (exception & ~STRUCTURED_TASK_COLLECTION_STATUS_MASK) {
+            __ExceptionPtrDestroy(ptr);
+            operator_delete(ptr);
+            break;
+        }
+        new_exception = exception | (ULONG_PTR)ptr;
+    } while (InterlockedCompareExchangePointer(&task_collection->exception,
+                (void*)new_exception, (void*)exception) != (void*)exception);
+
+    return EXCEPTION_EXECUTE_HANDLER;
 }
 
 static void __cdecl chore_wrapper(_UnrealizedChore *chore)
 {
+    _StructuredTaskCollection *task_collection = chore->task_collection;
+
     TRACE("(%p)\n", chore);
 
     __TRY
     {
-        if (chore->chore_proc)
-            chore->chore_proc(chore);
+        __TRY
+        {
+            if (chore->chore_proc && !is_task_collection_canceled(task_collection))
+                chore->chore_proc(chore);
+        }
+        __EXCEPT_CTX(execute_chore_except, task_collection)
+        {
+        }
+        __ENDTRY
     }
     __FINALLY_CTX(chore_wrapper_finally, chore)
 }
 
-static void __cdecl _StructuredTaskCollection_scheduler_cb(void *data)
+static void WINAPI chore_work_proc(PTP_CALLBACK_INSTANCE instance, void *context, PTP_WORK work)
 {
-    ThreadScheduler *scheduler = (ThreadScheduler*)get_current_scheduler();
-    struct list *entry;
-    struct scheduled_chore *sc;
+    ThreadScheduler *scheduler = context;
     _UnrealizedChore *chore;
+    BOOL detach = FALSE;
 
     TRACE("(%p)\n", scheduler);
 
-    if (scheduler->scheduler.vtable != &ThreadScheduler_vtable)
-    {
-        ERR("unknown scheduler set\n");
-        return;
+    if (&scheduler->scheduler != get_current_scheduler()) {
+        ThreadScheduler_Attach(scheduler);
+        detach = TRUE;
     }
 
-    EnterCriticalSection(&scheduler->cs);
-    entry = list_head(&scheduler->scheduled_chores);
-    if (entry)
-        list_remove(entry);
-    LeaveCriticalSection(&scheduler->cs);
-    if (!entry)
-        return;
-
-    sc = LIST_ENTRY(entry, struct scheduled_chore, entry);
-    chore = sc->chore;
-    operator_delete(sc);
+    /* the chore may already have been picked by a waiting or stealing context */
+    if ((chore = pick_chore(scheduler)))
+        chore->chore_wrapper(chore);
 
-    chore->chore_wrapper(chore);
+    if (detach)
+        CurrentScheduler_Detach();
+    ThreadScheduler_Release(scheduler);
 }
 
-static bool schedule_chore(_StructuredTaskCollection *this,
-        _UnrealizedChore *chore, Scheduler **pscheduler)
+static void schedule_chore(_StructuredTaskCollection *this, _UnrealizedChore *chore)
 {
     struct scheduled_chore *sc;
+    struct vproc_queue *queue;
     ThreadScheduler *scheduler;
 
     if (chore->task_collection) {
         invalid_multiple_scheduling e;
         invalid_multiple_scheduling_ctor_str(&e, "Chore scheduled multiple times");
         _CxxThrowException(&e, &invalid_multiple_scheduling_exception_type);
-        return FALSE;
+        return;
     }
 
     if (!this->context)
@@ -1983,7 +2158,7 @@ static bool schedule_chore(_StructuredTaskCollection *this,
     scheduler = get_thread_scheduler_from_context(this->context);
     if (!scheduler) {
         ERR("unknown context or scheduler set\n");
-        return FALSE;
+        return;
     }
 
     sc = operator_new(sizeof(*sc));
@@ -1993,11 +2168,14 @@ static bool schedule_chore(_StructuredTaskCollection *this,
     chore->chore_wrapper = chore_wrapper;
     InterlockedIncrement(&this->count);
 
-    EnterCriticalSection(&scheduler->cs);
-    list_add_head(&scheduler->scheduled_chores, &sc->entry);
-    LeaveCriticalSection(&scheduler->cs);
-    *pscheduler = &scheduler->scheduler;
-    return TRUE;
+    queue = get_vproc_queue(scheduler);
+    AcquireSRWLockExclusive(&queue->lock);
+    list_add_head(&queue->chores, &sc->entry);
+    ReleaseSRWLockExclusive(&queue->lock);
+
+    /* released by chore_work_proc */
+    ThreadScheduler_Reference(scheduler);
+    SubmitThreadpoolWork(scheduler->chore_work);
 }
 
 #if _MSVCR_VER >= 110
@@ -2010,15 +2188,9 @@ void __thiscall _StructuredTaskCollection__Schedule_loc(
         _StructuredTaskCollection *this, _UnrealizedChore *chore,
         /*location*/void *placement)
 {
-    Scheduler *scheduler;
-
     TRACE("(%p %p %p)\n", this, chore, placement);
 
-    if (schedule_chore(this, chore, &scheduler))
-    {
-        call_Scheduler_ScheduleTask_loc(scheduler,
-                _StructuredTaskCollection_scheduler_cb, NULL, placement);
-    }
+    schedule_chore(this, chore);
 }
 
 #endif /* _MSVCR_VER >= 110 */
@@ -2030,15 +2202,9 @@ DEFINE_THISCALL_WRAPPER(_StructuredTaskCollection__Schedule, 8)
 void __thiscall _StructuredTaskCollection__Schedule(
         _StructuredTaskCollection *this, _UnrealizedChore *chore)
 {
-    Scheduler *scheduler;
-
     TRACE("(%p %p)\n", this, chore);
 
-    if (schedule_chore(this, chore, &scheduler))
-    {
-        call_Scheduler_ScheduleTask(scheduler,
-                _StructuredTaskCollection_scheduler_cb, NULL);
-    }
+    schedule_chore(this, chore);
 }
 
 /* ?_RunAndWait@_StructuredTaskCollection@details@Concurrency@@QAA?AW4_TaskCollectionStatus@23@PAV_UnrealizedChore@23@@Z */
@@ -2048,8 +2214,68 @@ void __thiscall _StructuredTaskCollection__Schedule(
 _StructuredTaskCollection__RunAndWait(
         _StructuredTaskCollection *this, _UnrealizedChore *chore)
 {
-    FIXME("(%p %p): stub!\n", this, chore);
-    return 1;
+    ThreadScheduler *scheduler;
+    _UnrealizedChore *picked;
+    LONG expected, finished;
+    ULONG_PTR exception;
+    exception_ptr *ep;
+    int status;
+
+    TRACE("(%p %p)\n", this, chore);
+
+    if (chore) {
+        if (chore->task_collection) {
+            invalid_multiple_scheduling e;
+            invalid_multiple_scheduling_ctor_str(&e, "Chore scheduled multiple times");
+            _CxxThrowException(&e, &invalid_multiple_scheduling_exception_type);
+        }
+
+        /* the main chore runs inline and doesn't count as a stolen chore */
+        chore->task_collection = this;
+        __TRY
+        {
+            if (chore->chore_proc && !is_task_collection_canceled(this))
+                chore->chore_proc(chore);
+        }
+        __EXCEPT_CTX(execute_chore_except, this)
+        {
+        }
+        __ENDTRY
+        chore->task_collection = NULL;
+    }
+
+    expected = this->count;
+    if (expected) {
+        scheduler = get_thread_scheduler_from_context(this->context);
+
+        /* help executing scheduled chores while waiting for the stolen ones */
+        for (;;) {
+            finished = this->finished;
+            if (finished != FINISHED_INITIAL && finished >= expected)
+                break;
+
+            if (scheduler && (picked = pick_chore(scheduler)))
+                picked->chore_wrapper(picked);
+            else
+                RtlWaitOnAddress((const void *)&this->finished, &finished, sizeof(finished), NULL);
+        }
+    }
+
+    status = is_task_collection_canceled(this) ? TASK_COLLECTION_CANCELLED : TASK_COLLECTION_SUCCESS;
+    exception = (ULONG_PTR)this->exception;
+    this->count = 0;
+    this->finished = FINISHED_INITIAL;
+    this->exception = NULL;
+
+    ep = (exception_ptr*)(exception & ~STRUCTURED_TASK_COLLECTION_STATUS_MASK);
+    if (ep) {
+        exception_ptr copy;
+
+        copy = *ep;
+        operator_delete(ep);
+        exception_ptr_rethrow_copy(&copy);
+    }
+    return status;
 }
 
 /* ?_Cancel@_StructuredTaskCollection@details@Concurrency@@QAAXXZ */
@@ -2059,7 +2285,9 @@ DEFINE_THISCALL_WRAPPER(_StructuredTaskCollection__Cancel, 4)
 void __thiscall _StructuredTaskCollection__Cancel(
         _StructuredTaskCollection *this)
 {
-    FIXME("(%p): stub!\n", this);
+    TRACE("(%p)\n", this);
+
+    cancel_task_collection(this);
 }
 
 /* ?_IsCanceling@_StructuredTaskCollection@details@Concurrency@@QAA_NXZ */
@@ -2069,8 +2297,8 @@ DEFINE_THISCALL_WRAPPER(_StructuredTaskCollection__IsCanceling, 4)
 bool __thiscall _StructuredTaskCollection__IsCanceling(
         _StructuredTaskCollection *this)
 {
-    FIXME("(%p): stub!\n", this);
-    return FALSE;
+    TRACE("(%p)\n", this);
+    return is_task_collection_canceled(this);
 }
 
 /* ??0critical_section@Concurrency@@QAE@XZ */
@@ -146,24 +146,9 @@ DWORD CDECL cxx_frame_handler( PEXCEPTION_RECORD rec, cxx_exception_frame* frame
                                const cxx_function_descr *descr,
                                catch_func_nested_frame* nested_frame ) DECLSPEC_HIDDEN;
 
-/* call a copy constructor */
+/* call a copy constructor, see exception_ptr.c */
 extern void call_copy_ctor( void *func, void *this, void *src, int has_vbase );
 
-__ASM_GLOBAL_FUNC( call_copy_ctor,
-                   "pushl %ebp\n\t"
-                   __ASM_CFI(".cfi_adjust_cfa_offset 4\n\t")
-                   __ASM_CFI(".cfi_rel_offset %ebp,0\n\t")
-                   "movl %esp, %ebp\n\t"
-                   __ASM_CFI(".cfi_def_cfa_register %ebp\n\t")
-                   "pushl $1\n\t"
-                   "movl 12(%ebp), %ecx\n\t"
-                   "pushl 16(%ebp)\n\t"
-                   "call *8(%ebp)\n\t"
-                   "leave\n"
-                   __ASM_CFI(".cfi_def_cfa %esp,4\n\t")
-                   __ASM_CFI(".cfi_same_value %ebp\n\t")
-                   "ret" );
-
 /* continue execution to the specified address after exception is caught */
 extern void DECLSPEC_NORETURN continue_after_catch( cxx_exception_frame* frame, void *addr );
 
@@ -81,7 +81,8 @@ struct block
     WORD block_size;   /* block size in multiple of ALIGNMENT */
     BYTE block_flags;
     BYTE tail_size;    /* unused size (used block) / high size bits (free block) */
-    DWORD magic;
+    WORD base_offset;  /* offset from the LFH group to the block data in multiple of ALIGNMENT */
+    WORD magic;
 };
 
 C_ASSERT( sizeof(struct block) == 8 );
@@ -92,6 +93,7 @@ C_ASSERT( sizeof(struct block) == 8 );
 #define BLOCK_FLAG_PREV_FREE   0x00000002
 #define BLOCK_FLAG_FREE_LINK   0x00000003
 #define BLOCK_FLAG_LARGE       0x00000004
+#define BLOCK_FLAG_LFH         0x00000008
 
 
 /* entry to link free blocks in free lists */
@@ -122,10 +124,11 @@ C_ASSERT( sizeof(ARENA_LARGE) == 4 * ALIGNMENT );
 #define ARENA_SIZE_MASK        (~3)
 
 /* Value for arena 'magic' field */
-#define ARENA_INUSE_MAGIC      0x455355
-#define ARENA_PENDING_MAGIC    0xbedead
-#define ARENA_FREE_MAGIC       0x45455246
-#define ARENA_LARGE_MAGIC      0x6752614c
+#define ARENA_INUSE_MAGIC      0x5355  /* 'US' */
+#define ARENA_PENDING_MAGIC    0xdead
+#define ARENA_FREE_MAGIC       0x4546  /* 'FE' */
+#define ARENA_LARGE_MAGIC      0x614c  /* 'La' */
+#define ARENA_GROUP_MAGIC      0x5247  /* 'GR' */
 
 #define ARENA_INUSE_FILLER     0x55
 #define ARENA_TAIL_FILLER      0xab
@@ -160,6 +163,46 @@ static const SIZE_T free_list_sizes[] =
 };
 #define HEAP_NB_FREE_LISTS (ARRAY_SIZE(free_list_sizes) + HEAP_NB_SMALL_FREE_LISTS)
 
+/* LFH bins are ALIGNMENT steps up to HEAP_LFH_LINEAR_MAX and HEAP_LFH_STEP steps above,
+ * so that the unused size of an LFH block always fits in its tail_size */
+#define HEAP_LFH_LINEAR_MAX      0x400
+#define HEAP_LFH_STEP            0x100
+#define HEAP_MAX_LFH_BLOCK_SIZE  0x4000
+#define HEAP_NB_BINS  (HEAP_LFH_LINEAR_MAX / ALIGNMENT + (HEAP_MAX_LFH_BLOCK_SIZE - HEAP_LFH_LINEAR_MAX) / HEAP_LFH_STEP)
+C_ASSERT( HEAP_LFH_STEP <= 0x100 );
+
+/* number of per-bin group slots that threads are spread over */
+#define HEAP_AFFINITY_COUNT      16
+
+/* HeapCompatibilityInformation values */
+#define HEAP_STD 0
+#define HEAP_LAL 1
+#define HEAP_LFH 2
+
+/* a group of LFH blocks of the same size, allocated as a single heap block */
+struct DECLSPEC_ALIGN(ALIGNMENT) group
+{
+    SLIST_ENTRY      entry;      /* entry in the bin free groups list */
+    struct heap     *heap;       /* heap the group belongs to */
+    LONG             free_bits;  /* one bit for each free block, and GROUP_FLAG_FREE */
+    UINT             bin;        /* index of the group bin */
+};
+
+#define GROUP_BLOCK_COUNT  31
+/* the group is full or being released, and is neither owned by a thread nor in its bin list */
+#define GROUP_FLAG_FREE    (1u << GROUP_BLOCK_COUNT)
+/* offset of the first block header from the group start, so that block data is aligned */
+#define GROUP_BLOCK_OFFSET (ROUND_SIZE( sizeof(struct group) + sizeof(struct block), ALIGNMENT - 1 ) - sizeof(struct block))
+
+/* a bin of LFH groups, all with blocks of the same size */
+struct bin
+{
+    LONG             count_alloc;  /* counters for LFH automatic activation */
+    LONG             count_freed;
+    LONG             enabled;      /* blocks of this size are allocated from LFH groups */
+    SLIST_HEADER     groups;       /* groups with free blocks */
+};
+
 typedef struct DECLSPEC_ALIGN(ALIGNMENT) tagSUBHEAP
 {
     SIZE_T __pad[sizeof(SIZE_T) / sizeof(DWORD)];
@@ -195,6 +238,9 @@ struct heap
     DWORD            magic;         /* Magic number */
     DWORD            pending_pos;   /* Position in pending free requests ring */
     struct block   **pending_free;  /* Ring buffer for pending free requests */
+    DWORD            compat_info;   /* HeapCompatibilityInformation / heap frontend type */
+    struct bin      *bins;          /* LFH bins, NULL if the heap cannot use LFH */
+    struct group   **affinity_groups; /* LFH groups reserved for each thread affinity and bin */
     RTL_CRITICAL_SECTION cs;
     struct entry     free_lists[HEAP_NB_FREE_LISTS];
     SUBHEAP          subheap;
@@ -220,6 +266,7 @@ C_ASSERT( offsetof(struct heap, subheap) <= COMMIT_MASK );
 #define HEAP_CHECKING_ENABLED 0x80000000
 
 static struct heap *process_heap;  /* main process heap */
+static LONG next_thread_affinity;  /* affinity to assign to the next thread using an LFH heap */
 
 /* check if memory range a contains memory range b */
 static inline BOOL contains( const void *a, SIZE_T a_size, const void *b, SIZE_T b_size )
@@ -314,6 +361,42 @@ static inline BOOL check_subheap( const SUBHEAP *subheap )
     return contains( &subheap->block, subheap->block_size, subheap + 1, subheap->data_size );
 }
 
+static inline UINT bin_from_block_size( SIZE_T block_size )
+{
+    if (block_size <= HEAP_LFH_LINEAR_MAX) return (block_size - 1) / ALIGNMENT;
+    return HEAP_LFH_LINEAR_MAX / ALIGNMENT + (block_size - HEAP_LFH_LINEAR_MAX - 1) / HEAP_LFH_STEP;
+}
+
+static inline SIZE_T bin_block_size( UINT bin )
+{
+    if (bin < HEAP_LFH_LINEAR_MAX / ALIGNMENT) return (bin + 1) * ALIGNMENT;
+    return HEAP_LFH_LINEAR_MAX + (bin + 1 - HEAP_LFH_LINEAR_MAX / ALIGNMENT) * HEAP_LFH_STEP;
+}
+
+static inline struct block *group_block( const struct group *group, SIZE_T block_size, UINT index )
+{
+    return (struct block *)((char *)group + GROUP_BLOCK_OFFSET + index * block_size);
+}
+
+static inline UINT group_block_index( const struct group *group, const struct block *block )
+{
+    return ((char *)block - (char *)group_block( group, 0, 0 )) / block_get_size( block );
+}
+
+/* return the group of an LFH block, or NULL if it isn't a valid LFH block of the heap */
+static struct group *block_get_group( const struct heap *heap, const struct block *block )
+{
+    const struct group *group = (struct group *)((char *)(block + 1) - block->base_offset * ALIGNMENT);
+    SIZE_T block_size;
+
+    if (!heap->bins || (ULONG_PTR)(block + 1) % ALIGNMENT || !(block_get_flags( block ) & BLOCK_FLAG_LFH)) return NULL;
+    if (block_get_type( (struct block *)group - 1 ) != ARENA_GROUP_MAGIC || group->heap != heap) return NULL;
+    if (group->bin >= HEAP_NB_BINS || (block_size = bin_block_size( group->bin )) != block_get_size( block )) return NULL;
+    if (group_block( group, block_size, group_block_index( group, block ) ) != block) return NULL;
+    if (group_block_index( group, block ) >= GROUP_BLOCK_COUNT) return NULL;
+    return (struct group *)group;
+}
+
 static BOOL heap_validate( const struct heap *heap );
 
 /* mark a block of memory as innacessible for debugging purposes */
@@ -1145,7 +1228,8 @@ static BOOL validate_used_block( const struct heap *heap, const SUBHEAP *subheap
 
     if ((ULONG_PTR)(block + 1) % ALIGNMENT)
         err = "invalid block alignment";
-    else if (block_get_type( block ) != ARENA_INUSE_MAGIC && block_get_type( block ) != ARENA_PENDING_MAGIC)
+    else if (block_get_type( block ) != ARENA_INUSE_MAGIC && block_get_type( block ) != ARENA_PENDING_MAGIC &&
+             block_get_type( block ) != ARENA_GROUP_MAGIC)
         err = "invalid block header";
     else if (block_get_flags( block ) & BLOCK_FLAG_FREE)
         err = "invalid block flags";
@@ -1191,6 +1275,26 @@ static BOOL validate_used_block( const struct heap *heap, const SUBHEAP *subheap
 }
 
 
+static BOOL validate_lfh_block( const struct heap *heap, const struct block *block )
+{
+    const char *err = NULL;
+
+    if (!block_get_group( heap, block ))
+        err = "invalid LFH block";
+    else if (block_get_type( block ) != ARENA_INUSE_MAGIC || (block_get_flags( block ) & BLOCK_FLAG_FREE))
+        err = "invalid block header";
+    else if (block->tail_size > block_get_size( block ) - sizeof(*block))
+        err = "invalid block unused size";
+
+    if (err)
+    {
+        ERR( "heap %p, block %p: %s\n", heap, block, err );
+        if (TRACE_ON(heap)) heap_dump( heap );
+    }
+
+    return !err;
+}
+
 static BOOL heap_validate_ptr( const struct heap *heap, const void *ptr, SUBHEAP **subheap )
 {
     const struct block *block = (struct block *)ptr - 1;
@@ -1206,6 +1310,7 @@ static BOOL heap_validate_ptr( const struct heap *heap, const void *ptr, SUBHEAP
         return validate_large_block( heap, block );
     }
 
+    if (block_get_flags( block ) & BLOCK_FLAG_LFH) return validate_lfh_block( heap, block );
     return validate_used_block( heap, *subheap, block );
 }
 
@@ -1271,6 +1376,8 @@ static inline struct block *unsafe_block_from_ptr( const struct heap *heap, cons
         err = "already freed block";
     else if (block_get_type( block ) != ARENA_INUSE_MAGIC)
         err = "invalid block header";
+    else if (block_get_flags( block ) & BLOCK_FLAG_LFH)
+        err = "invalid LFH block";
     else if (!contains( base, commit_end - base, block, block_get_size( block ) ))
         err = "invalid block size";
 
@@ -1278,6 +1385,30 @@ static inline struct block *unsafe_block_from_ptr( const struct heap *heap, cons
     return err ? NULL : block;
 }
 
+/* return the LFH group of a pointer, or NULL if it isn't an LFH block of the heap. The heap lock
+ * isn't needed: the block header is checked against its group header, which stays valid as
+ * long as one of the group blocks is allocated. Other blocks go through the locked checks. */
+static struct group *unsafe_group_from_ptr( struct heap *heap, ULONG flags, const void *ptr )
+{
+    const struct block *block = (const struct block *)ptr - 1;
+    struct group *group;
+    SUBHEAP *subheap;
+
+    if (!heap->bins || !ptr || (ULONG_PTR)ptr % ALIGNMENT) return NULL;
+    if (!(block_get_flags( block ) & BLOCK_FLAG_LFH)) return NULL;
+
+    if (heap_get_flags( heap, flags ) & HEAP_VALIDATE)
+    {
+        heap_lock( heap, flags );
+        if (!heap_validate_ptr( heap, ptr, &subheap ) || !subheap) group = NULL;
+        else group = block_get_group( heap, block );
+        heap_unlock( heap, flags );
+        return group;
+    }
+
+    return block_get_group( heap, block );
+}
+
 static DWORD heap_flags_from_global_flag( DWORD flag )
 {
     DWORD ret = 0;
@@ -1394,6 +1525,22 @@ HANDLE WINAPI RtlCreateHeap( ULONG flags, PVOID addr, SIZE_T totalSize, SIZE_T c
 
     heap_set_debug_flags( heap );
 
+    /* LFH is only used for growable, serialized heaps without debugging features */
+    if ((heap->flags & HEAP_GROWABLE) && !(heap->flags & HEAP_NO_SERIALIZE) && !heap->shared &&
+        !(heap->flags & (HEAP_VALIDATE | HEAP_VALIDATE_ALL | HEAP_VALIDATE_PARAMS | HEAP_CHECKING_ENABLED |
+                         HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED | HEAP_ADD_USER_INFO)) &&
+        !heap->pending_free)
+    {
+        SIZE_T size = HEAP_NB_BINS * (sizeof(*heap->bins) + HEAP_AFFINITY_COUNT * sizeof(*heap->affinity_groups));
+        void *bins = NULL;
+
+        if (!NtAllocateVirtualMemory( NtCurrentProcess(), &bins, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+        {
+            heap->affinity_groups = (struct group **)((struct bin *)bins + HEAP_NB_BINS);
+            heap->bins = bins;
+        }
+    }
+
     /* link it into the per-process heap list */
     if (process_heap)
     {
@@ -1478,6 +1625,11 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE handle )
         addr = ROUND_ADDR( subheap, COMMIT_MASK );
         NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
     }
+    if ((addr = heap->bins))
+    {
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
     valgrind_notify_free_all( &heap->subheap );
     size = 0;
     addr = heap;
@@ -1534,22 +1686,256 @@ static NTSTATUS heap_allocate( struct heap *heap, ULONG flags, SIZE_T size, void
     return STATUS_SUCCESS;
 }
 
+static ULONG heap_current_thread_affinity(void)
+{
+    ULONG affinity;
+
+    if (!(affinity = NtCurrentTeb()->HeapVirtualAffinity))
+    {
+        affinity = 1 + (InterlockedIncrement( &next_thread_affinity ) - 1) % HEAP_AFFINITY_COUNT;
+        NtCurrentTeb()->HeapVirtualAffinity = affinity;
+    }
+
+    return affinity - 1;
+}
+
+/* the group slots of each affinity are kept together, away from the slots of other threads */
+static inline struct group **heap_get_affinity_group( const struct heap *heap, UINT bin )
+{
+    return heap->affinity_groups + heap_current_thread_affinity() * HEAP_NB_BINS + bin;
+}
+
+/* allocate a new group of free blocks from the heap, the calling thread owns it */
+static struct group *group_allocate( struct heap *heap, ULONG flags, UINT bin )
+{
+    SIZE_T block_size = bin_block_size( bin ), group_size;
+    struct group *group;
+    struct block *block;
+    NTSTATUS status;
+    UINT i;
+
+    group_size = GROUP_BLOCK_OFFSET + GROUP_BLOCK_COUNT * block_size;
+
+    heap_lock( heap, flags );
+    status = heap_allocate( heap, flags & ~HEAP_ZERO_MEMORY, group_size, (void **)&group );
+    if (!status) block_set_type( (struct block *)group - 1, ARENA_GROUP_MAGIC );
+    heap_unlock( heap, flags );
+    if (status) return NULL;
+
+    group->heap = heap;
+    group->free_bits = ~GROUP_FLAG_FREE;
+    group->bin = bin;
+
+    for (i = 0; i < GROUP_BLOCK_COUNT; i++)
+    {
+        block = group_block( group, block_size, i );
+        block_set_type( block, ARENA_FREE_MAGIC );
+        block_set_size( block, BLOCK_FLAG_LFH | BLOCK_FLAG_FREE, block_size );
+        block->base_offset = ((char *)(block + 1) - (char *)group) / ALIGNMENT;
+        mark_block_free( block + 1, block_size - sizeof(*block), heap->flags );
+    }
+
+    TRACE( "heap %p, allocated group %p for block size %#Ix\n", heap, group, block_size );
+    return group;
+}
+
+/* release a group with all its blocks free back to the heap, the calling thread must own it */
+static void group_release( struct heap *heap, ULONG flags, struct group *group )
+{
+    struct block *block = (struct block *)group - 1;
+    SUBHEAP *subheap;
+
+    TRACE( "heap %p, releasing group %p\n", heap, group );
+
+    heap_lock( heap, flags );
+    block_set_type( block, ARENA_INUSE_MAGIC );
+    if ((subheap = find_subheap( heap, block, FALSE ))) free_used_block( heap, subheap, block );
+    heap_unlock( heap, flags );
+}
+
+/* acquire exclusive ownership of a group with free blocks */
+static struct group *heap_acquire_bin_group( struct heap *heap, ULONG flags, UINT bin )
+{
+    SLIST_HEADER *groups = &heap->bins[bin].groups;
+    struct group *group;
+    SLIST_ENTRY *entry;
+    UINT affinity;
+
+    if ((group = InterlockedExchangePointer( (void **)heap_get_affinity_group( heap, bin ), NULL )))
+        return group;
+
+    while ((entry = RtlInterlockedPopEntrySList( groups )))
+    {
+        group = CONTAINING_RECORD( entry, struct group, entry );
+        /* keep a few groups around, release empty ones back to the heap */
+        if (ReadNoFence( &group->free_bits ) != ~GROUP_FLAG_FREE) return group;
+        if (RtlQueryDepthSList( groups ) < HEAP_AFFINITY_COUNT) return group;
+        group_release( heap, flags, group );
+    }
+
+    /* before taking the heap lock to allocate a group, take over one reserved for another affinity */
+    for (affinity = 0; affinity < HEAP_AFFINITY_COUNT; affinity++)
+    {
+        struct group *volatile *slot = heap->affinity_groups + affinity * HEAP_NB_BINS + bin;
+        if (*slot && (group = InterlockedExchangePointer( (void **)slot, NULL ))) return group;
+    }
+
+    return group_allocate( heap, flags, bin );
+}
+
+/* give up ownership of a group, keeping it reserved for the current thread affinity */
+static void heap_release_bin_group( struct heap *heap, UINT bin, struct group *group )
+{
+    if ((group = InterlockedExchangePointer( (void **)heap_get_affinity_group( heap, bin ), group )))
+        RtlInterlockedPushEntrySList( &heap->bins[bin].groups, &group->entry );
+}
+
+static NTSTATUS heap_allocate_block_lfh( struct heap *heap, ULONG flags, SIZE_T size, void **ret )
+{
+    SIZE_T block_size = heap_get_block_size( heap, flags, size );
+    struct group *group;
+    struct block *block;
+    DWORD index;
+    UINT bin;
+
+    if (!heap->bins || (flags & (HEAP_CHECKING_ENABLED | HEAP_ADD_USER_INFO))) return STATUS_UNSUCCESSFUL;
+    if (block_size < size || block_size > HEAP_MAX_LFH_BLOCK_SIZE) return STATUS_UNSUCCESSFUL;
+    bin = bin_from_block_size( block_size );
+    if (!ReadNoFence( &heap->bins[bin].enabled )) return STATUS_UNSUCCESSFUL;
+
+    block_size = bin_block_size( bin );
+    if (!(group = heap_acquire_bin_group( heap, flags, bin ))) return STATUS_NO_MEMORY;
+
+    /* the group is owned by this thread and has free blocks, concurrent frees may only set more bits */
+    BitScanForward( &index, ReadNoFence( &group->free_bits ) );
+    InterlockedAnd( &group->free_bits, ~(1 << index) );
+    block = group_block( group, block_size, index );
+
+    /* serialize with heap_free_block_lfh: atomically set GROUP_FLAG_FREE when the group is full */
+    if (ReadNoFence( &group->free_bits ) || InterlockedCompareExchange( &group->free_bits, GROUP_FLAG_FREE, 0 ))
+        heap_release_bin_group( heap, bin, group );
+
+    block_set_type( block, ARENA_INUSE_MAGIC );
+    block_set_size( block, BLOCK_FLAG_LFH, block_size );
+    block->tail_size = block_size - sizeof(*block) - size;
+    initialize_block( block + 1, size, flags );
+    mark_block_tail( block, flags );
+
+    *ret = block + 1;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS heap_free_block_lfh( struct heap *heap, struct group *group, struct block *block )
+{
+    SIZE_T block_size = block_get_size( block );
+    UINT i = group_block_index( group, block );
+
+    if (block_get_type( block ) != ARENA_INUSE_MAGIC || (block_get_flags( block ) & BLOCK_FLAG_FREE))
+    {
+        WARN( "heap %p, block %p: already freed block\n", heap, block );
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    block_set_type( block, ARENA_FREE_MAGIC );
+    block_set_size( block, BLOCK_FLAG_LFH | BLOCK_FLAG_FREE, block_size );
+    mark_block_free( block + 1, block_size - sizeof(*block), heap->flags );
+
+    /* if the group was full, no thread owns it anymore and it has to be put back in its bin */
+    if (InterlockedOr( &group->free_bits, 1 << i ) == GROUP_FLAG_FREE)
+    {
+        InterlockedAnd( &group->free_bits, ~GROUP_FLAG_FREE );
+        RtlInterlockedPushEntrySList( &heap->bins[group->bin].groups, &group->entry );
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS heap_reallocate_block_lfh( struct heap *heap, ULONG flags, struct group *group,
+                                           struct block *block, SIZE_T size, void **ret )
+{
+    SIZE_T old_size, old_block_size = block_get_size( block ), block_size = heap_get_block_size( heap, flags, size );
+    NTSTATUS status;
+
+    if (block_size < size) return STATUS_NO_MEMORY;  /* overflow */
+    if (block_get_type( block ) != ARENA_INUSE_MAGIC || (block_get_flags( block ) & BLOCK_FLAG_FREE))
+        return STATUS_INVALID_PARAMETER;
+    old_size = old_block_size - block_get_overhead( block );
+
+    /* keep the block if the new size fits and its unused size can still be stored */
+    if (block_size <= old_block_size && old_block_size - sizeof(*block) - size <= 0xff)
+    {
+        valgrind_notify_resize( block + 1, old_size, size );
+        if (size > old_size) initialize_block( (char *)(block + 1) + old_size, size - old_size, flags );
+        block->tail_size = old_block_size - sizeof(*block) - size;
+        mark_block_tail( block, flags );
+
+        *ret = block + 1;
+        return STATUS_SUCCESS;
+    }
+
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY) return STATUS_NO_MEMORY;
+    if ((status = heap_allocate_block_lfh( heap, flags & ~HEAP_ZERO_MEMORY, size, ret )))
+    {
+        heap_lock( heap, flags );
+        status = heap_allocate( heap, flags & ~HEAP_ZERO_MEMORY, size, ret );
+        heap_unlock( heap, flags );
+        if (status) return status;
+    }
+
+    valgrind_notify_alloc( *ret, size, 0 );
+    memcpy( *ret, block + 1, min( old_size, size ) );
+    if ((flags & HEAP_ZERO_MEMORY) && size > old_size) memset( (char *)*ret + old_size, 0, size - old_size );
+    valgrind_notify_free( block + 1 );
+    return heap_free_block_lfh( heap, group, block );
+}
+
+/* update the bin counters of normal blocks, enabling LFH for the bin if the allocation pattern requires it */
+static void heap_update_bin_counters( struct heap *heap, SIZE_T block_size, BOOL freed )
+{
+    ULONG alloc, count;
+    struct bin *bin;
+
+    if (!heap->bins || !block_size || block_size > HEAP_MAX_LFH_BLOCK_SIZE) return;
+    bin = heap->bins + bin_from_block_size( block_size );
+    if (ReadNoFence( &bin->enabled )) return;
+
+    if (freed)
+    {
+        InterlockedIncrement( &bin->count_freed );
+        return;
+    }
+
+    alloc = InterlockedIncrement( &bin->count_alloc );
+    count = alloc - ReadNoFence( &bin->count_freed );
+    block_size = bin_block_size( bin - heap->bins );
+
+    if (block_size <= 0x300 && (alloc > 0x800 || count > 0x10)) WriteNoFence( &bin->enabled, TRUE );
+    else if (count > 0x400000 / block_size) WriteNoFence( &bin->enabled, TRUE );
+    else return;
+
+    TRACE( "heap %p, enabling LFH for block size %#Ix\n", heap, block_size );
+    InterlockedCompareExchange( (LONG *)&heap->compat_info, HEAP_LFH, HEAP_STD );
+}
+
 /***********************************************************************
  *           RtlAllocateHeap   (NTDLL.@)
  */
 void *WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE handle, ULONG flags, SIZE_T size )
 {
     struct heap *heap;
+    ULONG heap_flags;
     void *ptr = NULL;
     NTSTATUS status;
 
     if (!(heap = unsafe_heap_from_handle( handle )))
         status = STATUS_INVALID_HANDLE;
-    else
+    else if ((status = heap_allocate_block_lfh( heap, (heap_flags = heap_get_flags( heap, flags )), size, &ptr )))
     {
         heap_lock( heap, flags );
-        status = heap_allocate( heap, heap_get_flags( heap, flags ), size, &ptr );
+        status = heap_allocate( heap, heap_flags, size, &ptr );
         heap_unlock( heap, flags );
+
+        if (!status) heap_update_bin_counters( heap, block_get_size( (struct block *)ptr - 1 ), FALSE );
     }
 
     if (!status) valgrind_notify_alloc( ptr, size, flags & HEAP_ZERO_MEMORY );
@@ -1567,7 +1953,11 @@ static NTSTATUS heap_free( struct heap *heap, void *ptr )
 
     if (!(block = unsafe_block_from_ptr( heap, ptr, &subheap ))) return STATUS_INVALID_PARAMETER;
     if (!subheap) free_large_block( heap, block );
-    else free_used_block( heap, subheap, block );
+    else
+    {
+        heap_update_bin_counters( heap, block_get_size( block ), TRUE );
+        free_used_block( heap, subheap, block );
+    }
 
     return STATUS_SUCCESS;
 }
@@ -1577,6 +1967,7 @@ static NTSTATUS heap_free( struct heap *heap, void *ptr )
  */
 BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE handle, ULONG flags, void *ptr )
 {
+    struct group *group;
     struct heap *heap;
     NTSTATUS status;
 
@@ -1586,6 +1977,8 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE handle, ULONG flags, void *
 
     if (!(heap = unsafe_heap_from_handle( handle )))
         status = STATUS_INVALID_PARAMETER;
+    else if ((group = unsafe_group_from_ptr( heap, flags, ptr )))
+        status = heap_free_block_lfh( heap, group, (struct block *)ptr - 1 );
     else
     {
         heap_lock( heap, flags );
@@ -1662,6 +2055,7 @@ static NTSTATUS heap_reallocate( struct heap *heap, ULONG flags, void *ptr, SIZE
  */
 void *WINAPI RtlReAllocateHeap( HANDLE handle, ULONG flags, void *ptr, SIZE_T size )
 {
+    struct group *group;
     struct heap *heap;
     void *ret = NULL;
     NTSTATUS status;
@@ -1670,6 +2064,8 @@ void *WINAPI RtlReAllocateHeap( HANDLE handle, ULONG flags, void *ptr, SIZE_T si
 
     if (!(heap = unsafe_heap_from_handle( handle )))
         status = STATUS_INVALID_HANDLE;
+    else if ((group = unsafe_group_from_ptr( heap, flags, ptr )))
+        status = heap_reallocate_block_lfh( heap, heap_get_flags( heap, flags ), group, (struct block *)ptr - 1, size, &ret );
     else
     {
         heap_lock( heap, flags );
@@ -1769,12 +2165,22 @@ static NTSTATUS heap_size( const struct heap *heap, const void *ptr, SIZE_T *siz
  */
 SIZE_T WINAPI RtlSizeHeap( HANDLE handle, ULONG flags, const void *ptr )
 {
+    const struct block *block = (const struct block *)ptr - 1;
     SIZE_T size = ~(SIZE_T)0;
     struct heap *heap;
     NTSTATUS status;
 
     if (!(heap = unsafe_heap_from_handle( handle )))
         status = STATUS_INVALID_PARAMETER;
+    else if (unsafe_group_from_ptr( heap, flags, ptr ))
+    {
+        if (block_get_flags( block ) & BLOCK_FLAG_FREE) status = STATUS_INVALID_PARAMETER;
+        else
+        {
+            size = block_get_size( block ) - block_get_overhead( block );
+            status = STATUS_SUCCESS;
+        }
+    }
     else
     {
         heap_lock( heap, flags );
@@ -1812,6 +2218,23 @@ BOOLEAN WINAPI RtlValidateHeap( HANDLE handle, ULONG flags, const void *ptr )
 }
 
 
+/* return the next block to walk, iterating over the blocks of LFH groups */
+static const struct block *heap_walk_next_block( const struct heap *heap, const SUBHEAP *subheap,
+                                                 const struct block *block )
+{
+    const struct group *group;
+    UINT index;
+
+    if ((group = block_get_group( heap, block )))
+    {
+        if ((index = group_block_index( group, block ) + 1) < GROUP_BLOCK_COUNT)
+            return group_block( group, block_get_size( block ), index );
+        block = (const struct block *)group - 1;
+    }
+
+    return next_block( subheap, block );
+}
+
 static NTSTATUS heap_walk_blocks( const struct heap *heap, const SUBHEAP *subheap,
                                   const struct block *block, struct rtl_heap_entry *entry )
 {
@@ -1820,7 +2243,7 @@ static NTSTATUS heap_walk_blocks( const struct heap *heap, const SUBHEAP *subhea
 
     if (entry->lpData == commit_end) return STATUS_NO_MORE_ENTRIES;
     if (entry->lpData == base) block = blocks;
-    else if (!(block = next_block( subheap, block )))
+    else if (!(block = heap_walk_next_block( heap, subheap, block )))
     {
         entry->lpData = (void *)commit_end;
         entry->cbData = end - commit_end;
@@ -1830,7 +2253,23 @@ static NTSTATUS heap_walk_blocks( const struct heap *heap, const SUBHEAP *subhea
         return STATUS_SUCCESS;
     }
 
-    if (block_get_flags( block ) & BLOCK_FLAG_FREE)
+    if (block_get_type( block ) == ARENA_GROUP_MAGIC)
+    {
+        const struct group *group = (const struct group *)(block + 1);
+        block = group_block( group, bin_block_size( group->bin ), 0 );
+    }
+
+    if (block_get_flags( block ) & BLOCK_FLAG_LFH)
+    {
+        if (block_get_flags( block ) & BLOCK_FLAG_FREE) entry->lpData = (char *)block + block_get_overhead( block );
+        else entry->lpData = (void *)(block + 1);
+        entry->cbData = block_get_size( block ) - block_get_overhead( block );
+        entry->cbOverhead = block_get_overhead( block );
+        entry->iRegionIndex = 0;
+        entry->wFlags = RTL_HEAP_ENTRY_LFH;
+        if (!(block_get_flags( block ) & BLOCK_FLAG_FREE)) entry->wFlags |= RTL_HEAP_ENTRY_BUSY;
+    }
+    else if (block_get_flags( block ) & BLOCK_FLAG_FREE)
     {
         entry->lpData = (char *)block + block_get_overhead( block );
         entry->cbData = block_get_size( block ) - block_get_overhead( block );
@@ -1977,15 +2416,20 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS info_class,
                                          void *info, SIZE_T size_in, PSIZE_T size_out )
 {
+    struct heap *heap;
+
+    TRACE( "handle %p, info_class %u, info %p, size_in %Iu, size_out %p.\n", handle, info_class, info, size_in, size_out );
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
+        if (!(heap = unsafe_heap_from_handle( handle ))) return STATUS_ACCESS_VIOLATION;
         if (size_out) *size_out = sizeof(ULONG);
 
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        *(ULONG *)info = ReadNoFence( (LONG *)&heap->compat_info );
         return STATUS_SUCCESS;
 
     default:
@@ -1999,8 +2443,42 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS i
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS info_class, void *info, SIZE_T size )
 {
-    FIXME( "handle %p, info_class %d, info %p, size %ld stub!\n", handle, info_class, info, size );
-    return STATUS_SUCCESS;
+    struct heap *heap;
+    ULONG compat_info;
+
+    TRACE( "handle %p, info_class %d, info %p, size %Iu.\n", handle, info_class, info, size );
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heap = unsafe_heap_from_handle( handle ))) return STATUS_INVALID_HANDLE;
+
+        compat_info = *(ULONG *)info;
+        if (compat_info != HEAP_STD && compat_info != HEAP_LFH)
+        {
+            FIXME( "Unsupported heap compatibility information %lu\n", compat_info );
+            return STATUS_UNSUCCESSFUL;
+        }
+        if (compat_info == HEAP_LFH && !heap->bins) return STATUS_UNSUCCESSFUL;
+
+        /* LFH cannot be disabled once it has been enabled */
+        if (InterlockedCompareExchange( (LONG *)&heap->compat_info, compat_info, HEAP_STD ) != HEAP_STD &&
+            ReadNoFence( (LONG *)&heap->compat_info ) != compat_info)
+            return STATUS_UNSUCCESSFUL;
+
+        /* when explicitly requested, use LFH for every block size without waiting for the allocation pattern */
+        if (compat_info == HEAP_LFH)
+        {
+            UINT bin;
+            for (bin = 0; bin < HEAP_NB_BINS; bin++) WriteNoFence( &heap->bins[bin].enabled, TRUE );
+        }
+        return STATUS_SUCCESS;
+
+    default:
+        FIXME( "handle %p, info_class %d, info %p, size %Iu stub!\n", handle, info_class, info, size );
+        return STATUS_SUCCESS;
+    }
 }
 
 /***********************************************************************
@@ -76,6 +76,9 @@ static NTSTATUS (WINAPI *pNtQueryIoCompletion)(HANDLE, IO_COMPLETION_INFORMATION
 static NTSTATUS (WINAPI *pNtRemoveIoCompletion)(HANDLE, PULONG_PTR, PULONG_PTR, PIO_STATUS_BLOCK, PLARGE_INTEGER);
 static NTSTATUS (WINAPI *pNtRemoveIoCompletionEx)(HANDLE,FILE_IO_COMPLETION_INFORMATION*,ULONG,ULONG*,LARGE_INTEGER*,BOOLEAN);
 static NTSTATUS (WINAPI *pNtSetIoCompletion)(HANDLE, ULONG_PTR, ULONG_PTR, NTSTATUS, SIZE_T);
+static NTSTATUS (WINAPI *pNtCreateWaitCompletionPacket)(HANDLE*,ACCESS_MASK,OBJECT_ATTRIBUTES*);
+static NTSTATUS (WINAPI *pNtAssociateWaitCompletionPacket)(HANDLE,HANDLE,HANDLE,void*,void*,NTSTATUS,ULONG_PTR,BOOLEAN*);
+static NTSTATUS (WINAPI *pNtCancelWaitCompletionPacket)(HANDLE,BOOLEAN);
 static NTSTATUS (WINAPI *pNtSetInformationFile)(HANDLE, PIO_STATUS_BLOCK, PVOID, ULONG, FILE_INFORMATION_CLASS);
 static NTSTATUS (WINAPI *pNtQueryAttributesFile)(const OBJECT_ATTRIBUTES*,FILE_BASIC_INFORMATION*);
 static NTSTATUS (WINAPI *pNtQueryInformationFile)(HANDLE, PIO_STATUS_BLOCK, PVOID, ULONG, FILE_INFORMATION_CLASS);
@@ -1077,6 +1080,89 @@ static void test_set_io_completion(void)
     pNtClose( h );
 }
 
+static void test_wait_completion_packet(void)
+{
+    LARGE_INTEGER timeout = {{0}};
+    IO_STATUS_BLOCK iosb;
+    ULONG_PTR key, value;
+    HANDLE port, packet, event, mutex;
+    BOOLEAN signaled;
+    NTSTATUS res;
+    DWORD ret;
+
+    if (!pNtCreateWaitCompletionPacket)
+    {
+        win_skip( "NtCreateWaitCompletionPacket() not present\n" );
+        return;
+    }
+
+    res = pNtCreateIoCompletion( &port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#lx\n", res );
+    res = pNtCreateWaitCompletionPacket( &packet, GENERIC_ALL, NULL );
+    ok( res == STATUS_SUCCESS, "NtCreateWaitCompletionPacket failed: %#lx\n", res );
+    event = CreateEventW( NULL, FALSE, FALSE, NULL );
+
+    /* the packet is queued once the object is signaled */
+    signaled = 0xcc;
+    res = pNtAssociateWaitCompletionPacket( packet, port, event, (void *)CKEY_FIRST, (void *)CVALUE_FIRST,
+                                            STATUS_INVALID_DEVICE_REQUEST, 3, &signaled );
+    ok( res == STATUS_SUCCESS, "NtAssociateWaitCompletionPacket failed: %#lx\n", res );
+    ok( !signaled, "got signaled %d\n", signaled );
+
+    res = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_TIMEOUT, "NtRemoveIoCompletion failed: %#lx\n", res );
+
+    SetEvent( event );
+    res = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletion failed: %#lx\n", res );
+    ok( key == CKEY_FIRST, "Invalid completion key: %#Ix\n", key );
+    ok( value == CVALUE_FIRST, "Invalid completion value: %#Ix\n", value );
+    ok( U(iosb).Status == STATUS_INVALID_DEVICE_REQUEST, "Invalid iosb.Status: %#lx\n", U(iosb).Status );
+    ok( iosb.Information == 3, "Invalid iosb.Information: %Iu\n", iosb.Information );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "event was not reset, ret %lu\n", ret );
+
+    /* an already signaled object queues the packet immediately */
+    SetEvent( event );
+    res = pNtAssociateWaitCompletionPacket( packet, port, event, (void *)CKEY_SECOND, (void *)CVALUE_FIRST,
+                                            STATUS_SUCCESS, 0, &signaled );
+    ok( res == STATUS_SUCCESS, "NtAssociateWaitCompletionPacket failed: %#lx\n", res );
+    ok( signaled == TRUE, "got signaled %d\n", signaled );
+    res = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletion failed: %#lx\n", res );
+    ok( key == CKEY_SECOND, "Invalid completion key: %#Ix\n", key );
+
+    /* a cancelled wait does not consume the object */
+    res = pNtAssociateWaitCompletionPacket( packet, port, event, (void *)CKEY_FIRST, (void *)CVALUE_FIRST,
+                                            STATUS_SUCCESS, 0, NULL );
+    ok( res == STATUS_SUCCESS, "NtAssociateWaitCompletionPacket failed: %#lx\n", res );
+    res = pNtCancelWaitCompletionPacket( packet, FALSE );
+    ok( res == STATUS_SUCCESS, "NtCancelWaitCompletionPacket failed: %#lx\n", res );
+    SetEvent( event );
+    res = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_TIMEOUT, "NtRemoveIoCompletion failed: %#lx\n", res );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_OBJECT_0, "event was reset, ret %lu\n", ret );
+
+    /* a signaled mutex is not acquired by the associating thread */
+    mutex = CreateMutexW( NULL, FALSE, NULL );
+    res = pNtAssociateWaitCompletionPacket( packet, port, mutex, (void *)CKEY_FIRST, (void *)CVALUE_FIRST,
+                                            STATUS_SUCCESS, 0, &signaled );
+    ok( res == STATUS_SUCCESS, "NtAssociateWaitCompletionPacket failed: %#lx\n", res );
+    ok( signaled == TRUE, "got signaled %d\n", signaled );
+    res = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletion failed: %#lx\n", res );
+    SetLastError( 0xdeadbeef );
+    ret = ReleaseMutex( mutex );
+    ok( !ret, "ReleaseMutex succeeded\n" );
+    ok( GetLastError() == ERROR_NOT_OWNER, "got error %lu\n", GetLastError() );
+    CloseHandle( mutex );
+
+    CloseHandle( event );
+    pNtClose( packet );
+    pNtClose( port );
+}
+
 static void test_file_io_completion(void)
 {
     static const char pipe_name[] = "\\\\.\\pipe\\iocompletiontestnamedpipe";
@@ -5278,6 +5364,9 @@ START_TEST(file)
     pNtRemoveIoCompletion   = (void *)GetProcAddress(hntdll, "NtRemoveIoCompletion");
     pNtRemoveIoCompletionEx = (void *)GetProcAddress(hntdll, "NtRemoveIoCompletionEx");
     pNtSetIoCompletion      = (void *)GetProcAddress(hntdll, "NtSetIoCompletion");
+    pNtCreateWaitCompletionPacket = (void *)GetProcAddress(hntdll, "NtCreateWaitCompletionPacket");
+    pNtAssociateWaitCompletionPacket = (void *)GetProcAddress(hntdll, "NtAssociateWaitCompletionPacket");
+    pNtCancelWaitCompletionPacket = (void *)GetProcAddress(hntdll, "NtCancelWaitCompletionPacket");
     pNtSetInformationFile   = (void *)GetProcAddress(hntdll, "NtSetInformationFile");
     pNtQueryAttributesFile  = (void *)GetProcAddress(hntdll, "NtQueryAttributesFile");
     pNtQueryInformationFile = (void *)GetProcAddress(hntdll, "NtQueryInformationFile");
@@ -5295,6 +5384,7 @@ START_TEST(file)
     append_file_test();
     nt_mailslot_test();
     test_set_io_completion();
+    test_wait_completion_packet();
     test_file_io_completion();
     test_file_basic_information();
     test_file_all_information();
@@ -684,6 +684,88 @@ static void test_tp_simple(void)
     CloseHandle(semaphore);
 }
 
+struct simple_many_info
+{
+    TP_CALLBACK_ENVIRON environment;
+    LONG count;
+    LONG total;
+    HANDLE done_event;
+};
+
+static void CALLBACK simple_many_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct simple_many_info *info = userdata;
+    if (InterlockedIncrement(&info->count) == info->total)
+        SetEvent(info->done_event);
+}
+
+static void CALLBACK simple_many_post_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct simple_many_info *info = userdata;
+    NTSTATUS status;
+    int i;
+
+    /* post more callbacks from a worker thread */
+    for (i = 0; i < 100; i++)
+    {
+        status = pTpSimpleTryPost(simple_many_cb, info, &info->environment);
+        ok(!status, "TpSimpleTryPost failed with status %lx\n", status);
+    }
+    simple_many_cb(instance, userdata);
+}
+
+static DWORD WINAPI simple_many_thread(void *param)
+{
+    struct simple_many_info *info = param;
+    NTSTATUS status;
+    int i;
+
+    for (i = 0; i < 1000; i++)
+    {
+        status = pTpSimpleTryPost(i % 100 ? simple_many_cb : simple_many_post_cb, info, &info->environment);
+        ok(!status, "TpSimpleTryPost failed with status %lx\n", status);
+    }
+    return 0;
+}
+
+static void test_tp_simple_many(void)
+{
+    struct simple_many_info info;
+    HANDLE threads[4];
+    NTSTATUS status;
+    TP_POOL *pool;
+    DWORD result;
+    int i;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %lx\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    memset(&info, 0, sizeof(info));
+    info.environment.Version = 1;
+    info.environment.Pool = pool;
+    info.total = ARRAY_SIZE(threads) * (1000 + 10 * 100);
+    info.done_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(info.done_event != NULL, "CreateEventW failed %lu\n", GetLastError());
+
+    /* post callbacks from several threads at once */
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        threads[i] = CreateThread(NULL, 0, simple_many_thread, &info, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed %lu\n", GetLastError());
+    }
+    result = WaitForMultipleObjects(ARRAY_SIZE(threads), threads, TRUE, 5000);
+    ok(result == WAIT_OBJECT_0, "WaitForMultipleObjects returned %lu\n", result);
+    result = WaitForSingleObject(info.done_event, 5000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    ok(info.count == info.total, "expected %ld callbacks, got %ld\n", info.total, info.count);
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++) CloseHandle(threads[i]);
+    CloseHandle(info.done_event);
+    pTpReleasePool(pool);
+}
+
 static void CALLBACK work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
 {
     Sleep(100);
@@ -2363,6 +2445,7 @@ START_TEST(threadpool)
         return;
 
     test_tp_simple();
+    test_tp_simple_many();
     test_tp_work();
     test_tp_work_scheduler();
     test_tp_group_wait();
@@ -68,11 +68,26 @@ static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug =
       0, 0, { (DWORD_PTR)(__FILE__ ": threadpool_compl_cs") }
 };
 
+/* binary min-heap of timers, ordered by key */
+struct timer_heap_entry
+{
+    ULONGLONG key;
+    unsigned int index;         /* position in the heap */
+};
+
+struct timer_heap
+{
+    struct timer_heap_entry **entries;
+    unsigned int count;
+    unsigned int capacity;      /* preallocated, so that insertion never fails */
+};
+
 struct timer_queue;
 struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
+    struct timer_heap_entry heap_entry;
     ULONG runcount;             /* number of callbacks pending execution */
     RTL_WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
@@ -87,7 +102,9 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all timers of the queue */
+    struct timer_heap heap;     /* timers which are not EXPIRE_NEVER, by expiration time */
+    unsigned int num_timers;
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -98,6 +115,7 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_STEAL_COUNT 32
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
 /* internal threadpool representation */
@@ -109,16 +127,33 @@ struct threadpool
     CRITICAL_SECTION        cs;
     /* Pools of work items, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
     struct list             pools[3];
+    LONG                    num_queued_objects[3];
+    /* Simple callbacks and work items without a cleanup group don't need the lock; they
+     * are pushed to the injection queues, moved in batches to the queues of the worker
+     * threads, and stolen by other workers when their own queue is empty. Same order
+     * as .pools. */
+    SLIST_HEADER            injection[3];
+    LONG                    num_queued_unlocked[3];
     RTL_CONDITION_VARIABLE  update_event;
     /* information about worker threads, locked via .cs */
+    struct list             workers;
     int                     max_workers;
     int                     min_workers;
-    int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_workers;
+    LONG                    num_busy_workers;  /* modified with interlocked functions */
+    LONG                    num_idle_workers;  /* modified with interlocked functions */
     HANDLE                  compl_port;
     TP_POOL_STACK_INFORMATION stack_info;
 };
 
+/* worker thread of a threadpool */
+struct threadpool_worker
+{
+    struct list             entry;      /* entry in pool->workers, locked via pool->cs */
+    RTL_SRWLOCK             lock;       /* lock for the queues */
+    struct list             queues[3];  /* objects taken from the pool injection queues */
+};
+
 enum threadpool_objtype
 {
     TP_OBJECT_TYPE_SIMPLE,
@@ -155,9 +190,12 @@ struct threadpool_object
     BOOL                    is_group_member;
     /* information about the pool, locked via .pool->cs */
     struct list             pool_entry;
+    SLIST_ENTRY             injection_entry;
+    LONG                    injected;  /* queued through the injection queues */
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
     HANDLE                  completed_event;
+    /* modified with interlocked functions outside of .pool->cs for objects queued without the lock */
     LONG                    num_pending_callbacks;
     LONG                    num_running_callbacks;
     LONG                    num_associated_callbacks;
@@ -178,7 +216,8 @@ struct threadpool_object
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
             BOOL            timer_pending;
-            struct list     timer_entry;
+            struct timer_heap_entry timer_due;      /* keyed by timeout */
+            struct timer_heap_entry timer_deadline; /* keyed by timeout + window length */
             BOOL            timer_set;
             ULONGLONG       timeout;
             LONG            period;
@@ -196,6 +235,11 @@ struct threadpool_object
             HANDLE          handle;
             DWORD           flags;
             RTL_WAITORTIMERCALLBACKFUNC rtl_callback;
+            /* wait completion packet, only used by the multiplexed bucket */
+            HANDLE          packet;
+            BOOL            armed;
+            ULONG_PTR       arm;
+            ULONGLONG       interval;
         } wait;
         struct
         {
@@ -244,7 +288,8 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
+    struct timer_heap       pending_timers;
+    struct timer_heap       pending_deadlines;
     RTL_CONDITION_VARIABLE  update_event;
 }
 timerqueue =
@@ -252,7 +297,8 @@ timerqueue =
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
+    { NULL, 0, 0 },                             /* pending_timers */
+    { NULL, 0, 0 },                             /* pending_deadlines */
     RTL_CONDITION_VARIABLE_INIT                 /* update_event */
 };
 
@@ -271,12 +317,14 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    num_buckets;
     struct list             buckets;
+    struct waitqueue_bucket *port_bucket;
 }
 waitqueue =
 {
     { &waitqueue_debug, -1, 0, 0, 0, 0 },       /* cs */
     0,                                          /* num_buckets */
-    LIST_INIT( waitqueue.buckets )              /* buckets */
+    LIST_INIT( waitqueue.buckets ),             /* buckets */
+    NULL                                        /* port_bucket */
 };
 
 static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
@@ -294,6 +342,9 @@ struct waitqueue_bucket
     struct list             waiting;
     HANDLE                  update_event;
     BOOL                    alertable;
+    /* multiplexed bucket only */
+    HANDLE                  port;
+    LONG                    num_armed;
 };
 
 /* global I/O completion queue object */
@@ -396,6 +447,83 @@ static BOOL array_reserve(void **elements, unsigned int *capacity, unsigned int
     return TRUE;
 }
 
+static BOOL timer_heap_reserve( struct timer_heap *heap, unsigned int count )
+{
+    return array_reserve( (void **)&heap->entries, &heap->capacity, count, sizeof(*heap->entries) );
+}
+
+static void timer_heap_set( struct timer_heap *heap, unsigned int index, struct timer_heap_entry *entry )
+{
+    heap->entries[index] = entry;
+    entry->index = index;
+}
+
+static void timer_heap_sift_up( struct timer_heap *heap, unsigned int index )
+{
+    struct timer_heap_entry *entry = heap->entries[index];
+    unsigned int parent;
+
+    while (index && heap->entries[(parent = (index - 1) / 2)]->key > entry->key)
+    {
+        timer_heap_set( heap, index, heap->entries[parent] );
+        index = parent;
+    }
+    timer_heap_set( heap, index, entry );
+}
+
+static void timer_heap_sift_down( struct timer_heap *heap, unsigned int index )
+{
+    struct timer_heap_entry *entry = heap->entries[index];
+    unsigned int child;
+
+    while ((child = 2 * index + 1) < heap->count)
+    {
+        if (child + 1 < heap->count && heap->entries[child + 1]->key < heap->entries[child]->key)
+            child++;
+        if (heap->entries[child]->key >= entry->key) break;
+        timer_heap_set( heap, index, heap->entries[child] );
+        index = child;
+    }
+    timer_heap_set( heap, index, entry );
+}
+
+/* space must have been reserved with timer_heap_reserve */
+static void timer_heap_insert( struct timer_heap *heap, struct timer_heap_entry *entry, ULONGLONG key )
+{
+    assert( heap->count < heap->capacity );
+    entry->key = key;
+    heap->entries[heap->count] = entry;
+    timer_heap_sift_up( heap, heap->count++ );
+}
+
+static void timer_heap_remove( struct timer_heap *heap, struct timer_heap_entry *entry )
+{
+    unsigned int index = entry->index;
+    struct timer_heap_entry *last = heap->entries[--heap->count];
+
+    assert( heap->entries[index] == entry );
+    if (last == entry) return;
+    timer_heap_set( heap, index, last );
+    timer_heap_sift_down( heap, index );
+    timer_heap_sift_up( heap, last->index );
+}
+
+static struct timer_heap_entry *timer_heap_head( const struct timer_heap *heap )
+{
+    return heap->count ? heap->entries[0] : NULL;
+}
+
+/* returns the largest key lower than limit in the subtree, or 0 */
+static ULONGLONG timer_heap_max_key_below( const struct timer_heap *heap, unsigned int index, ULONGLONG limit )
+{
+    ULONGLONG ret, key;
+
+    if (index >= heap->count || (ret = heap->entries[index]->key) >= limit) return 0;
+    if ((key = timer_heap_max_key_below( heap, 2 * index + 1, limit )) > ret) ret = key;
+    if ((key = timer_heap_max_key_below( heap, 2 * index + 2, limit )) > ret) ret = key;
+    return ret;
+}
+
 static void set_thread_name(const WCHAR *name)
 {
     THREAD_NAME_INFORMATION info;
@@ -568,6 +696,9 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->destroy);
 
     list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        timer_heap_remove(&q->heap, &t->heap_entry);
+    q->num_timers--;
     if (t->event)
         NtSetEvent(t->event, NULL);
     RtlFreeHeap(GetProcessHeap(), 0, t);
@@ -610,24 +741,17 @@ static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
 {
     /* We MUST hold the queue cs while calling this function.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
-
     t->expire = time;
+    if (time == EXPIRE_NEVER)
+        return;
+    timer_heap_insert(&q->heap, &t->heap_entry, time);
 
-    /* If we insert at the head of the list, we need to expire sooner
+    /* If we insert at the head of the heap, we need to expire sooner
        than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    if (set_event && !t->heap_entry.index)
         NtSetEvent(q->event, NULL);
 }
 
@@ -635,7 +759,8 @@ static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        timer_heap_remove(&t->q->heap, &t->heap_entry);
     queue_add_timer(t, time, set_event);
 }
 
@@ -644,10 +769,10 @@ static void queue_timer_expire(struct timer_queue *q)
     struct queue_timer *t = NULL;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if (timer_heap_head(&q->heap))
     {
         ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
+        t = CONTAINING_RECORD(timer_heap_head(&q->heap), struct queue_timer, heap_entry);
         if (!t->destroy && t->expire <= ((now = queue_current_time())))
         {
             ++t->runcount;
@@ -690,16 +815,13 @@ static ULONG queue_get_timeout(struct timer_queue *q)
     ULONG timeout = INFINITE;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if (timer_heap_head(&q->heap))
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
+        ULONGLONG time = queue_current_time();
 
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
-        }
+        t = CONTAINING_RECORD(timer_heap_head(&q->heap), struct queue_timer, heap_entry);
+        assert(!t->destroy && t->expire != EXPIRE_NEVER);
+        timeout = t->expire < time ? 0 : t->expire - time;
     }
     RtlLeaveCriticalSection(&q->cs);
 
@@ -745,6 +867,7 @@ static void WINAPI timer_queue_thread_proc(LPVOID p)
     NtClose(q->event);
     RtlDeleteCriticalSection(&q->cs);
     q->magic = 0;
+    RtlFreeHeap(GetProcessHeap(), 0, q->heap.entries);
     RtlFreeHeap(GetProcessHeap(), 0, q);
     RtlExitUserThread( 0 );
 }
@@ -760,7 +883,7 @@ static void queue_destroy_timer(struct queue_timer *t)
         queue_remove_timer(t);
     else
         /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+           of the heap.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -785,6 +908,10 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    q->heap.entries = NULL;
+    q->heap.count = 0;
+    q->heap.capacity = 0;
+    q->num_timers = 0;
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -944,8 +1071,14 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, HANDLE *NewTimer,
     RtlEnterCriticalSection(&q->cs);
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
+    else if (!timer_heap_reserve(&q->heap, q->num_timers + 1))
+        status = STATUS_NO_MEMORY;
     else
+    {
+        list_add_tail(&q->timers, &t->entry);
+        q->num_timers++;
         queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    }
     RtlLeaveCriticalSection(&q->cs);
 
     if (status == STATUS_SUCCESS)
@@ -1050,15 +1183,41 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     return status;
 }
 
+/***********************************************************************
+ *           tp_timerqueue_insert    (internal)
+ *
+ * Adds a timer to the pending heaps, returns TRUE if the next wakeup time
+ * of the timer thread may have changed. Called with timerqueue.cs held.
+ */
+static BOOL tp_timerqueue_insert( struct threadpool_object *timer )
+{
+    assert( !timer->u.timer.timer_pending );
+    timer_heap_insert( &timerqueue.pending_timers, &timer->u.timer.timer_due, timer->u.timer.timeout );
+    timer_heap_insert( &timerqueue.pending_deadlines, &timer->u.timer.timer_deadline,
+                       timer->u.timer.timeout + (ULONGLONG)timer->u.timer.window_length * 10000 );
+    timer->u.timer.timer_pending = TRUE;
+    return !timer->u.timer.timer_due.index || !timer->u.timer.timer_deadline.index;
+}
+
+/***********************************************************************
+ *           tp_timerqueue_remove    (internal)
+ */
+static void tp_timerqueue_remove( struct threadpool_object *timer )
+{
+    assert( timer->u.timer.timer_pending );
+    timer_heap_remove( &timerqueue.pending_timers, &timer->u.timer.timer_due );
+    timer_heap_remove( &timerqueue.pending_deadlines, &timer->u.timer.timer_deadline );
+    timer->u.timer.timer_pending = FALSE;
+}
+
 /***********************************************************************
  *           timerqueue_thread_proc    (internal)
  */
 static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
+    ULONGLONG timeout_lower, timeout_upper;
+    struct timer_heap_entry *entry;
     LARGE_INTEGER now, timeout;
-    struct list *ptr;
 
     TRACE( "starting timer queue thread\n" );
     set_thread_name(L"wine_threadpool_timerqueue");
@@ -1069,17 +1228,16 @@ static void CALLBACK timerqueue_thread_proc( void *param )
         NtQuerySystemTime( &now );
 
         /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
+        while ((entry = timer_heap_head( &timerqueue.pending_timers )))
         {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
+            struct threadpool_object *timer = CONTAINING_RECORD( entry, struct threadpool_object, u.timer.timer_due );
             assert( timer->type == TP_OBJECT_TYPE_TIMER );
             assert( timer->u.timer.timer_pending );
             if (timer->u.timer.timeout > now.QuadPart)
                 break;
 
             /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
-            timer->u.timer.timer_pending = FALSE;
+            tp_timerqueue_remove( timer );
             tp_object_submit( timer, FALSE );
 
             /* Insert the timer back into the queue, except it's marked for shutdown. */
@@ -1088,33 +1246,18 @@ static void CALLBACK timerqueue_thread_proc( void *param )
                 timer->u.timer.timeout += (ULONGLONG)timer->u.timer.period * 10000;
                 if (timer->u.timer.timeout <= now.QuadPart)
                     timer->u.timer.timeout = now.QuadPart + 1;
-
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
-                timer->u.timer.timer_pending = TRUE;
+                tp_timerqueue_insert( timer );
             }
         }
 
-        timeout_lower = timeout_upper = MAXLONGLONG;
-
-        /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
+        /* Determine next timeout and use the window length to optimize wakeup times: wake up
+         * at the latest timeout which is still before the earliest deadline of all timers. */
+        timeout_lower = MAXLONGLONG;
+        if ((entry = timer_heap_head( &timerqueue.pending_timers )))
         {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
-                break;
-
-            timeout_lower = other_timer->u.timer.timeout;
-            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
-            if (new_timeout < timeout_upper)
-                timeout_upper = new_timeout;
+            timeout_lower = entry->key;
+            timeout_upper = timer_heap_head( &timerqueue.pending_deadlines )->key;
+            timeout_lower = max( timeout_lower, timer_heap_max_key_below( &timerqueue.pending_timers, 0, timeout_upper ));
         }
 
         /* Wait for timer update events or until the next timer expires. */
@@ -1196,6 +1339,12 @@ static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
         }
     }
 
+    /* Make sure that pending timers can always be inserted. */
+    if (status == STATUS_SUCCESS &&
+        (!timer_heap_reserve( &timerqueue.pending_timers, timerqueue.objcount + 1 ) ||
+         !timer_heap_reserve( &timerqueue.pending_deadlines, timerqueue.objcount + 1 )))
+        status = STATUS_NO_MEMORY;
+
     if (status == STATUS_SUCCESS)
     {
         timer->u.timer.timer_initialized = TRUE;
@@ -1220,15 +1369,12 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
     {
         /* If timer was pending, remove it. */
         if (timer->u.timer.timer_pending)
-        {
-            list_remove( &timer->u.timer.timer_entry );
-            timer->u.timer.timer_pending = FALSE;
-        }
+            tp_timerqueue_remove( timer );
 
         /* If the last timer object was destroyed, then wake up the thread. */
         if (!--timerqueue.objcount)
         {
-            assert( list_empty( &timerqueue.pending_timers ) );
+            assert( !timerqueue.pending_timers.count );
             RtlWakeAllConditionVariable( &timerqueue.update_event );
         }
 
@@ -1412,6 +1558,284 @@ static void CALLBACK waitqueue_thread_proc( void *param )
     RtlExitUserThread( 0 );
 }
 
+/***********************************************************************
+ *           waitqueue_port_update    (internal)
+ *
+ * Wakes up the multiplexer thread so that it recomputes its timeout.
+ */
+static void waitqueue_port_update( struct waitqueue_bucket *bucket )
+{
+    NtSetIoCompletion( bucket->port, 0, 0, STATUS_SUCCESS, 0 );
+}
+
+/***********************************************************************
+ *           waitqueue_port_insert    (internal)
+ *
+ * Inserts a pending wait into the waiting list of the multiplexed bucket, which is
+ * kept sorted by timeout. Waits without timeout are appended in constant time.
+ */
+static void waitqueue_port_insert( struct waitqueue_bucket *bucket, struct threadpool_object *wait )
+{
+    struct threadpool_object *other;
+
+    if (wait->u.wait.timeout == MAXLONGLONG)
+    {
+        list_add_tail( &bucket->waiting, &wait->u.wait.wait_entry );
+        return;
+    }
+
+    LIST_FOR_EACH_ENTRY( other, &bucket->waiting, struct threadpool_object, u.wait.wait_entry )
+        if (other->u.wait.timeout > wait->u.wait.timeout) break;
+    list_add_before( &other->u.wait.wait_entry, &wait->u.wait.wait_entry );
+
+    /* Wake up the multiplexer thread if the next timeout changed. */
+    if (list_head( &bucket->waiting ) == &wait->u.wait.wait_entry)
+        waitqueue_port_update( bucket );
+}
+
+/***********************************************************************
+ *           waitqueue_port_arm    (internal)
+ *
+ * Associates the wait packet with the handle, the completion is queued to the
+ * port once the handle gets signaled. Holds a reference to the wait object
+ * until the completion is either cancelled or received.
+ */
+static void waitqueue_port_arm( struct waitqueue_bucket *bucket, struct threadpool_object *wait )
+{
+    NTSTATUS status;
+
+    assert( !wait->u.wait.armed );
+    wait->u.wait.arm++;
+    status = NtAssociateWaitCompletionPacket( wait->u.wait.packet, bucket->port, wait->u.wait.handle,
+                                              wait, (void *)wait->u.wait.arm, STATUS_SUCCESS, 0, NULL );
+    if (status)
+    {
+        WARN( "failed to wait on %p, status %#x\n", wait->u.wait.handle, status );
+        return;
+    }
+
+    InterlockedIncrement( &wait->refcount );
+    wait->u.wait.armed = TRUE;
+    bucket->num_armed++;
+}
+
+/***********************************************************************
+ *           waitqueue_port_disarm    (internal)
+ */
+static void waitqueue_port_disarm( struct waitqueue_bucket *bucket, struct threadpool_object *wait )
+{
+    if (!wait->u.wait.armed) return;
+    wait->u.wait.armed = FALSE;
+
+    /* If the completion was already dequeued, the multiplexer thread releases the reference. */
+    if (NtCancelWaitCompletionPacket( wait->u.wait.packet, TRUE )) return;
+
+    bucket->num_armed--;
+    tp_object_release( wait );
+}
+
+/***********************************************************************
+ *           waitqueue_port_execute    (internal)
+ */
+static void waitqueue_port_execute( struct threadpool_object *wait, BOOL signaled )
+{
+    if ((wait->u.wait.flags & (WT_EXECUTEINWAITTHREAD | WT_EXECUTEINIOTHREAD)))
+    {
+        InterlockedIncrement( &wait->refcount );
+        if (signaled) wait->u.wait.signaled++;
+        wait->num_pending_callbacks++;
+        RtlEnterCriticalSection( &wait->pool->cs );
+        tp_object_execute( wait, TRUE );
+        RtlLeaveCriticalSection( &wait->pool->cs );
+        tp_object_release( wait );
+    }
+    else tp_object_submit( wait, signaled );
+}
+
+/***********************************************************************
+ *           waitqueue_port_thread_proc    (internal)
+ *
+ * Multiplexes all non-alertable wait objects on a single completion port, using
+ * one wait completion packet per wait object. Unlike the bucket threads, the
+ * number of wait objects is not limited, and waiting again on a handle does not
+ * require to wake up the thread unless the next timeout changes.
+ */
+static void CALLBACK waitqueue_port_thread_proc( void *param )
+{
+    FILE_IO_COMPLETION_INFORMATION info[MAXIMUM_WAITQUEUE_OBJECTS];
+    struct waitqueue_bucket *bucket = param;
+    struct threadpool_object *wait;
+    LARGE_INTEGER now, timeout, *ptimeout;
+    struct list *ptr;
+    ULONG i, count;
+    NTSTATUS status;
+    BOOL idle;
+
+    TRACE( "starting wait multiplexer thread\n" );
+    set_thread_name(L"wine_threadpool_waitqueue");
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+
+    for (;;)
+    {
+        NtQuerySystemTime( &now );
+
+        while ((ptr = list_head( &bucket->waiting )))
+        {
+            wait = LIST_ENTRY( ptr, struct threadpool_object, u.wait.wait_entry );
+            assert( wait->type == TP_OBJECT_TYPE_WAIT );
+            if (wait->u.wait.timeout > now.QuadPart) break;
+
+            /* Wait object timed out. */
+            list_remove( &wait->u.wait.wait_entry );
+            if ((wait->u.wait.flags & WT_EXECUTEONLYONCE))
+            {
+                waitqueue_port_disarm( bucket, wait );
+                list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+                wait->u.wait.wait_pending = FALSE;
+            }
+            else
+            {
+                /* Restart the timeout, the packet stays associated with the handle. */
+                wait->u.wait.timeout = wait->u.wait.interval ? now.QuadPart + wait->u.wait.interval : MAXLONGLONG;
+                waitqueue_port_insert( bucket, wait );
+            }
+            waitqueue_port_execute( wait, FALSE );
+        }
+
+        idle = !bucket->objcount && !bucket->num_armed;
+        if (idle)
+        {
+            /* All wait objects have been destroyed, if no new wait objects are created
+             * within some amount of time, then we can shutdown this thread. */
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+            ptimeout = &timeout;
+        }
+        else if ((ptr = list_head( &bucket->waiting )) &&
+                 (wait = LIST_ENTRY( ptr, struct threadpool_object, u.wait.wait_entry ))->u.wait.timeout != MAXLONGLONG)
+        {
+            timeout.QuadPart = wait->u.wait.timeout;
+            ptimeout = &timeout;
+        }
+        else ptimeout = NULL;
+
+        RtlLeaveCriticalSection( &waitqueue.cs );
+        status = NtRemoveIoCompletionEx( bucket->port, info, ARRAY_SIZE(info), &count, ptimeout, FALSE );
+        RtlEnterCriticalSection( &waitqueue.cs );
+
+        if (status == STATUS_TIMEOUT)
+        {
+            if (idle && !bucket->objcount && !bucket->num_armed) break;
+            continue;
+        }
+        if (status)
+        {
+            ERR( "failed to remove completion, status %#x\n", status );
+            continue;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            /* A zero key is only used to wake up the thread. */
+            if (!(wait = (struct threadpool_object *)info[i].CompletionKey)) continue;
+            assert( wait->type == TP_OBJECT_TYPE_WAIT );
+            bucket->num_armed--;
+
+            if (wait->u.wait.bucket == bucket && wait->u.wait.armed && wait->u.wait.arm == info[i].CompletionValue)
+            {
+                /* Wait object signaled. */
+                wait->u.wait.armed = FALSE;
+                if ((wait->u.wait.flags & WT_EXECUTEONLYONCE))
+                {
+                    list_remove( &wait->u.wait.wait_entry );
+                    list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+                    wait->u.wait.wait_pending = FALSE;
+                }
+                waitqueue_port_execute( wait, TRUE );
+
+                /* Wait again, unless the callback already did. */
+                if (wait->u.wait.bucket == bucket && wait->u.wait.wait_pending && !wait->u.wait.armed)
+                    waitqueue_port_arm( bucket, wait );
+            }
+
+            /* Release the reference held by the completion. */
+            tp_object_release( wait );
+        }
+    }
+
+    waitqueue.port_bucket = NULL;
+    RtlLeaveCriticalSection( &waitqueue.cs );
+
+    TRACE( "terminating wait multiplexer thread\n" );
+
+    assert( list_empty( &bucket->reserved ) );
+    assert( list_empty( &bucket->waiting ) );
+    NtClose( bucket->port );
+
+    RtlFreeHeap( GetProcessHeap(), 0, bucket );
+    RtlExitUserThread( 0 );
+}
+
+/***********************************************************************
+ *           waitqueue_port_lock    (internal)
+ *
+ * Assigns a wait object to the multiplexed bucket, creating it if needed.
+ * Called with waitqueue.cs held.
+ */
+static NTSTATUS waitqueue_port_lock( struct threadpool_object *wait )
+{
+    struct waitqueue_bucket *bucket = waitqueue.port_bucket;
+    NTSTATUS status;
+    HANDLE thread;
+
+    status = NtCreateWaitCompletionPacket( &wait->u.wait.packet, IO_COMPLETION_ALL_ACCESS, NULL );
+    if (status) return status;
+
+    if (!bucket)
+    {
+        if (!(bucket = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*bucket) )))
+        {
+            status = STATUS_NO_MEMORY;
+            goto failed;
+        }
+
+        bucket->objcount = 0;
+        bucket->alertable = FALSE;
+        bucket->update_event = NULL;
+        bucket->num_armed = 0;
+        list_init( &bucket->reserved );
+        list_init( &bucket->waiting );
+
+        if ((status = NtCreateIoCompletion( &bucket->port, IO_COMPLETION_ALL_ACCESS, NULL, 0 )))
+        {
+            RtlFreeHeap( GetProcessHeap(), 0, bucket );
+            goto failed;
+        }
+
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, 0, 0, 0,
+                                      waitqueue_port_thread_proc, bucket, &thread, NULL );
+        if (status)
+        {
+            NtClose( bucket->port );
+            RtlFreeHeap( GetProcessHeap(), 0, bucket );
+            goto failed;
+        }
+
+        NtClose( thread );
+        waitqueue.port_bucket = bucket;
+    }
+
+    list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+    wait->u.wait.bucket = bucket;
+    bucket->objcount++;
+    return STATUS_SUCCESS;
+
+failed:
+    NtClose( wait->u.wait.packet );
+    wait->u.wait.packet = NULL;
+    return status;
+}
+
 /***********************************************************************
  *           tp_waitqueue_lock    (internal)
  */
@@ -1428,9 +1852,16 @@ static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
     wait->u.wait.wait_pending   = FALSE;
     wait->u.wait.timeout        = 0;
     wait->u.wait.handle         = INVALID_HANDLE_VALUE;
+    wait->u.wait.packet         = NULL;
+    wait->u.wait.armed          = FALSE;
+    wait->u.wait.arm            = 0;
+    wait->u.wait.interval       = 0;
 
     RtlEnterCriticalSection( &waitqueue.cs );
 
+    /* Multiplex non-alertable waits on a completion port if possible. */
+    if (!alertable && !(status = waitqueue_port_lock( wait ))) goto out;
+
     /* Try to assign to existing bucket if possible. */
     LIST_FOR_EACH_ENTRY( bucket, &waitqueue.buckets, struct waitqueue_bucket, bucket_entry )
     {
@@ -1455,6 +1886,8 @@ static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
 
     bucket->objcount = 0;
     bucket->alertable = alertable;
+    bucket->port = NULL;
+    bucket->num_armed = 0;
     list_init( &bucket->reserved );
     list_init( &bucket->waiting );
 
@@ -1507,7 +1940,17 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
         wait->u.wait.bucket = NULL;
         bucket->objcount--;
 
-        NtSetEvent( bucket->update_event, NULL );
+        if (bucket->port)
+        {
+            waitqueue_port_disarm( bucket, wait );
+            if (!bucket->objcount) waitqueue_port_update( bucket );
+        }
+        else NtSetEvent( bucket->update_event, NULL );
+    }
+    if (wait->u.wait.packet)
+    {
+        NtClose( wait->u.wait.packet );
+        wait->u.wait.packet = NULL;
     }
     RtlLeaveCriticalSection( &waitqueue.cs );
 }
@@ -1679,13 +2122,21 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
 
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
+    {
         list_init( &pool->pools[i] );
+        RtlInitializeSListHead( &pool->injection[i] );
+        pool->num_queued_unlocked[i] = 0;
+    }
+    for (i = 0; i < ARRAY_SIZE(pool->num_queued_objects); ++i)
+        pool->num_queued_objects[i] = 0;
     RtlInitializeConditionVariable( &pool->update_event );
 
+    list_init( &pool->workers );
     pool->max_workers             = 500;
     pool->min_workers             = 0;
     pool->num_workers             = 0;
     pool->num_busy_workers        = 0;
+    pool->num_idle_workers        = 0;
     pool->stack_info.StackReserve = nt->OptionalHeader.SizeOfStackReserve;
     pool->stack_info.StackCommit  = nt->OptionalHeader.SizeOfStackCommit;
 
@@ -1727,7 +2178,11 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
     assert( pool->shutdown );
     assert( !pool->objcount );
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
+    {
         assert( list_empty( &pool->pools[i] ) );
+        assert( !pool->num_queued_unlocked[i] );
+    }
+    assert( list_empty( &pool->workers ) );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1787,24 +2242,26 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
         pool = default_threadpool;
     }
 
-    RtlEnterCriticalSection( &pool->cs );
-
-    /* Make sure that the threadpool has at least one thread. */
-    if (!pool->num_workers)
-        status = tp_new_worker_thread( pool );
-
     /* Keep a reference, and increment objcount to ensure that the
      * last thread doesn't terminate. */
-    if (status == STATUS_SUCCESS)
+    InterlockedIncrement( &pool->refcount );
+    InterlockedIncrement( &pool->objcount );
+
+    /* Make sure that the threadpool has at least one thread. */
+    if (!ReadNoFence( &pool->num_workers ))
     {
-        InterlockedIncrement( &pool->refcount );
-        pool->objcount++;
+        RtlEnterCriticalSection( &pool->cs );
+        if (!pool->num_workers)
+            status = tp_new_worker_thread( pool );
+        RtlLeaveCriticalSection( &pool->cs );
     }
 
-    RtlLeaveCriticalSection( &pool->cs );
-
     if (status != STATUS_SUCCESS)
+    {
+        InterlockedDecrement( &pool->objcount );
+        tp_threadpool_release( pool );
         return status;
+    }
 
     *out = pool;
     return STATUS_SUCCESS;
@@ -1817,9 +2274,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
  */
 static void tp_threadpool_unlock( struct threadpool *pool )
 {
-    RtlEnterCriticalSection( &pool->cs );
-    pool->objcount--;
-    RtlLeaveCriticalSection( &pool->cs );
+    InterlockedDecrement( &pool->objcount );
     tp_threadpool_release( pool );
 }
 
@@ -1911,6 +2366,7 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     RtlInitializeConditionVariable( &object->finished_event );
     RtlInitializeConditionVariable( &object->group_finished_event );
     object->completed_event         = NULL;
+    object->injected                = FALSE;
     object->num_pending_callbacks   = 0;
     object->num_running_callbacks   = 0;
     object->num_associated_callbacks = 0;
@@ -1969,10 +2425,118 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
 
 static void tp_object_prio_queue( struct threadpool_object *object )
 {
-    ++object->pool->num_busy_workers;
+    InterlockedIncrement( &object->pool->num_busy_workers );
+    InterlockedIncrement( &object->pool->num_queued_objects[object->priority] );
     list_add_tail( &object->pool->pools[object->priority], &object->pool_entry );
 }
 
+static void tp_object_prio_dequeue( struct threadpool_object *object )
+{
+    InterlockedDecrement( &object->pool->num_queued_objects[object->priority] );
+    list_remove( &object->pool_entry );
+}
+
+static BOOL object_is_finished( struct threadpool_object *object, BOOL group )
+{
+    if (ReadAcquire( &object->num_pending_callbacks ))
+        return FALSE;
+    if (object->type == TP_OBJECT_TYPE_IO && object->u.io.pending_count)
+        return FALSE;
+
+    if (group)
+        return !object->num_running_callbacks;
+    else
+        return !object->num_associated_callbacks;
+}
+
+/* check if an object is queued through the lock-free injection queues */
+static inline BOOL tp_object_is_unlocked( const struct threadpool_object *object )
+{
+    return (object->type == TP_OBJECT_TYPE_SIMPLE || object->type == TP_OBJECT_TYPE_WORK) && !object->group;
+}
+
+/***********************************************************************
+ *           tp_object_inject    (internal)
+ *
+ * Pushes an object with pending callbacks to the injection queue, unless
+ * it's already queued. The queue holds a reference to the object.
+ */
+static void tp_object_inject( struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+
+    if (InterlockedCompareExchange( &object->injected, TRUE, FALSE )) return;
+
+    InterlockedIncrement( &object->refcount );
+    RtlInterlockedPushEntrySList( &pool->injection[object->priority], &object->injection_entry );
+    InterlockedIncrement( &pool->num_queued_unlocked[object->priority] );
+
+    /* The increment above pairs with the one of num_idle_workers in threadpool_worker_proc,
+     * either the worker sees the new callback, or we see that it's about to sleep. */
+    if (!ReadNoFence( &pool->num_idle_workers ) &&
+        ReadNoFence( &pool->num_busy_workers ) < ReadNoFence( &pool->num_workers ))
+        return;
+
+    RtlEnterCriticalSection( &pool->cs );
+    if (pool->num_idle_workers)
+        RtlWakeConditionVariable( &pool->update_event );
+    else if (pool->num_busy_workers >= pool->num_workers && pool->num_workers < pool->max_workers)
+        tp_new_worker_thread( pool );
+    RtlLeaveCriticalSection( &pool->cs );
+}
+
+/***********************************************************************
+ *           tp_object_submit_unlocked    (internal)
+ *
+ * Submits a simple callback or a work item without cleanup group. The
+ * pending callbacks are counted atomically, so that the pool lock is only
+ * needed to cancel or wait for them.
+ */
+static void tp_object_submit_unlocked( struct threadpool_object *object )
+{
+    InterlockedIncrement( &object->refcount );
+    InterlockedIncrement( &object->num_pending_callbacks );
+    tp_object_inject( object );
+}
+
+/***********************************************************************
+ *           tp_object_claim_unlocked    (internal)
+ *
+ * Takes a pending callback of an object removed from the injection queues,
+ * and queues the object again if it has more. Returns FALSE if the callbacks
+ * have been cancelled meanwhile.
+ */
+static BOOL tp_object_claim_unlocked( struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+    LONG pending;
+
+    /* Callbacks submitted from now on queue the object again. */
+    InterlockedExchange( &object->injected, FALSE );
+
+    /* Count the callback as running before it stops being pending,
+     * so that tp_object_wait never sees the object as finished meanwhile. */
+    InterlockedIncrement( &object->num_associated_callbacks );
+    InterlockedIncrement( &object->num_running_callbacks );
+    do
+    {
+        if (!(pending = ReadAcquire( &object->num_pending_callbacks ))) break;
+    } while (InterlockedCompareExchange( &object->num_pending_callbacks, pending - 1, pending ) != pending);
+
+    if (pending > 1) tp_object_inject( object );
+    if (pending) return TRUE;
+
+    RtlEnterCriticalSection( &pool->cs );
+    InterlockedDecrement( &object->num_running_callbacks );
+    if (object_is_finished( object, TRUE ))
+        RtlWakeAllConditionVariable( &object->group_finished_event );
+    InterlockedDecrement( &object->num_associated_callbacks );
+    if (object_is_finished( object, FALSE ))
+        RtlWakeAllConditionVariable( &object->finished_event );
+    RtlLeaveCriticalSection( &pool->cs );
+    return FALSE;
+}
+
 /***********************************************************************
  *           tp_object_submit    (internal)
  *
@@ -1987,6 +2551,12 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
+    if (tp_object_is_unlocked( object ))
+    {
+        tp_object_submit_unlocked( object );
+        return;
+    }
+
     RtlEnterCriticalSection( &pool->cs );
 
     /* Start new worker threads if required. */
@@ -2024,11 +2594,16 @@ static void tp_object_cancel( struct threadpool_object *object )
     LONG pending_callbacks = 0;
 
     RtlEnterCriticalSection( &pool->cs );
-    if (object->num_pending_callbacks)
+    if (tp_object_is_unlocked( object ))
+    {
+        /* the object is dropped when a worker takes it from the queues */
+        pending_callbacks = InterlockedExchange( &object->num_pending_callbacks, 0 );
+    }
+    else if (object->num_pending_callbacks)
     {
         pending_callbacks = object->num_pending_callbacks;
         object->num_pending_callbacks = 0;
-        list_remove( &object->pool_entry );
+        tp_object_prio_dequeue( object );
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
@@ -2044,19 +2619,6 @@ static void tp_object_cancel( struct threadpool_object *object )
         tp_object_release( object );
 }
 
-static BOOL object_is_finished( struct threadpool_object *object, BOOL group )
-{
-    if (object->num_pending_callbacks)
-        return FALSE;
-    if (object->type == TP_OBJECT_TYPE_IO && object->u.io.pending_count)
-        return FALSE;
-
-    if (group)
-        return !object->num_running_callbacks;
-    else
-        return !object->num_associated_callbacks;
-}
-
 /***********************************************************************
  *           tp_object_wait    (internal)
  *
@@ -2170,7 +2732,7 @@ static struct list *threadpool_get_next_item( const struct threadpool *pool )
  *           tp_object_execute    (internal)
  *
  * Executes a threadpool object callback, object->pool->cs has to be
- * held.
+ * held, unless the object was queued without it.
  */
 static void tp_object_execute( struct threadpool_object *object, BOOL wait_thread )
 {
@@ -2178,10 +2740,17 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
     struct threadpool_instance instance;
     struct io_completion completion;
     struct threadpool *pool = object->pool;
+    BOOL locked = !tp_object_is_unlocked( object );
     TP_WAIT_RESULT wait_result = 0;
     NTSTATUS status;
 
-    object->num_pending_callbacks--;
+    /* objects queued without the lock have been claimed by tp_object_claim_unlocked */
+    if (locked)
+    {
+        object->num_pending_callbacks--;
+        InterlockedIncrement( &object->num_associated_callbacks );
+        InterlockedIncrement( &object->num_running_callbacks );
+    }
 
     /* For wait objects check if they were signaled or have timed out. */
     if (object->type == TP_OBJECT_TYPE_WAIT)
@@ -2196,9 +2765,7 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
     }
 
     /* Leave critical section and do the actual callback. */
-    object->num_associated_callbacks++;
-    object->num_running_callbacks++;
-    RtlLeaveCriticalSection( &pool->cs );
+    if (locked) RtlLeaveCriticalSection( &pool->cs );
     if (wait_thread) RtlLeaveCriticalSection( &waitqueue.cs );
 
     /* Initialize threadpool instance struct. */
@@ -2304,7 +2871,8 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
 
 skip_cleanup:
     if (wait_thread) RtlEnterCriticalSection( &waitqueue.cs );
-    RtlEnterCriticalSection( &pool->cs );
+    /* work items queued without the lock may still be waited on */
+    if (locked || object->type == TP_OBJECT_TYPE_WORK) RtlEnterCriticalSection( &pool->cs );
 
     /* Simple callbacks are automatically shutdown after execution. */
     if (object->type == TP_OBJECT_TYPE_SIMPLE)
@@ -2313,16 +2881,155 @@ skip_cleanup:
         object->shutdown = TRUE;
     }
 
-    object->num_running_callbacks--;
+    InterlockedDecrement( &object->num_running_callbacks );
     if (object_is_finished( object, TRUE ))
         RtlWakeAllConditionVariable( &object->group_finished_event );
 
     if (instance.associated)
     {
-        object->num_associated_callbacks--;
+        InterlockedDecrement( &object->num_associated_callbacks );
         if (object_is_finished( object, FALSE ))
             RtlWakeAllConditionVariable( &object->finished_event );
     }
+
+    if (!locked && object->type == TP_OBJECT_TYPE_WORK) RtlLeaveCriticalSection( &pool->cs );
+}
+
+/* highest priority of the objects queued without the lock,
+ * or ARRAY_SIZE(pool->injection) if there are none */
+static unsigned int threadpool_unlocked_priority( struct threadpool *pool )
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(pool->num_queued_unlocked); ++i)
+        if (ReadNoFence( &pool->num_queued_unlocked[i] )) break;
+    return i;
+}
+
+/* highest priority of the objects queued in the pool lists */
+static unsigned int threadpool_locked_priority( struct threadpool *pool )
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(pool->num_queued_objects); ++i)
+        if (ReadNoFence( &pool->num_queued_objects[i] )) break;
+    return i;
+}
+
+/* check if there are objects queued without the lock */
+static BOOL threadpool_has_unlocked_items( struct threadpool *pool )
+{
+    return threadpool_unlocked_priority( pool ) < ARRAY_SIZE(pool->injection);
+}
+
+/* take the oldest callback of the worker's own queue */
+static struct threadpool_object *threadpool_worker_pop( struct threadpool_worker *worker, unsigned int prio )
+{
+    struct list *ptr;
+
+    RtlAcquireSRWLockExclusive( &worker->lock );
+    if ((ptr = list_head( &worker->queues[prio] ))) list_remove( ptr );
+    RtlReleaseSRWLockExclusive( &worker->lock );
+    return ptr ? LIST_ENTRY( ptr, struct threadpool_object, pool_entry ) : NULL;
+}
+
+/* move the callbacks of the pool injection queue to the worker's own queue */
+static struct threadpool_object *threadpool_worker_take_injected( struct threadpool *pool,
+                                                                  struct threadpool_worker *worker,
+                                                                  unsigned int prio )
+{
+    SLIST_ENTRY *entry = RtlInterlockedFlushSList( &pool->injection[prio] );
+    struct threadpool_object *object;
+    struct list *ptr;
+
+    if (!entry) return NULL;
+
+    /* the injection queue is LIFO, the oldest entry is the last one */
+    RtlAcquireSRWLockExclusive( &worker->lock );
+    for (; entry; entry = entry->Next)
+    {
+        object = CONTAINING_RECORD( entry, struct threadpool_object, injection_entry );
+        list_add_head( &worker->queues[prio], &object->pool_entry );
+    }
+    ptr = list_head( &worker->queues[prio] );
+    list_remove( ptr );
+    RtlReleaseSRWLockExclusive( &worker->lock );
+    return LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+}
+
+/* steal the newest callbacks from the queue of another worker */
+static struct threadpool_object *threadpool_worker_steal( struct threadpool *pool,
+                                                          struct threadpool_worker *worker,
+                                                          unsigned int prio )
+{
+    struct threadpool_worker *victim;
+    struct list stolen = LIST_INIT( stolen );
+    struct list *ptr;
+    unsigned int count = 0;
+
+    RtlEnterCriticalSection( &pool->cs );
+    LIST_FOR_EACH_ENTRY( victim, &pool->workers, struct threadpool_worker, entry )
+    {
+        if (victim == worker) continue;
+        RtlAcquireSRWLockExclusive( &victim->lock );
+        while (count < THREADPOOL_STEAL_COUNT && (ptr = list_tail( &victim->queues[prio] )))
+        {
+            list_remove( ptr );
+            list_add_head( &stolen, ptr );
+            count++;
+        }
+        RtlReleaseSRWLockExclusive( &victim->lock );
+        if (count) break;
+    }
+    RtlLeaveCriticalSection( &pool->cs );
+
+    if (!(ptr = list_head( &stolen ))) return NULL;
+    list_remove( ptr );
+    if (!list_empty( &stolen ))
+    {
+        RtlAcquireSRWLockExclusive( &worker->lock );
+        list_move_tail( &worker->queues[prio], &stolen );
+        RtlReleaseSRWLockExclusive( &worker->lock );
+    }
+    return LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+}
+
+/***********************************************************************
+ *           threadpool_worker_run_unlocked    (internal)
+ *
+ * Executes the callbacks queued without the pool lock, until there
+ * are none left or objects with the same or a higher priority are queued
+ * in the pool lists.
+ */
+static void threadpool_worker_run_unlocked( struct threadpool *pool, struct threadpool_worker *worker )
+{
+    struct threadpool_object *object;
+    unsigned int i;
+
+    for (;;)
+    {
+        object = NULL;
+        for (i = 0; i < ARRAY_SIZE(pool->injection) && !object; ++i)
+        {
+            if (!ReadNoFence( &pool->num_queued_unlocked[i] )) continue;
+            if (threadpool_locked_priority( pool ) <= i) return;
+            if (!(object = threadpool_worker_pop( worker, i )) &&
+                !(object = threadpool_worker_take_injected( pool, worker, i )))
+                object = threadpool_worker_steal( pool, worker, i );
+        }
+        if (!object) break;
+
+        InterlockedDecrement( &pool->num_queued_unlocked[object->priority] );
+        if (tp_object_claim_unlocked( object ))
+        {
+            InterlockedIncrement( &pool->num_busy_workers );
+            tp_object_execute( object, FALSE );
+            InterlockedDecrement( &pool->num_busy_workers );
+            tp_object_release( object );
+        }
+        /* release the reference of the injection queue */
+        tp_object_release( object );
+    }
 }
 
 /***********************************************************************
@@ -2331,13 +3038,21 @@ skip_cleanup:
 static void CALLBACK threadpool_worker_proc( void *param )
 {
     struct threadpool *pool = param;
+    struct threadpool_worker worker;
     LARGE_INTEGER timeout;
     struct list *ptr;
+    unsigned int i;
+    NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
     set_thread_name(L"wine_threadpool_worker");
 
+    RtlInitializeSRWLock( &worker.lock );
+    for (i = 0; i < ARRAY_SIZE(worker.queues); ++i)
+        list_init( &worker.queues[i] );
+
     RtlEnterCriticalSection( &pool->cs );
+    list_add_tail( &pool->workers, &worker.entry );
     for (;;)
     {
         while ((ptr = threadpool_get_next_item( pool )))
@@ -2345,23 +3060,47 @@ static void CALLBACK threadpool_worker_proc( void *param )
             struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
             assert( object->num_pending_callbacks > 0 );
 
+            /* Callbacks queued without the lock with a higher priority run first. */
+            if (threadpool_unlocked_priority( pool ) < object->priority)
+                break;
+
             /* If further pending callbacks are queued, move the work item to
              * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
+            tp_object_prio_dequeue( object );
             if (object->num_pending_callbacks > 1)
                 tp_object_prio_queue( object );
 
             tp_object_execute( object, FALSE );
 
             assert(pool->num_busy_workers);
-            pool->num_busy_workers--;
+            InterlockedDecrement( &pool->num_busy_workers );
 
             tp_object_release( object );
         }
 
+        if (threadpool_has_unlocked_items( pool ))
+        {
+            RtlLeaveCriticalSection( &pool->cs );
+            threadpool_worker_run_unlocked( pool, &worker );
+            RtlEnterCriticalSection( &pool->cs );
+            continue;
+        }
+
         /* Shutdown worker thread if requested. */
         if (pool->shutdown)
+        {
+            pool->num_workers--;
             break;
+        }
+
+        /* Check again for unlocked items after announcing that we are going to
+         * sleep, tp_object_submit_unlocked does the opposite. */
+        InterlockedIncrement( &pool->num_idle_workers );
+        if (threadpool_has_unlocked_items( pool ))
+        {
+            InterlockedDecrement( &pool->num_idle_workers );
+            continue;
+        }
 
         /* Wait for new tasks or until the timeout expires. A thread only terminates
          * when no new tasks are available, and the number of threads can be
@@ -2369,14 +3108,25 @@ static void CALLBACK threadpool_worker_proc( void *param )
          * min_workers == 0, then objcount is used to detect if the last thread
          * can be terminated. */
         timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !threadpool_get_next_item( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
+        status = RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout );
+        InterlockedDecrement( &pool->num_idle_workers );
+        if (status == STATUS_TIMEOUT && !threadpool_get_next_item( pool ) &&
+            !threadpool_has_unlocked_items( pool ) &&
+            (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
-            break;
+            /* tp_object_submit_unlocked and tp_threadpool_lock don't take the lock
+             * while they see this thread in num_workers. The interlocked decrement
+             * orders against their increments, so anything they queued meanwhile
+             * is visible here and the thread keeps running to process it. */
+            InterlockedDecrement( &pool->num_workers );
+            if (!threadpool_has_unlocked_items( pool ) &&
+                (pool->num_workers || !ReadNoFence( &pool->objcount )))
+                break;
+            InterlockedIncrement( &pool->num_workers );
         }
     }
-    pool->num_workers--;
+    list_remove( &worker.entry );
     RtlLeaveCriticalSection( &pool->cs );
 
     TRACE( "terminating worker thread for pool %p\n", pool );
@@ -2723,7 +3473,7 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
     pool = object->pool;
     RtlEnterCriticalSection( &pool->cs );
 
-    object->num_associated_callbacks--;
+    InterlockedDecrement( &object->num_associated_callbacks );
     if (object_is_finished( object, FALSE ))
         RtlWakeAllConditionVariable( &object->finished_event );
 
@@ -2969,7 +3719,6 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
     ULONGLONG timestamp;
 
@@ -3007,10 +3756,7 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
 
     /* First remove existing timeout. */
     if (this->u.timer.timer_pending)
-    {
-        list_remove( &this->u.timer.timer_entry );
-        this->u.timer.timer_pending = FALSE;
-    }
+        tp_timerqueue_remove( this );
 
     /* If the timer was enabled, then add it back to the queue. */
     if (timeout)
@@ -3019,20 +3765,9 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
         this->u.timer.period        = period;
         this->u.timer.window_length = window_length;
 
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
-
         /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+        if (tp_timerqueue_insert( this ))
             RtlWakeAllConditionVariable( &timerqueue.update_event );
-
-        this->u.timer.timer_pending = TRUE;
     }
 
     RtlLeaveCriticalSection( &timerqueue.cs );
@@ -3060,8 +3795,10 @@ VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
     {
         struct waitqueue_bucket *bucket = this->u.wait.bucket;
         list_remove( &this->u.wait.wait_entry );
+        if (bucket->port) waitqueue_port_disarm( bucket, this );
 
         /* Convert relative timeout to absolute timestamp. */
+        this->u.wait.interval = 0;
         if (handle && timeout)
         {
             timestamp = timeout->QuadPart;
@@ -3070,15 +3807,21 @@ VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
                 LARGE_INTEGER now;
                 NtQuerySystemTime( &now );
                 timestamp = now.QuadPart - timestamp;
+                this->u.wait.interval = -timeout->QuadPart;
             }
         }
 
         /* Add wait object back into one of the queues. */
         if (handle)
         {
-            list_add_tail( &bucket->waiting, &this->u.wait.wait_entry );
             this->u.wait.wait_pending = TRUE;
             this->u.wait.timeout = timestamp;
+            if (bucket->port)
+            {
+                waitqueue_port_insert( bucket, this );
+                waitqueue_port_arm( bucket, this );
+            }
+            else list_add_tail( &bucket->waiting, &this->u.wait.wait_entry );
         }
         else
         {
@@ -3087,7 +3830,7 @@ VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
         }
 
         /* Wake up the wait queue thread. */
-        NtSetEvent( bucket->update_event, NULL );
+        if (!bucket->port) NtSetEvent( bucket->update_event, NULL );
     }
 
     RtlLeaveCriticalSection( &waitqueue.cs );
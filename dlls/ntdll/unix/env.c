@@ -481,6 +481,15 @@ const char *ntdll_get_data_dir(void)
 }
 
 
+/***********************************************************************
+ *           ntdll_get_config_dir  (ntdll.so)
+ */
+const char *ntdll_get_config_dir(void)
+{
+    return config_dir;
+}
+
+
 /***********************************************************************
  *           build_envp
  *
@@ -211,6 +211,16 @@ struct dir_data
     struct file_identity    id;      /* directory file identity */
     struct dir_data_names  *names;   /* directory file names */
     struct dir_data_buffer *buffer;  /* head of data buffers list */
+    struct dir_listing     *listing; /* shared listing that the names point into */
+};
+
+/* complete directory contents, shared by all the handles enumerating the directory */
+struct dir_listing
+{
+    struct list             entry;    /* entry in dir_listing_list, most recently used first */
+    unsigned int            refcount; /* references from the list and from dir_data */
+    LONGLONG                mtime;    /* directory modification time */
+    struct dir_data        *data;     /* sorted directory contents */
 };
 
 static const unsigned int dir_data_buffer_initial_size = 4096;
@@ -220,6 +230,40 @@ static const unsigned int dir_data_names_initial_size  = 64;
 static struct dir_data **dir_data_cache;
 static unsigned int dir_data_cache_size;
 
+static const unsigned int dir_listing_max_count = 16;
+static struct list dir_listing_list = LIST_INIT( dir_listing_list );
+static unsigned int dir_listing_count;
+
+/* case-insensitive lookup table of the names in a directory */
+struct dir_lookup_name
+{
+    unsigned int hash;               /* hash of the upper-case name */
+    unsigned int len;                /* length of the name in WCHARs */
+    unsigned int name;               /* offset of the upper-case Unicode name in the data */
+    unsigned int unix_name;          /* offset of the Unix file name in the data */
+};
+
+struct dir_lookup
+{
+    struct list             entry;   /* entry in dir_lookup_list, most recently used first */
+    struct file_identity    id;      /* directory file identity */
+    LONGLONG                mtime;   /* directory modification time */
+    unsigned int            count;   /* count of names */
+    unsigned int            mask;    /* size of the hash table - 1 */
+    unsigned int           *table;   /* hash table of name indices + 1 */
+    struct dir_lookup_name *names;   /* names array */
+    char                   *data;    /* names data */
+};
+
+static const unsigned int dir_lookup_max_count = 64;
+/* directories modified less than this ago are not cached, as a change may not be visible in the mtime */
+static const LONGLONG dir_cache_min_age = 2 * TICKSPERSEC;
+
+static struct list dir_lookup_list = LIST_INIT( dir_lookup_list );
+static unsigned int dir_lookup_count;
+static unsigned int dir_lookup_hits;
+static unsigned int dir_lookup_misses;
+
 static BOOL show_dot_files;
 static mode_t start_umask;
 
@@ -228,6 +272,7 @@ static const BOOL is_case_sensitive = FALSE;
 
 static pthread_mutex_t dir_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t mnt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t dir_lookup_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* check if a given Unicode char is OK in a DOS short name */
 static inline BOOL is_invalid_dos_char( WCHAR ch )
@@ -409,7 +454,8 @@ static BOOL add_dir_data_names( struct dir_data *data, const WCHAR *long_name,
         data->names = names;
     }
 
-    if (short_name[0])
+    if (!short_name) names[data->count].short_name = NULL;  /* generated on demand */
+    else if (short_name[0])
     {
         if (!(names[data->count].short_name = add_dir_data_nameW( data, short_name ))) return FALSE;
     }
@@ -421,12 +467,15 @@ static BOOL add_dir_data_names( struct dir_data *data, const WCHAR *long_name,
     return TRUE;
 }
 
+static void release_dir_listing( struct dir_listing *listing );
+
 /* free the complete directory data structure */
 static void free_dir_data( struct dir_data *data )
 {
     struct dir_data_buffer *buffer, *next;
 
     if (!data) return;
+    if (data->listing) release_dir_listing( data->listing );
 
     for (buffer = data->buffer; buffer; buffer = next)
     {
@@ -437,6 +486,14 @@ static void free_dir_data( struct dir_data *data )
     free( data );
 }
 
+/* release a reference to a shared directory listing */
+static void release_dir_listing( struct dir_listing *listing )
+{
+    if (--listing->refcount) return;
+    free_dir_data( listing->data );
+    free( listing );
+}
+
 
 /* support for a directory queue for filesystem searches */
 
@@ -1414,12 +1471,17 @@ static BOOL append_entry( struct dir_data *data, const char *long_name,
         short_len = ntdll_umbstowcs( short_name, strlen(short_name),
                                      short_nameW, ARRAY_SIZE( short_nameW ) - 1 );
     }
-    else  /* generate a short name if necessary */
+    else if (mask)  /* generate a short name if necessary */
     {
         short_len = 0;
         if (!is_legal_8dot3_name( long_nameW, long_len ))
             short_len = hash_short_file_name( long_nameW, long_len, short_nameW );
     }
+    else  /* no need to generate it until it's asked for */
+    {
+        TRACE( "long %s\n", debugstr_w( long_nameW ));
+        return add_dir_data_names( data, long_nameW, NULL, long_name );
+    }
     short_nameW[short_len] = 0;
     wcsupr( short_nameW );
 
@@ -1436,6 +1498,30 @@ static BOOL append_entry( struct dir_data *data, const char *long_name,
 }
 
 
+/***********************************************************************
+ *           get_dir_data_short_name
+ *
+ * Return the short name of a directory entry, generating it if necessary.
+ */
+static const WCHAR *get_dir_data_short_name( struct dir_data *data, struct dir_data_names *names )
+{
+    static const WCHAR empty[1];
+    WCHAR short_nameW[13];
+    int len;
+
+    if (names->short_name) return names->short_name;
+
+    len = wcslen( names->long_name );
+    if (is_legal_8dot3_name( names->long_name, len )) return names->short_name = empty;
+
+    len = hash_short_file_name( names->long_name, len, short_nameW );
+    short_nameW[len] = 0;
+    wcsupr( short_nameW );
+    if (!(names->short_name = add_dir_data_nameW( data, short_nameW ))) return empty;
+    return names->short_name;
+}
+
+
 /* fetch the attributes of a file */
 static inline ULONG get_file_attributes( const struct stat *st )
 {
@@ -2036,7 +2122,8 @@ static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, I
                                     ULONG max_length, FILE_INFORMATION_CLASS class,
                                     union file_directory_info **last_info )
 {
-    const struct dir_data_names *names = &dir_data->names[dir_data->pos];
+    struct dir_data_names *names = &dir_data->names[dir_data->pos];
+    const WCHAR *short_name;
     union file_directory_info *info;
     struct stat st;
     ULONG name_len, start, dir_size, attributes;
@@ -2094,15 +2181,17 @@ static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, I
 
     case FileBothDirectoryInformation:
         info->both.EaSize = 0; /* FIXME */
-        info->both.ShortNameLength = wcslen( names->short_name ) * sizeof(WCHAR);
-        memcpy( info->both.ShortName, names->short_name, info->both.ShortNameLength );
+        short_name = get_dir_data_short_name( dir_data, names );
+        info->both.ShortNameLength = wcslen( short_name ) * sizeof(WCHAR);
+        memcpy( info->both.ShortName, short_name, info->both.ShortNameLength );
         info->both.FileNameLength = name_len;
         break;
 
     case FileIdBothDirectoryInformation:
         info->id_both.EaSize = 0; /* FIXME */
-        info->id_both.ShortNameLength = wcslen( names->short_name ) * sizeof(WCHAR);
-        memcpy( info->id_both.ShortName, names->short_name, info->id_both.ShortNameLength );
+        short_name = get_dir_data_short_name( dir_data, names );
+        info->id_both.ShortNameLength = wcslen( short_name ) * sizeof(WCHAR);
+        memcpy( info->id_both.ShortName, short_name, info->id_both.ShortNameLength );
         info->id_both.FileNameLength = name_len;
         break;
 
@@ -2320,6 +2409,142 @@ static int name_compare( const void *a, const void *b )
 }
 
 
+/* sort the directory file names, but not "." and ".." */
+static void sort_dir_data( struct dir_data *data )
+{
+    unsigned int i = 0;
+
+    if (i < data->count && !strcmp( data->names[i].unix_name, "." )) i++;
+    if (i < data->count && !strcmp( data->names[i].unix_name, ".." )) i++;
+    if (i < data->count) qsort( data->names + i, data->count - i, sizeof(*data->names), name_compare );
+}
+
+
+/* get the modification time of a directory, used to validate cached contents */
+static LONGLONG get_dir_mtime( const struct stat *st )
+{
+    LONGLONG mtime = ticks_from_time_t( st->st_mtime );
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    mtime += st->st_mtim.tv_nsec / 100;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    mtime += st->st_mtimespec.tv_nsec / 100;
+#endif
+    return mtime;
+}
+
+
+/* check if a directory was modified too recently for its contents to be cached */
+static BOOL is_dir_mtime_recent( LONGLONG mtime )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_REALTIME, &now );
+    return ticks_from_time_t( now.tv_sec ) + now.tv_nsec / 100 - mtime < dir_cache_min_age;
+}
+
+
+/***********************************************************************
+ *           get_dir_listing
+ *
+ * Retrieve the complete contents of the current directory, from the cache
+ * if they haven't been modified since they were last read.
+ */
+static struct dir_listing *get_dir_listing( int fd )
+{
+    struct dir_listing *listing;
+    struct stat st;
+    LONGLONG mtime;
+    BOOL recent;
+
+    if (fstat( fd, &st ) == -1) return NULL;
+    mtime = get_dir_mtime( &st );
+
+    LIST_FOR_EACH_ENTRY( listing, &dir_listing_list, struct dir_listing, entry )
+    {
+        if (listing->data->id.dev != st.st_dev || listing->data->id.ino != st.st_ino) continue;
+        list_remove( &listing->entry );
+        if (listing->mtime == mtime)
+        {
+            TRACE( "using cached listing of %u files\n", listing->data->count );
+            list_add_head( &dir_listing_list, &listing->entry );
+            listing->refcount++;
+            return listing;
+        }
+        dir_listing_count--;
+        release_dir_listing( listing );
+        break;
+    }
+
+    recent = is_dir_mtime_recent( mtime );
+
+    if (!(listing = calloc( 1, sizeof(*listing) ))) return NULL;
+    if (!(listing->data = calloc( 1, sizeof(*listing->data) )) || read_directory_data( listing->data, fd, NULL ))
+    {
+        free_dir_data( listing->data );
+        free( listing );
+        return NULL;
+    }
+    sort_dir_data( listing->data );
+    listing->data->id.dev = st.st_dev;
+    listing->data->id.ino = st.st_ino;
+    listing->mtime = mtime;
+    listing->refcount = 1;
+
+    if (recent) return listing;  /* may still change without a visible mtime update */
+
+    if (dir_listing_count == dir_listing_max_count)
+    {
+        struct dir_listing *old = LIST_ENTRY( list_tail( &dir_listing_list ), struct dir_listing, entry );
+        list_remove( &old->entry );
+        release_dir_listing( old );
+        dir_listing_count--;
+    }
+    list_add_head( &dir_listing_list, &listing->entry );
+    dir_listing_count++;
+    listing->refcount++;
+    return listing;
+}
+
+
+/***********************************************************************
+ *           copy_dir_listing
+ *
+ * Initialize the directory data with the names of a listing matching the mask.
+ */
+static BOOL copy_dir_listing( struct dir_data *data, struct dir_listing *listing, const UNICODE_STRING *mask )
+{
+    struct dir_data_names *names;
+    const WCHAR *short_name;
+    unsigned int i;
+
+    data->listing = listing;
+    data->id = listing->data->id;
+    if (!listing->data->count) return TRUE;
+    if (!(data->names = malloc( listing->data->count * sizeof(*data->names) ))) return FALSE;
+    data->size = listing->data->count;
+
+    if (!mask || (mask->Length == sizeof(WCHAR) && mask->Buffer[0] == '*'))
+    {
+        memcpy( data->names, listing->data->names, listing->data->count * sizeof(*data->names) );
+        data->count = listing->data->count;
+        return TRUE;
+    }
+
+    for (i = 0; i < listing->data->count; i++)
+    {
+        names = &listing->data->names[i];
+        if (!match_filename( names->long_name, wcslen( names->long_name ), mask ))
+        {
+            /* short names are stored in the listing so that they are only generated once */
+            short_name = get_dir_data_short_name( listing->data, names );
+            if (!short_name[0] || !match_filename( short_name, wcslen( short_name ), mask )) continue;
+        }
+        data->names[data->count++] = *names;
+    }
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           init_cached_dir_data
  *
@@ -2327,6 +2552,7 @@ static int name_compare( const void *a, const void *b )
  */
 static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const UNICODE_STRING *mask )
 {
+    struct dir_listing *listing;
     struct dir_data *data;
     struct stat st;
     NTSTATUS status;
@@ -2334,19 +2560,26 @@ static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const
 
     if (!(data = calloc( 1, sizeof(*data) ))) return STATUS_NO_MEMORY;
 
-    if ((status = read_directory_data( data, fd, mask )))
+    /* wildcard searches are served from the complete listing, which is shared between handles */
+    if (has_wildcard( mask ) && (listing = get_dir_listing( fd )))
     {
-        free_dir_data( data );
-        return status;
+        if (!copy_dir_listing( data, listing, mask ))
+        {
+            free_dir_data( data );
+            return STATUS_NO_MEMORY;
+        }
+    }
+    else
+    {
+        if ((status = read_directory_data( data, fd, mask )))
+        {
+            free_dir_data( data );
+            return status;
+        }
+        sort_dir_data( data );
     }
 
-    /* sort filenames, but not "." and ".." */
-    i = 0;
-    if (i < data->count && !strcmp( data->names[i].unix_name, "." )) i++;
-    if (i < data->count && !strcmp( data->names[i].unix_name, ".." )) i++;
-    if (i < data->count) qsort( data->names + i, data->count - i, sizeof(*data->names), name_compare );
-
-    if (data->count)
+    if (data->count && !data->listing)
     {
         fstat( fd, &st );
         data->id.dev = st.st_dev;
@@ -2511,6 +2744,231 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+/***********************************************************************
+ *           hash_dir_lookup_name
+ */
+static unsigned int hash_dir_lookup_name( const WCHAR *name, unsigned int len )
+{
+    unsigned int hash = 0;
+
+    while (len--) hash = hash * 31 + *name++;
+    return hash;
+}
+
+
+/***********************************************************************
+ *           free_dir_lookup
+ */
+static void free_dir_lookup( struct dir_lookup *lookup )
+{
+    free( lookup->table );
+    free( lookup->names );
+    free( lookup->data );
+    free( lookup );
+}
+
+
+/***********************************************************************
+ *           add_dir_lookup_data
+ *
+ * Append data to the names data of a lookup table, returning its offset.
+ */
+static int add_dir_lookup_data( struct dir_lookup *lookup, unsigned int *size, unsigned int *pos,
+                                const void *data, unsigned int len )
+{
+    unsigned int ret = *pos, aligned_len = (len + sizeof(WCHAR) - 1) & ~(sizeof(WCHAR) - 1);
+
+    if (*size - *pos < aligned_len)
+    {
+        unsigned int new_size = max( *size * 2, *pos + aligned_len );
+        char *new_data = realloc( lookup->data, new_size );
+
+        if (!new_data) return -1;
+        lookup->data = new_data;
+        *size = new_size;
+    }
+    memcpy( lookup->data + *pos, data, len );
+    *pos += aligned_len;
+    return ret;
+}
+
+
+/***********************************************************************
+ *           read_dir_lookup
+ *
+ * Read the names of a directory into a case-insensitive lookup table.
+ */
+static NTSTATUS read_dir_lookup( const char *unix_name, struct dir_lookup **ret )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_lookup *lookup;
+    struct dir_lookup_name *name;
+    unsigned int i, size = 0, data_size = 4096, data_pos = 0;
+    struct dirent *de;
+    DIR *dir;
+    int len, name_offset, unix_offset;
+
+    if (!(dir = opendir( unix_name ))) return errno_to_status( errno );
+
+    if (!(lookup = calloc( 1, sizeof(*lookup) )) || !(lookup->data = malloc( data_size ))) goto nomem;
+
+    while ((de = readdir( dir )))
+    {
+        if (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." )) continue;
+        len = ntdll_umbstowcs( de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
+        for (i = 0; i < len; i++) buffer[i] = towupper( buffer[i] );
+
+        if (lookup->count == size)
+        {
+            struct dir_lookup_name *new_names;
+
+            size = max( 64, size * 2 );
+            if (!(new_names = realloc( lookup->names, size * sizeof(*new_names) ))) goto nomem;
+            lookup->names = new_names;
+        }
+        if ((name_offset = add_dir_lookup_data( lookup, &data_size, &data_pos, buffer,
+                                                len * sizeof(WCHAR) )) == -1) goto nomem;
+        if ((unix_offset = add_dir_lookup_data( lookup, &data_size, &data_pos, de->d_name,
+                                                strlen(de->d_name) + 1 )) == -1) goto nomem;
+
+        name = &lookup->names[lookup->count++];
+        name->hash      = hash_dir_lookup_name( buffer, len );
+        name->len       = len;
+        name->name      = name_offset;
+        name->unix_name = unix_offset;
+    }
+    closedir( dir );
+
+    /* build the hash table with a load factor of at most 1/2 */
+    for (size = 16; size < 2 * lookup->count; size *= 2) ;
+    if (!(lookup->table = calloc( size, sizeof(*lookup->table) ))) goto nomem_closed;
+    lookup->mask = size - 1;
+    for (i = 0; i < lookup->count; i++)
+    {
+        unsigned int pos = lookup->names[i].hash & lookup->mask;
+        while (lookup->table[pos]) pos = (pos + 1) & lookup->mask;
+        lookup->table[pos] = i + 1;
+    }
+    *ret = lookup;
+    return STATUS_SUCCESS;
+
+nomem:
+    closedir( dir );
+nomem_closed:
+    if (lookup) free_dir_lookup( lookup );
+    return STATUS_NO_MEMORY;
+}
+
+
+/***********************************************************************
+ *           find_dir_lookup_name
+ *
+ * Find a name in a lookup table; helper for find_file_in_dir_cached.
+ */
+static const char *find_dir_lookup_name( const struct dir_lookup *lookup, const WCHAR *name, int length )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    unsigned int i, pos, hash;
+
+    if (length > MAX_DIR_ENTRY_LEN) return NULL;
+    for (i = 0; i < length; i++) buffer[i] = towupper( name[i] );
+    hash = hash_dir_lookup_name( buffer, length );
+
+    for (pos = hash & lookup->mask; lookup->table[pos]; pos = (pos + 1) & lookup->mask)
+    {
+        const struct dir_lookup_name *entry = &lookup->names[lookup->table[pos] - 1];
+
+        if (entry->hash != hash || entry->len != length) continue;
+        if (!memcmp( lookup->data + entry->name, buffer, length * sizeof(WCHAR) ))
+            return lookup->data + entry->unix_name;
+    }
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           find_file_in_dir_cached
+ *
+ * Find a file in a directory through the process-wide cache of directory
+ * contents, which is validated against the directory modification time.
+ * unix_name contains the directory name; the file found is appended at pos.
+ */
+static NTSTATUS find_file_in_dir_cached( char *unix_name, int pos, const WCHAR *name, int length )
+{
+    struct dir_lookup *lookup, *old;
+    struct stat st;
+    const char *found = NULL;
+    LONGLONG mtime;
+    NTSTATUS status;
+    BOOL recent;
+
+    if (stat( unix_name, &st ) == -1) return errno_to_status( errno );
+    mtime = get_dir_mtime( &st );
+
+    mutex_lock( &dir_lookup_mutex );
+    LIST_FOR_EACH_ENTRY( lookup, &dir_lookup_list, struct dir_lookup, entry )
+    {
+        if (lookup->id.dev != st.st_dev || lookup->id.ino != st.st_ino) continue;
+        if (lookup->mtime != mtime) break;
+        dir_lookup_hits++;
+        list_remove( &lookup->entry );
+        list_add_head( &dir_lookup_list, &lookup->entry );
+        if ((found = find_dir_lookup_name( lookup, name, length )))
+        {
+            unix_name[pos - 1] = '/';
+            strcpy( unix_name + pos, found );
+        }
+        mutex_unlock( &dir_lookup_mutex );
+        return found ? STATUS_SUCCESS : STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+    dir_lookup_misses++;
+    mutex_unlock( &dir_lookup_mutex );
+
+    recent = is_dir_mtime_recent( mtime );
+    if ((status = read_dir_lookup( unix_name, &lookup ))) return status;
+    lookup->id.dev = st.st_dev;
+    lookup->id.ino = st.st_ino;
+    lookup->mtime  = mtime;
+
+    TRACE( "%s: %u names, %u hits %u misses\n", debugstr_a(unix_name), lookup->count,
+           dir_lookup_hits, dir_lookup_misses );
+
+    if ((found = find_dir_lookup_name( lookup, name, length )))
+    {
+        unix_name[pos - 1] = '/';
+        strcpy( unix_name + pos, found );
+    }
+
+    if (recent)
+    {
+        free_dir_lookup( lookup );
+        return found ? STATUS_SUCCESS : STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
+    mutex_lock( &dir_lookup_mutex );
+    LIST_FOR_EACH_ENTRY( old, &dir_lookup_list, struct dir_lookup, entry )
+    {
+        if (old->id.dev != st.st_dev || old->id.ino != st.st_ino) continue;
+        list_remove( &old->entry );
+        free_dir_lookup( old );
+        dir_lookup_count--;
+        break;
+    }
+    if (dir_lookup_count == dir_lookup_max_count)
+    {
+        old = LIST_ENTRY( list_tail( &dir_lookup_list ), struct dir_lookup, entry );
+        list_remove( &old->entry );
+        free_dir_lookup( old );
+        dir_lookup_count--;
+    }
+    list_add_head( &dir_lookup_list, &lookup->entry );
+    dir_lookup_count++;
+    mutex_unlock( &dir_lookup_mutex );
+
+    return found ? STATUS_SUCCESS : STATUS_OBJECT_NAME_NOT_FOUND;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2551,6 +3009,16 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 
     if (!is_name_8_dot_3 && !get_dir_case_sensitivity( unix_name )) goto not_found;
 
+    /* short names need a full scan, everything else can be found in the cache */
+
+    for (ret = 0; ret < length; ret++) if (name[ret] == '~') break;
+    if (ret == length)
+    {
+        NTSTATUS status = find_file_in_dir_cached( unix_name, pos, name, length );
+        if (status) unix_name[pos - 1] = 0;
+        return status;
+    }
+
     /* now look for it through the directory */
 
 #ifdef VFAT_IOCTL_READDIR_BOTH
@@ -136,10 +136,12 @@ static void * const syscalls[] =
     NtAllocateVirtualMemoryEx,
     NtAreMappedFilesTheSame,
     NtAssignProcessToJobObject,
+    NtAssociateWaitCompletionPacket,
     NtCallbackReturn,
     NtCancelIoFile,
     NtCancelIoFileEx,
     NtCancelTimer,
+    NtCancelWaitCompletionPacket,
     NtClearEvent,
     NtClose,
     NtCompareObjects,
@@ -168,6 +170,7 @@ static void * const syscalls[] =
     NtCreateThreadEx,
     NtCreateTimer,
     NtCreateUserProcess,
+    NtCreateWaitCompletionPacket,
     NtDebugActiveProcess,
     NtDebugContinue,
     NtDelayExecution,
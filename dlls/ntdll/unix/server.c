@@ -108,18 +108,6 @@ static int initial_cwd = -1;
 static pid_t server_pid;
 static pthread_mutex_t fd_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-/* atomically exchange a 64-bit value */
-static inline LONG64 interlocked_xchg64( LONG64 *dest, LONG64 val )
-{
-#ifdef _WIN64
-    return (LONG64)InterlockedExchangePointer( (void **)dest, (void *)val );
-#else
-    LONG64 tmp = *dest;
-    while (InterlockedCompareExchange64( dest, val, tmp ) != tmp) tmp = *dest;
-    return tmp;
-#endif
-}
-
 #ifdef __GNUC__
 static void fatal_error( const char *err, ... ) __attribute__((noreturn, format(printf,1,2)));
 static void fatal_perror( const char *err, ... ) __attribute__((noreturn, format(printf,1,2)));
@@ -1651,7 +1639,10 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
+    {
         fd = remove_fd_from_cache( source );
+        inproc_sync_close_handle( source );
+    }
 
     SERVER_START_REQ( dup_handle )
     {
@@ -1712,6 +1703,7 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     fd = remove_fd_from_cache( handle );
+    inproc_sync_close_handle( handle );
 
     SERVER_START_REQ( close_handle )
     {
@@ -109,7 +109,7 @@ static inline ULONGLONG monotonic_counter(void)
 
 static int futex_private = 128;
 
-static inline int futex_wait( const int *addr, int val, struct timespec *timeout )
+static inline int futex_wait_flags( const int *addr, int flags, int val, struct timespec *timeout )
 {
 #if (defined(__i386__) || defined(__arm__)) && _TIME_BITS==64
     if (timeout && sizeof(*timeout) != 8)
@@ -119,10 +119,15 @@ static inline int futex_wait( const int *addr, int val, struct timespec *timeout
             long tv_nsec;
         } timeout32 = { timeout->tv_sec, timeout->tv_nsec };
 
-        return syscall( __NR_futex, addr, FUTEX_WAIT | futex_private, val, &timeout32, 0, 0 );
+        return syscall( __NR_futex, addr, FUTEX_WAIT | flags, val, &timeout32, 0, 0 );
     }
 #endif
-    return syscall( __NR_futex, addr, FUTEX_WAIT | futex_private, val, timeout, 0, 0 );
+    return syscall( __NR_futex, addr, FUTEX_WAIT | flags, val, timeout, 0, 0 );
+}
+
+static inline int futex_wait( const int *addr, int val, struct timespec *timeout )
+{
+    return futex_wait_flags( addr, futex_private, val, timeout );
 }
 
 static inline int futex_wake( const int *addr, int val )
@@ -150,6 +155,452 @@ static inline int use_futexes(void)
 #endif
 
 
+#if defined(__linux__) || defined(__APPLE__)
+static LONGLONG get_absolute_timeout( const LARGE_INTEGER *timeout )
+{
+    LARGE_INTEGER now;
+
+    if (timeout->QuadPart >= 0) return timeout->QuadPart;
+    NtQuerySystemTime( &now );
+    return now.QuadPart - timeout->QuadPart;
+}
+
+static LONGLONG update_timeout( ULONGLONG end )
+{
+    LARGE_INTEGER now;
+    LONGLONG timeleft;
+
+    NtQuerySystemTime( &now );
+    timeleft = end - now.QuadPart;
+    if (timeleft < 0) timeleft = 0;
+    return timeleft;
+}
+#endif
+
+
+/*
+ * In-process synchronization objects
+ *
+ * When enabled with WINEINPROCSYNC=1, unnamed events, mutexes and semaphores
+ * get a slot in shared memory that is also mapped by the server. While the
+ * object is only used through its creation handle, its state is changed with
+ * atomic operations and waits are done on futexes without any server call.
+ * Once the server needs the object state, it detaches the slot and everything
+ * goes through the server again, so callers simply fall back to the server
+ * request whenever a helper returns STATUS_NOT_IMPLEMENTED.
+ */
+
+#define INPROC_SYNC_COUNT  0x4000
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC        0x0001
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING  0x0002
+#endif
+
+union inproc_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int index;
+        unsigned int generation;
+    } s;
+};
+
+C_ASSERT( sizeof(union inproc_cache_entry) == sizeof(LONG64) );
+
+#define INPROC_CACHE_BLOCK_SIZE  (65536 / sizeof(union inproc_cache_entry))
+#define INPROC_CACHE_ENTRIES     128
+
+static union inproc_cache_entry *inproc_cache[INPROC_CACHE_ENTRIES];
+static struct inproc_sync_slot *inproc_slots;
+static LONG inproc_sync_enabled = -1;
+static pthread_mutex_t inproc_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline unsigned int inproc_handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / INPROC_CACHE_BLOCK_SIZE;
+    return idx % INPROC_CACHE_BLOCK_SIZE;
+}
+
+static inline LONG64 inproc_slot_value( struct inproc_sync_slot *slot )
+{
+    return InterlockedCompareExchange64( (LONG64 *)&slot->value, 0, 0 );
+}
+
+/* provide the shared memory to the server on first use */
+static BOOL use_inproc_sync(void)
+{
+    if (ReadAcquire( &inproc_sync_enabled ) != -1) return inproc_sync_enabled;
+
+    mutex_lock( &inproc_mutex );
+    if (inproc_sync_enabled == -1)
+    {
+        LONG enabled = 0;
+#if defined(__linux__) && defined(__NR_memfd_create) && defined(F_ADD_SEALS)
+        size_t size = INPROC_SYNC_COUNT * sizeof(*inproc_slots);
+        const char *env = getenv( "WINEINPROCSYNC" );
+        void *ptr;
+        int fd;
+
+        if (env && atoi( env ) && use_futexes() &&
+            (fd = syscall( __NR_memfd_create, "wine-inproc-sync", MFD_CLOEXEC | MFD_ALLOW_SEALING )) != -1)
+        {
+            if (!ftruncate( fd, size ) &&
+                !fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL ) &&
+                (ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) != MAP_FAILED)
+            {
+                wine_server_send_fd( fd );
+                SERVER_START_REQ( init_inproc_sync )
+                {
+                    req->fd    = fd;
+                    req->count = INPROC_SYNC_COUNT;
+                    enabled = !wine_server_call( req );
+                }
+                SERVER_END_REQ;
+                if (enabled) inproc_slots = ptr;
+                else munmap( ptr, size );
+            }
+            close( fd );
+        }
+        TRACE( "in-process synchronization %s\n", enabled ? "enabled" : "disabled" );
+#endif
+        InterlockedExchange( &inproc_sync_enabled, enabled );
+    }
+    mutex_unlock( &inproc_mutex );
+    return inproc_sync_enabled;
+}
+
+/* remember the slot of a newly created object */
+static void add_inproc_sync_to_cache( HANDLE handle, unsigned int index )
+{
+    unsigned int entry, idx = inproc_handle_to_index( handle, &entry );
+    union inproc_cache_entry cache;
+
+    if (!inproc_slots || index >= INPROC_SYNC_COUNT) return;
+    if (entry >= INPROC_CACHE_ENTRIES) return;
+
+    if (!inproc_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        mutex_lock( &inproc_mutex );
+        if (!inproc_cache[entry])
+        {
+            void *ptr = anon_mmap_alloc( INPROC_CACHE_BLOCK_SIZE * sizeof(union inproc_cache_entry),
+                                         PROT_READ | PROT_WRITE );
+            if (ptr != MAP_FAILED) inproc_cache[entry] = ptr;
+        }
+        mutex_unlock( &inproc_mutex );
+        if (!inproc_cache[entry]) return;
+    }
+
+    cache.s.index = index;
+    cache.s.generation = inproc_slots[index].generation;
+    interlocked_xchg64( &inproc_cache[entry][idx].data, cache.data );
+}
+
+/***********************************************************************
+ *           inproc_sync_close_handle
+ *
+ * Forget the slot of a handle that is being closed.
+ */
+void inproc_sync_close_handle( HANDLE handle )
+{
+    unsigned int entry, idx = inproc_handle_to_index( handle, &entry );
+
+    if (entry < INPROC_CACHE_ENTRIES && inproc_cache[entry])
+        interlocked_xchg64( &inproc_cache[entry][idx].data, 0 );
+}
+
+/* return the slot of an attached object, or NULL if the server must be used */
+static struct inproc_sync_slot *get_inproc_sync_slot( HANDLE handle, enum inproc_sync_type type )
+{
+    unsigned int entry, idx = inproc_handle_to_index( handle, &entry );
+    struct inproc_sync_slot *slot;
+    union inproc_cache_entry cache;
+
+    if (entry >= INPROC_CACHE_ENTRIES || !inproc_cache[entry]) return NULL;
+    cache.data = InterlockedCompareExchange64( &inproc_cache[entry][idx].data, 0, 0 );
+    if (!cache.s.index) return NULL;
+
+    slot = &inproc_slots[cache.s.index];
+    if (slot->generation != cache.s.generation) return NULL;
+    if (type != INPROC_SYNC_NONE && slot->type != type) return NULL;
+    return slot;
+}
+
+/* wake up the threads waiting on the slot, in this or in other processes */
+static void wake_inproc_sync_slot( struct inproc_sync_slot *slot )
+{
+    InterlockedIncrement( (LONG *)&slot->seq );
+#ifdef __linux__
+    if (ReadAcquire( (LONG *)&slot->waiters ))
+        syscall( __NR_futex, &slot->seq, FUTEX_WAKE, INT_MAX, NULL, 0, 0 );
+#endif
+}
+
+/* change the object state unless it has been detached, returns the previous state */
+static BOOL update_inproc_sync_slot( struct inproc_sync_slot *slot, LONG64 value, LONG64 *prev )
+{
+    LONG64 old;
+
+    do
+    {
+        old = inproc_slot_value( slot );
+        if (old & INPROC_SYNC_DETACHED) return FALSE;
+    } while (InterlockedCompareExchange64( (LONG64 *)&slot->value, value, old ) != old);
+    *prev = old;
+    return TRUE;
+}
+
+static inline DWORD inproc_thread_id(void)
+{
+    return HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+}
+
+static NTSTATUS inproc_set_event( HANDLE handle, BOOL state, LONG *prev_state )
+{
+    struct inproc_sync_slot *slot;
+    LONG64 prev;
+
+    if (!(slot = get_inproc_sync_slot( handle, INPROC_SYNC_EVENT ))) return STATUS_NOT_IMPLEMENTED;
+    if (!update_inproc_sync_slot( slot, state, &prev )) return STATUS_NOT_IMPLEMENTED;
+    if (state && !prev) wake_inproc_sync_slot( slot );
+    if (prev_state) *prev_state = prev;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS inproc_query_event( HANDLE handle, EVENT_BASIC_INFORMATION *info )
+{
+    struct inproc_sync_slot *slot;
+    LONG64 value;
+
+    if (!(slot = get_inproc_sync_slot( handle, INPROC_SYNC_EVENT ))) return STATUS_NOT_IMPLEMENTED;
+    value = inproc_slot_value( slot );
+    if (value & INPROC_SYNC_DETACHED) return STATUS_NOT_IMPLEMENTED;
+    info->EventType  = slot->max ? NotificationEvent : SynchronizationEvent;
+    info->EventState = value;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS inproc_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    struct inproc_sync_slot *slot;
+    LONG64 old;
+
+    if (!(slot = get_inproc_sync_slot( handle, INPROC_SYNC_SEMAPHORE ))) return STATUS_NOT_IMPLEMENTED;
+    do
+    {
+        old = inproc_slot_value( slot );
+        if (old & INPROC_SYNC_DETACHED) return STATUS_NOT_IMPLEMENTED;
+        if (old + count > slot->max) return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    } while (InterlockedCompareExchange64( (LONG64 *)&slot->value, old + count, old ) != old);
+
+    /* there cannot be any thread to wake up if the count was != 0 */
+    if (!old) wake_inproc_sync_slot( slot );
+    if (previous) *previous = old;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS inproc_query_semaphore( HANDLE handle, SEMAPHORE_BASIC_INFORMATION *info )
+{
+    struct inproc_sync_slot *slot;
+    LONG64 value;
+
+    if (!(slot = get_inproc_sync_slot( handle, INPROC_SYNC_SEMAPHORE ))) return STATUS_NOT_IMPLEMENTED;
+    value = inproc_slot_value( slot );
+    if (value & INPROC_SYNC_DETACHED) return STATUS_NOT_IMPLEMENTED;
+    info->CurrentCount = value;
+    info->MaximumCount = slot->max;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS inproc_release_mutant( HANDLE handle, LONG *prev_count )
+{
+    struct inproc_sync_slot *slot;
+    unsigned int count;
+    LONG64 old, value;
+
+    if (!(slot = get_inproc_sync_slot( handle, INPROC_SYNC_MUTEX ))) return STATUS_NOT_IMPLEMENTED;
+    do
+    {
+        old = inproc_slot_value( slot );
+        if (old & INPROC_SYNC_DETACHED) return STATUS_NOT_IMPLEMENTED;
+        count = old >> 32;
+        if (!count || (DWORD)old != inproc_thread_id()) return STATUS_MUTANT_NOT_OWNED;
+        value = (count == 1) ? 0 : old - ((LONG64)1 << 32);
+    } while (InterlockedCompareExchange64( (LONG64 *)&slot->value, value, old ) != old);
+
+    if (!value) wake_inproc_sync_slot( slot );
+    if (prev_count) *prev_count = 1 - count;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS inproc_query_mutant( HANDLE handle, MUTANT_BASIC_INFORMATION *info )
+{
+    struct inproc_sync_slot *slot;
+    unsigned int count;
+    LONG64 value;
+
+    if (!(slot = get_inproc_sync_slot( handle, INPROC_SYNC_MUTEX ))) return STATUS_NOT_IMPLEMENTED;
+    value = inproc_slot_value( slot );
+    if (value & INPROC_SYNC_DETACHED) return STATUS_NOT_IMPLEMENTED;
+    count = value >> 32;
+    info->CurrentCount   = 1 - count;
+    info->OwnedByCaller  = count && (DWORD)value == inproc_thread_id();
+    info->AbandonedState = FALSE;
+    return STATUS_SUCCESS;
+}
+
+/* try to satisfy a wait on the slot, returns -1 if the server must be used */
+static int try_acquire_inproc_sync_slot( struct inproc_sync_slot *slot, DWORD tid )
+{
+    unsigned int count;
+    LONG64 old, value;
+
+    do
+    {
+        old = inproc_slot_value( slot );
+        if (old & INPROC_SYNC_DETACHED) return -1;
+
+        switch (slot->type)
+        {
+        case INPROC_SYNC_EVENT:
+            if (!old) return 0;
+            if (slot->max) return 1;  /* manual reset */
+            value = 0;
+            break;
+        case INPROC_SYNC_SEMAPHORE:
+            if (!old) return 0;
+            value = old - 1;
+            break;
+        case INPROC_SYNC_MUTEX:
+            count = old >> 32;
+            if (!count) value = tid | ((LONG64)1 << 32);
+            else if ((DWORD)old != tid) return 0;
+            else if (count == 0x7fffffff) return -1;
+            else value = old + ((LONG64)1 << 32);
+            break;
+        default:
+            return -1;
+        }
+    } while (InterlockedCompareExchange64( (LONG64 *)&slot->value, value, old ) != old);
+    return 1;
+}
+
+#ifdef __linux__
+
+#ifndef __NR_futex_waitv
+#define __NR_futex_waitv 449
+#endif
+
+struct inproc_futex_waitv
+{
+    ULONGLONG val;
+    ULONGLONG uaddr;
+    unsigned int flags;
+    unsigned int reserved;
+};
+
+/* wait for one of the slot sequence numbers to change */
+static int wait_inproc_sync_slots( struct inproc_sync_slot **slots, const int *seq, DWORD count,
+                                   const LONGLONG *timeleft )
+{
+    struct inproc_futex_waitv futexes[MAXIMUM_WAIT_OBJECTS];
+    struct { LONGLONG tv_sec; LONGLONG tv_nsec; } end;
+    struct timespec ts;
+    DWORD i;
+
+    if (count == 1)
+    {
+        if (!timeleft) return futex_wait_flags( &slots[0]->seq, 0, seq[0], NULL );
+        ts.tv_sec = *timeleft / (ULONGLONG)TICKSPERSEC;
+        ts.tv_nsec = (*timeleft % TICKSPERSEC) * 100;
+        return futex_wait_flags( &slots[0]->seq, 0, seq[0], &ts );
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        futexes[i].val = seq[i];
+        futexes[i].uaddr = (ULONG_PTR)&slots[i]->seq;
+        futexes[i].flags = 2;  /* FUTEX2_SIZE_U32 */
+        futexes[i].reserved = 0;
+    }
+    if (!timeleft) return syscall( __NR_futex_waitv, futexes, count, 0, NULL, 0 );
+
+    /* futex_waitv takes an absolute timeout */
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    end.tv_sec = ts.tv_sec + *timeleft / (ULONGLONG)TICKSPERSEC;
+    end.tv_nsec = ts.tv_nsec + (*timeleft % TICKSPERSEC) * 100;
+    if (end.tv_nsec >= 1000000000)
+    {
+        end.tv_sec++;
+        end.tv_nsec -= 1000000000;
+    }
+    return syscall( __NR_futex_waitv, futexes, count, 0, &end, CLOCK_MONOTONIC );
+}
+
+/* wait on objects that are all attached, falling back to the server when that's not possible */
+static NTSTATUS inproc_wait( DWORD count, const HANDLE *handles, BOOLEAN wait_any, BOOLEAN alertable,
+                             const LARGE_INTEGER **timeout, LARGE_INTEGER *abs_timeout )
+{
+    struct inproc_sync_slot *slots[MAXIMUM_WAIT_OBJECTS];
+    int seq[MAXIMUM_WAIT_OBJECTS];
+    DWORD i, tid = inproc_thread_id();
+    LONGLONG end = 0, timeleft;
+    int ret;
+
+    if (alertable) return STATUS_NOT_IMPLEMENTED;
+    if (count > 1 && !wait_any) return STATUS_NOT_IMPLEMENTED;
+    for (i = 0; i < count; i++)
+        if (!(slots[i] = get_inproc_sync_slot( handles[i], INPROC_SYNC_NONE ))) return STATUS_NOT_IMPLEMENTED;
+
+    if (*timeout)
+    {
+        if ((*timeout)->QuadPart == TIMEOUT_INFINITE) *timeout = NULL;
+        else
+        {
+            /* make sure that falling back to the server doesn't restart the timeout */
+            end = abs_timeout->QuadPart = get_absolute_timeout( *timeout );
+            *timeout = abs_timeout;
+        }
+    }
+
+    for (;;)
+    {
+        for (i = 0; i < count; i++) seq[i] = ReadAcquire( (LONG *)&slots[i]->seq );
+        for (i = 0; i < count; i++)
+        {
+            switch (try_acquire_inproc_sync_slot( slots[i], tid ))
+            {
+            case 1: return STATUS_WAIT_0 + i;
+            case -1: return STATUS_NOT_IMPLEMENTED;
+            }
+        }
+        if (*timeout && !(timeleft = update_timeout( end ))) return STATUS_TIMEOUT;
+
+        for (i = 0; i < count; i++) InterlockedIncrement( (LONG *)&slots[i]->waiters );
+        ret = wait_inproc_sync_slots( slots, seq, count, *timeout ? &timeleft : NULL );
+        for (i = 0; i < count; i++) InterlockedDecrement( (LONG *)&slots[i]->waiters );
+
+        /* the server is responsible for the wait if futex_waitv is not supported */
+        if (ret == -1 && errno == ENOSYS) return STATUS_NOT_IMPLEMENTED;
+    }
+}
+
+#else  /* __linux__ */
+
+static NTSTATUS inproc_wait( DWORD count, const HANDLE *handles, BOOLEAN wait_any, BOOLEAN alertable,
+                             const LARGE_INTEGER **timeout, LARGE_INTEGER *abs_timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
+
 /* create a struct security_descriptor and contained information in one contiguous piece of memory */
 NTSTATUS alloc_object_attributes( const OBJECT_ATTRIBUTES *attr, struct object_attributes **ret,
                                   data_size_t *ret_len )
@@ -278,9 +729,11 @@ NTSTATUS WINAPI NtCreateSemaphore( HANDLE *handle, ACCESS_MASK access, const OBJ
         req->access  = access;
         req->initial = initial;
         req->max     = max;
+        req->inproc  = use_inproc_sync();
         wine_server_add_data( req, objattr, len );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret && reply->inproc_index) add_inproc_sync_to_cache( *handle, reply->inproc_index );
     }
     SERVER_END_REQ;
 
@@ -333,6 +786,12 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 
     if (len != sizeof(SEMAPHORE_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((ret = inproc_query_semaphore( handle, out )) != STATUS_NOT_IMPLEMENTED)
+    {
+        if (!ret && ret_len) *ret_len = sizeof(SEMAPHORE_BASIC_INFORMATION);
+        return ret;
+    }
+
     SERVER_START_REQ( query_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -355,6 +814,9 @@ NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, ULONG *previous
 {
     NTSTATUS ret;
 
+    if ((ret = inproc_release_semaphore( handle, count, previous )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -388,9 +850,11 @@ NTSTATUS WINAPI NtCreateEvent( HANDLE *handle, ACCESS_MASK access, const OBJECT_
         req->access = access;
         req->manual_reset = (type == NotificationEvent);
         req->initial_state = state;
+        req->inproc = use_inproc_sync();
         wine_server_add_data( req, objattr, len );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret && reply->inproc_index) add_inproc_sync_to_cache( *handle, reply->inproc_index );
     }
     SERVER_END_REQ;
 
@@ -431,6 +895,8 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, LONG *prev_state )
 {
     NTSTATUS ret;
 
+    if ((ret = inproc_set_event( handle, TRUE, prev_state )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -450,6 +916,8 @@ NTSTATUS WINAPI NtResetEvent( HANDLE handle, LONG *prev_state )
 {
     NTSTATUS ret;
 
+    if ((ret = inproc_set_event( handle, FALSE, prev_state )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -511,6 +979,12 @@ NTSTATUS WINAPI NtQueryEvent( HANDLE handle, EVENT_INFORMATION_CLASS class,
 
     if (len != sizeof(EVENT_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((ret = inproc_query_event( handle, out )) != STATUS_NOT_IMPLEMENTED)
+    {
+        if (!ret && ret_len) *ret_len = sizeof(EVENT_BASIC_INFORMATION);
+        return ret;
+    }
+
     SERVER_START_REQ( query_event )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -543,9 +1017,11 @@ NTSTATUS WINAPI NtCreateMutant( HANDLE *handle, ACCESS_MASK access, const OBJECT
     {
         req->access  = access;
         req->owned   = owned;
+        req->inproc  = use_inproc_sync();
         wine_server_add_data( req, objattr, len );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret && reply->inproc_index) add_inproc_sync_to_cache( *handle, reply->inproc_index );
     }
     SERVER_END_REQ;
 
@@ -586,6 +1062,8 @@ NTSTATUS WINAPI NtReleaseMutant( HANDLE handle, LONG *prev_count )
 {
     NTSTATUS ret;
 
+    if ((ret = inproc_release_mutant( handle, prev_count )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( release_mutex )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -616,6 +1094,12 @@ NTSTATUS WINAPI NtQueryMutant( HANDLE handle, MUTANT_INFORMATION_CLASS class,
 
     if (len != sizeof(MUTANT_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((ret = inproc_query_mutant( handle, out )) != STATUS_NOT_IMPLEMENTED)
+    {
+        if (!ret && ret_len) *ret_len = sizeof(MUTANT_BASIC_INFORMATION);
+        return ret;
+    }
+
     SERVER_START_REQ( query_mutex )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -1419,9 +1903,14 @@ NTSTATUS WINAPI NtWaitForMultipleObjects( DWORD count, const HANDLE *handles, BO
 {
     select_op_t select_op;
     UINT i, flags = SELECT_INTERRUPTIBLE;
+    LARGE_INTEGER abs_timeout;
+    NTSTATUS ret;
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    if ((ret = inproc_wait( count, handles, wait_any, alertable, &timeout, &abs_timeout )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
@@ -1860,8 +2349,9 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE handle, ULONG_PTR *key, ULONG_PTR *
 NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
                                         ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
 {
+    struct completion_packet packets[64];
     NTSTATUS status;
-    ULONG i = 0;
+    ULONG i = 0, j, batch, ret_count = 0;
 
     TRACE( "%p %p %u %p %p %u\n", handle, info, count, written, timeout, alertable );
 
@@ -1869,20 +2359,32 @@ NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORM
     {
         while (i < count)
         {
+            /* the packets following the first one are returned in a single batch */
+            batch = min( count - i - 1, ARRAY_SIZE(packets) );
             SERVER_START_REQ( remove_completion )
             {
                 req->handle = wine_server_obj_handle( handle );
+                wine_server_set_reply( req, packets, batch * sizeof(*packets) );
                 if (!(status = wine_server_call( req )))
                 {
                     info[i].CompletionKey             = reply->ckey;
                     info[i].CompletionValue           = reply->cvalue;
                     info[i].IoStatusBlock.Information = reply->information;
                     info[i].IoStatusBlock.u.Status    = reply->status;
+                    ret_count = wine_server_reply_size( reply ) / sizeof(*packets);
                 }
             }
             SERVER_END_REQ;
             if (status != STATUS_SUCCESS) break;
             ++i;
+            for (j = 0; j < ret_count; j++, i++)
+            {
+                info[i].CompletionKey             = packets[j].ckey;
+                info[i].CompletionValue           = packets[j].cvalue;
+                info[i].IoStatusBlock.Information = packets[j].information;
+                info[i].IoStatusBlock.u.Status    = packets[j].status;
+            }
+            if (ret_count < batch) break;  /* the queue is empty */
         }
         if (i || status != STATUS_PENDING)
         {
@@ -1934,6 +2436,82 @@ NTSTATUS WINAPI NtQueryIoCompletion( HANDLE handle, IO_COMPLETION_INFORMATION_CL
 }
 
 
+/***********************************************************************
+ *             NtCreateWaitCompletionPacket (NTDLL.@)
+ */
+NTSTATUS WINAPI NtCreateWaitCompletionPacket( HANDLE *handle, ACCESS_MASK access, OBJECT_ATTRIBUTES *attr )
+{
+    NTSTATUS status;
+    data_size_t len;
+    struct object_attributes *objattr;
+
+    TRACE( "(%p, %x, %p)\n", handle, access, attr );
+
+    *handle = 0;
+    if ((status = alloc_object_attributes( attr, &objattr, &len ))) return status;
+
+    SERVER_START_REQ( create_wait_completion_packet )
+    {
+        req->access = access;
+        wine_server_add_data( req, objattr, len );
+        if (!(status = wine_server_call( req ))) *handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+
+    free( objattr );
+    return status;
+}
+
+
+/***********************************************************************
+ *             NtAssociateWaitCompletionPacket (NTDLL.@)
+ */
+NTSTATUS WINAPI NtAssociateWaitCompletionPacket( HANDLE packet, HANDLE completion, HANDLE target,
+                                                 void *key_context, void *apc_context, NTSTATUS io_status,
+                                                 ULONG_PTR io_status_information, BOOLEAN *already_signaled )
+{
+    NTSTATUS status;
+
+    TRACE( "(%p, %p, %p, %p, %p, %x, %lx, %p)\n", packet, completion, target, key_context,
+           apc_context, io_status, io_status_information, already_signaled );
+
+    SERVER_START_REQ( associate_wait_completion_packet )
+    {
+        req->packet      = wine_server_obj_handle( packet );
+        req->completion  = wine_server_obj_handle( completion );
+        req->handle      = wine_server_obj_handle( target );
+        req->ckey        = wine_server_client_ptr( key_context );
+        req->cvalue      = wine_server_client_ptr( apc_context );
+        req->status      = io_status;
+        req->information = io_status_information;
+        status = wine_server_call( req );
+        if (!status && already_signaled) *already_signaled = reply->signaled;
+    }
+    SERVER_END_REQ;
+    return status;
+}
+
+
+/***********************************************************************
+ *             NtCancelWaitCompletionPacket (NTDLL.@)
+ */
+NTSTATUS WINAPI NtCancelWaitCompletionPacket( HANDLE packet, BOOLEAN remove_signaled )
+{
+    NTSTATUS status;
+
+    TRACE( "(%p, %d)\n", packet, remove_signaled );
+
+    SERVER_START_REQ( cancel_wait_completion_packet )
+    {
+        req->packet          = wine_server_obj_handle( packet );
+        req->remove_signaled = remove_signaled;
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    return status;
+}
+
+
 /***********************************************************************
  *             NtCreateSection (NTDLL.@)
  */
@@ -2402,29 +2980,6 @@ NTSTATUS WINAPI NtAlertThreadByThreadId( HANDLE tid )
 }
 
 
-#if defined(__linux__) || defined(__APPLE__)
-static LONGLONG get_absolute_timeout( const LARGE_INTEGER *timeout )
-{
-    LARGE_INTEGER now;
-
-    if (timeout->QuadPart >= 0) return timeout->QuadPart;
-    NtQuerySystemTime( &now );
-    return now.QuadPart - timeout->QuadPart;
-}
-
-static LONGLONG update_timeout( ULONGLONG end )
-{
-    LARGE_INTEGER now;
-    LONGLONG timeleft;
-
-    NtQuerySystemTime( &now );
-    timeleft = end - now.QuadPart;
-    if (timeleft < 0) timeleft = 0;
-    return timeleft;
-}
-#endif
-
-
 #ifdef __APPLE__
 
 /***********************************************************************
@@ -109,6 +109,15 @@ struct file_view
     void         *base;          /* base address */
     size_t        size;          /* size in bytes */
     unsigned int  protect;       /* protection for all pages at allocation time and SEC_* flags */
+    struct vprot_region *regions; /* cached ranges of pages with identical protections */
+    unsigned int  region_count;  /* number of cached regions, 0 if they need to be recomputed */
+    unsigned int  region_alloc;  /* allocated size of the regions array */
+};
+
+struct vprot_region
+{
+    size_t        end;           /* offset of the end of the region in the view */
+    BYTE          vprot;         /* protection of the pages of the region */
 };
 
 /* per-page protection flags */
@@ -121,6 +130,7 @@ struct file_view
 #define VPROT_WRITEWATCH 0x40
 /* per-mapping protection flags */
 #define VPROT_SYSTEM     0x0200  /* system view (underlying mmap not under our control) */
+#define VPROT_SOFT_DIRTY_SAVED 0x0400  /* write watch view saved during a soft-dirty reset */
 
 /* Conversion from VPROT_* to Win32 flags */
 static const BYTE VIRTUAL_Win32Flags[16] =
@@ -149,6 +159,7 @@ static pthread_mutex_t virtual_mutex;
 static const UINT page_shift = 12;
 static const UINT_PTR page_mask = 0xfff;
 static const UINT_PTR granularity_mask = 0xffff;
+static const UINT_PTR large_page_mask = 0x1fffff;  /* must match GetLargePageMinimum() */
 
 /* Note: these are Windows limits, you cannot change them. */
 #ifdef __i386__
@@ -205,6 +216,14 @@ static void *preload_reserve_start;
 static void *preload_reserve_end;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
 
+/* write watches based on soft-dirty page table bits, instead of write faults */
+static BOOL use_soft_dirty;
+#ifdef __linux__
+static int pagemap_fd = -1;
+static int clear_refs_fd = -1;
+#define PAGEMAP_SOFT_DIRTY ((UINT64)1 << 55)
+#endif
+
 struct range_entry
 {
     void *base;
@@ -932,6 +951,7 @@ static SIZE_T get_vprot_range_size( char *base, SIZE_T size, BYTE mask, BYTE *vp
  *           set_page_vprot
  *
  * Set a range of page protection bytes.
+ * The caller must reset the cached regions of the view, unless only the write watch bit changes.
  */
 static void set_page_vprot( const void *addr, size_t size, BYTE vprot )
 {
@@ -956,6 +976,7 @@ static void set_page_vprot( const void *addr, size_t size, BYTE vprot )
  *           set_page_vprot_bits
  *
  * Set or clear bits in a range of page protection bytes.
+ * The caller must reset the cached regions of the view, unless only the write watch bit changes.
  */
 static void set_page_vprot_bits( const void *addr, size_t size, BYTE set, BYTE clear )
 {
@@ -1045,7 +1066,7 @@ static int get_unix_prot( BYTE vprot )
         if (vprot & VPROT_WRITE) prot |= PROT_WRITE | PROT_READ;
         if (vprot & VPROT_WRITECOPY) prot |= PROT_WRITE | PROT_READ;
         if (vprot & VPROT_EXEC) prot |= PROT_EXEC | PROT_READ;
-        if (vprot & VPROT_WRITEWATCH) prot &= ~PROT_WRITE;
+        if ((vprot & VPROT_WRITEWATCH) && !use_soft_dirty) prot &= ~PROT_WRITE;
     }
     if (!prot) prot = PROT_NONE;
     return prot;
@@ -1531,6 +1552,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
     if (mmap_is_in_reserved_area( view->base, view->size ))
         free_ranges_remove_view( view );
     wine_rb_remove( &views_tree, &view->entry );
+    free( view->regions );
     *(struct file_view **)view = next_free_view;
     next_free_view = view;
 }
@@ -1574,6 +1596,9 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->base    = base;
     view->size    = size;
     view->protect = vprot;
+    view->regions = NULL;
+    view->region_count = 0;
+    view->region_alloc = 0;
     set_page_vprot( base, size, vprot );
 
     wine_rb_put( &views_tree, view->base, &view->entry );
@@ -1710,15 +1735,29 @@ static BOOL set_vprot( struct file_view *view, void *base, size_t size, BYTE vpr
     {
         /* each page may need different protections depending on write watch flag */
         set_page_vprot_bits( base, size, vprot & ~VPROT_WRITEWATCH, ~vprot & ~VPROT_WRITEWATCH );
+        view->region_count = 0;
         mprotect_range( base, size, 0, 0 );
         return TRUE;
     }
     if (mprotect_exec( base, size, unix_prot )) return FALSE;
     set_page_vprot( base, size, vprot );
+    view->region_count = 0;
     return TRUE;
 }
 
 
+/***********************************************************************
+ *           is_large_page_range
+ *
+ * Check that a range can be changed without splitting the huge pages of a view.
+ */
+static BOOL is_large_page_range( const struct file_view *view, const void *base, size_t size )
+{
+    if (!(view->protect & SEC_LARGE_PAGES)) return TRUE;
+    return !(((UINT_PTR)base | size) & large_page_mask);
+}
+
+
 /***********************************************************************
  *           set_protection
  *
@@ -1730,6 +1769,8 @@ static NTSTATUS set_protection( struct file_view *view, void *base, SIZE_T size,
     NTSTATUS status;
 
     if ((status = get_vprot_flags( protect, &vprot, view->protect & SEC_IMAGE ))) return status;
+    /* huge pages can only be protected as a whole */
+    if (!is_large_page_range( view, base, size )) return STATUS_INVALID_PARAMETER;
     if (is_view_valloc( view ))
     {
         if (vprot & VPROT_WRITECOPY) return STATUS_INVALID_PAGE_PROTECTION;
@@ -1745,6 +1786,173 @@ static NTSTATUS set_protection( struct file_view *view, void *base, SIZE_T size,
 }
 
 
+/***********************************************************************
+ *           init_write_watches
+ *
+ * Check whether the write watches can use soft-dirty bits. Must be done before creating the first
+ * write watch view, since it changes the way their pages are protected.
+ */
+static void init_write_watches(void)
+{
+#ifdef __linux__
+    static BOOL init_done;
+    UINT64 entry;
+    char *page;
+
+    if (init_done) return;
+    init_done = TRUE;
+
+    if ((pagemap_fd = open( "/proc/self/pagemap", O_RDONLY | O_CLOEXEC )) == -1) return;
+    if ((clear_refs_fd = open( "/proc/self/clear_refs", O_WRONLY | O_CLOEXEC )) == -1) goto failed;
+
+    /* make sure that the soft-dirty bit is cleared and set again by a write */
+    page = mmap( NULL, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0 );
+    if (page == MAP_FAILED) goto failed;
+    *(volatile char *)page = 1;
+    if (write( clear_refs_fd, "4", 1 ) == 1 &&
+        pread( pagemap_fd, &entry, sizeof(entry), ((UINT_PTR)page >> page_shift) * sizeof(entry) ) == sizeof(entry) &&
+        !(entry & PAGEMAP_SOFT_DIRTY))
+    {
+        *(volatile char *)page = 2;
+        if (pread( pagemap_fd, &entry, sizeof(entry), ((UINT_PTR)page >> page_shift) * sizeof(entry) ) == sizeof(entry))
+            use_soft_dirty = !!(entry & PAGEMAP_SOFT_DIRTY);
+    }
+    munmap( page, page_size );
+    if (use_soft_dirty)
+    {
+        TRACE( "using soft-dirty bits for write watches\n" );
+        return;
+    }
+
+failed:
+    if (clear_refs_fd != -1) close( clear_refs_fd );
+    close( pagemap_fd );
+    pagemap_fd = clear_refs_fd = -1;
+#endif
+}
+
+
+/***********************************************************************
+ *           read_soft_dirty
+ *
+ * Clear the write watch flag on pages that have been written to since the last soft-dirty reset.
+ */
+static void read_soft_dirty( char *base, size_t size )
+{
+#ifdef __linux__
+    UINT64 entries[512];
+    size_t i, count;
+
+    while (size)
+    {
+        count = min( size >> page_shift, ARRAY_SIZE(entries) );
+        if (pread( pagemap_fd, entries, count * sizeof(entries[0]),
+                   ((UINT_PTR)base >> page_shift) * sizeof(entries[0]) ) != count * sizeof(entries[0]))
+        {
+            ERR( "failed to read page map for %p-%p\n", base, base + size );
+            /* report the pages as written */
+            set_page_vprot_bits( base, size, 0, VPROT_WRITEWATCH );
+            return;
+        }
+        for (i = 0; i < count; i++)
+            if (entries[i] & PAGEMAP_SOFT_DIRTY)
+                set_page_vprot_bits( base + (i << page_shift), page_size, 0, VPROT_WRITEWATCH );
+        base += count << page_shift;
+        size -= count << page_shift;
+    }
+#endif
+}
+
+
+/***********************************************************************
+ *           update_soft_dirty
+ *
+ * Update the write watches of a range from the soft-dirty bits. Only the pages whose write watch
+ * is still armed need to be checked.
+ *
+ * The kernel marks new mappings as entirely soft-dirty (VM_SOFTDIRTY), so pages that have been
+ * decommitted or remapped since the last soft-dirty reset are reported as written.
+ */
+static void update_soft_dirty( char *base, size_t size )
+{
+    SIZE_T range_size;
+    BYTE vprot;
+
+    while (size)
+    {
+        range_size = get_vprot_range_size( base, size, VPROT_WRITEWATCH, &vprot );
+        if (vprot & VPROT_WRITEWATCH) read_soft_dirty( base, range_size );
+        base += range_size;
+        size -= range_size;
+    }
+}
+
+
+/***********************************************************************
+ *           has_write_watches
+ *
+ * Check whether some pages of a range haven't been written to since their write watch was reset.
+ */
+static BOOL has_write_watches( char *base, size_t size )
+{
+    SIZE_T range_size;
+    BYTE vprot;
+
+    while (size)
+    {
+        range_size = get_vprot_range_size( base, size, VPROT_WRITEWATCH, &vprot );
+        if (vprot & VPROT_WRITEWATCH) return TRUE;
+        base += range_size;
+        size -= range_size;
+    }
+    return FALSE;
+}
+
+
+/***********************************************************************
+ *           reset_soft_dirty
+ *
+ * Reset write watches in a memory range using soft-dirty bits. Since the soft-dirty bits can only
+ * be cleared for the whole process, the state of the other write watch views is saved first.
+ * Views whose pages have all been written to already, and the reset range itself, have nothing
+ * to save and are skipped.
+ */
+static void reset_soft_dirty( void *base, SIZE_T size )
+{
+#ifdef __linux__
+    char *start, *end, *hole_start, *hole_end;
+    struct file_view *view;
+
+    /* writes to the watched pages would be lost between the update and the reset,
+     * make them fault until the reset is done */
+    WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
+    {
+        if (!(view->protect & VPROT_WRITEWATCH)) continue;
+        start = view->base;
+        end = start + view->size;
+        hole_start = min( max( (char *)base, start ), end );
+        hole_end = min( max( (char *)base + size, start ), end );
+        if (!has_write_watches( start, hole_start - start ) && !has_write_watches( hole_end, end - hole_end ))
+            continue;
+        view->protect |= VPROT_SOFT_DIRTY_SAVED;
+        mprotect_range( view->base, view->size, 0, VPROT_WRITE | VPROT_WRITECOPY );
+        update_soft_dirty( start, hole_start - start );
+        update_soft_dirty( hole_end, end - hole_end );
+    }
+
+    if (write( clear_refs_fd, "4", 1 ) != 1) ERR( "failed to clear soft-dirty bits\n" );
+    set_page_vprot_bits( base, size, VPROT_WRITEWATCH, 0 );
+
+    WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
+    {
+        if (!(view->protect & VPROT_SOFT_DIRTY_SAVED)) continue;
+        view->protect &= ~VPROT_SOFT_DIRTY_SAVED;
+        mprotect_range( view->base, view->size, 0, 0 );
+    }
+#endif
+}
+
+
 /***********************************************************************
  *           update_write_watches
  */
@@ -1765,6 +1973,11 @@ static void update_write_watches( void *base, size_t size, size_t accessed_size
  */
 static void reset_write_watches( void *base, SIZE_T size )
 {
+    if (use_soft_dirty)
+    {
+        reset_soft_dirty( base, size );
+        return;
+    }
     set_page_vprot_bits( base, size, VPROT_WRITEWATCH, 0 );
     mprotect_range( base, size, 0, 0 );
 }
@@ -1773,13 +1986,13 @@ static void reset_write_watches( void *base, SIZE_T size )
 /***********************************************************************
  *           unmap_extra_space
  *
- * Release the extra memory while keeping the range starting on the granularity boundary.
+ * Release the extra memory while keeping the range starting on the alignment boundary.
  */
-static inline void *unmap_extra_space( void *ptr, size_t total_size, size_t wanted_size )
+static inline void *unmap_extra_space( void *ptr, size_t total_size, size_t wanted_size, size_t align_mask )
 {
-    if ((ULONG_PTR)ptr & granularity_mask)
+    if ((ULONG_PTR)ptr & align_mask)
     {
-        size_t extra = granularity_mask + 1 - ((ULONG_PTR)ptr & granularity_mask);
+        size_t extra = align_mask + 1 - ((ULONG_PTR)ptr & align_mask);
         munmap( ptr, extra );
         ptr = (char *)ptr + extra;
         total_size -= extra;
@@ -1895,7 +2108,7 @@ static NTSTATUS map_fixed_area( void *base, size_t size, unsigned int vprot )
  * virtual_mutex must be held by caller.
  */
 static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
-                          int top_down, unsigned int vprot, ULONG_PTR zero_bits )
+                          int top_down, unsigned int vprot, ULONG_PTR zero_bits, size_t align_mask )
 {
     void *ptr;
     NTSTATUS status;
@@ -1910,16 +2123,16 @@ static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
     }
     else
     {
-        size_t view_size = size + granularity_mask + 1;
+        size_t view_size = size + align_mask + 1;
         struct alloc_area alloc;
 
-        alloc.size = size;
+        alloc.size = size + align_mask - granularity_mask;
         alloc.top_down = top_down;
         alloc.limit = (void*)(get_zero_bits_mask( zero_bits ) & (UINT_PTR)user_space_limit);
 
         if (mmap_enum_reserved_areas( alloc_reserved_area_callback, &alloc, top_down ))
         {
-            ptr = alloc.result;
+            ptr = (void *)(((UINT_PTR)alloc.result + align_mask) & ~align_mask);
             TRACE( "got mem in reserved area %p-%p\n", ptr, (char *)ptr + size );
             if (anon_mmap_fixed( ptr, size, get_unix_prot(vprot), 0 ) != ptr)
                 return STATUS_INVALID_PARAMETER;
@@ -1947,7 +2160,7 @@ static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
             if (is_beyond_limit( ptr, view_size, user_space_limit )) add_reserved_area( ptr, view_size );
             else break;
         }
-        ptr = unmap_extra_space( ptr, view_size, size );
+        ptr = unmap_extra_space( ptr, view_size, size, align_mask );
     }
 done:
     status = create_view( view_ret, ptr, size, vprot );
@@ -1956,6 +2169,41 @@ done:
 }
 
 
+/***********************************************************************
+ *           map_large_pages
+ *
+ * Try to back a MEM_LARGE_PAGES view with huge pages.
+ * virtual_mutex must be held by caller.
+ */
+static NTSTATUS map_large_pages( struct file_view *view )
+{
+    int prot = get_unix_prot( view->protect );
+
+    if (((UINT_PTR)view->base | view->size) & large_page_mask) return STATUS_SUCCESS;
+
+#ifdef MAP_HUGETLB
+    if (mmap( view->base, view->size, prot, MAP_PRIVATE | MAP_ANON | MAP_FIXED | MAP_HUGETLB, -1, 0 ) != MAP_FAILED)
+    {
+        TRACE( "%p-%p mapped with huge pages\n", view->base, (char *)view->base + view->size );
+        view->protect |= SEC_LARGE_PAGES;
+        return STATUS_SUCCESS;
+    }
+    /* the previous mapping may have been removed, it didn't contain anything yet */
+    if (anon_mmap_fixed( view->base, view->size, prot, 0 ) == MAP_FAILED)
+    {
+        ERR( "failed to restore %p-%p after huge page mapping failure\n", view->base, (char *)view->base + view->size );
+        return STATUS_NO_MEMORY;
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    /* fall back to transparent huge pages if they are enabled */
+    madvise( view->base, view->size, MADV_HUGEPAGE );
+#endif
+    return STATUS_SUCCESS;
+}
+
+
+
 /***********************************************************************
  *           map_file_into_view
  *
@@ -2020,6 +2268,7 @@ static NTSTATUS map_file_into_view( struct file_view *view, int fd, size_t start
     if (prot != (PROT_READ|PROT_WRITE)) mprotect( ptr, size, prot );  /* Set the right protection */
 done:
     set_page_vprot( (char *)view->base + start, size, vprot );
+    view->region_count = 0;
     return STATUS_SUCCESS;
 }
 
@@ -2054,6 +2303,7 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
                 {
                     *vprot |= VPROT_COMMITTED;
                     set_page_vprot_bits( base, size, VPROT_COMMITTED, 0 );
+                    view->region_count = 0;
                 }
             }
         }
@@ -2067,6 +2317,75 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
 }
 
 
+/***********************************************************************
+ *           update_view_regions
+ *
+ * Recompute the cached ranges of pages with identical protections if they are out of date.
+ * virtual_mutex must be held by caller.
+ */
+static BOOL update_view_regions( struct file_view *view )
+{
+    struct vprot_region *regions;
+    size_t offset = 0, size;
+    unsigned int count = 0;
+    BYTE vprot;
+
+    if (view->region_count) return TRUE;
+
+    while (offset < view->size)
+    {
+        size = get_vprot_range_size( (char *)view->base + offset, view->size - offset,
+                                     ~VPROT_WRITEWATCH, &vprot );
+        if (count == view->region_alloc)
+        {
+            unsigned int new_alloc = max( 16, view->region_alloc * 2 );
+
+            if (!(regions = realloc( view->regions, new_alloc * sizeof(*regions) )))
+            {
+                view->region_count = 0;
+                return FALSE;
+            }
+            view->regions = regions;
+            view->region_alloc = new_alloc;
+        }
+        offset += size;
+        view->regions[count].end = offset;
+        view->regions[count].vprot = vprot;
+        count++;
+    }
+    view->region_count = count;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           get_region_size
+ *
+ * Get the size of the range of pages with the same protections starting at base,
+ * ignoring the write watch bit. Also return the protections for the first page.
+ * virtual_mutex must be held by caller.
+ */
+static SIZE_T get_region_size( struct file_view *view, void *base, BYTE *vprot )
+{
+    size_t offset = (char *)ROUND_ADDR( base, page_mask ) - (char *)view->base;
+    unsigned int pos, min = 0, max;
+
+    /* the committed state of SEC_RESERVE mappings has to be queried from the server */
+    if ((view->protect & SEC_RESERVE) || !update_view_regions( view ))
+        return get_committed_size( view, base, vprot, ~VPROT_WRITEWATCH );
+
+    max = view->region_count - 1;
+    while (min < max)
+    {
+        pos = (min + max) / 2;
+        if (view->regions[pos].end <= offset) min = pos + 1;
+        else max = pos;
+    }
+    *vprot = view->regions[min].vprot;
+    return view->regions[min].end - offset;
+}
+
+
 /***********************************************************************
  *           decommit_pages
  *
@@ -2076,9 +2395,12 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
 static NTSTATUS decommit_pages( struct file_view *view, size_t start, size_t size )
 {
     if (!size) size = view->size;
+    /* huge pages can only be decommitted as a whole */
+    if (!is_large_page_range( view, (char *)view->base + start, size )) return STATUS_INVALID_PARAMETER;
     if (anon_mmap_fixed( (char *)view->base + start, size, PROT_NONE, 0 ) != MAP_FAILED)
     {
         set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED );
+        view->region_count = 0;
         return STATUS_SUCCESS;
     }
     return STATUS_NO_MEMORY;
@@ -2107,7 +2429,7 @@ static NTSTATUS allocate_dos_memory( struct file_view **view, unsigned int vprot
     if (mmap_is_in_reserved_area( low_64k, dosmem_size - 0x10000 ) != 1)
     {
         addr = anon_mmap_tryfixed( low_64k, dosmem_size - 0x10000, unix_prot, 0 );
-        if (addr == MAP_FAILED) return map_view( view, NULL, dosmem_size, FALSE, vprot, 0 );
+        if (addr == MAP_FAILED) return map_view( view, NULL, dosmem_size, FALSE, vprot, 0, granularity_mask );
     }
 
     /* now try to allocate the low 64K too */
@@ -2451,9 +2773,11 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     if ((ULONG_PTR)base != image_info->base) base = NULL;
 
     if ((char *)base >= (char *)address_space_start)  /* make sure the DOS area remains free */
-        status = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits );
+        status = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits,
+                           granularity_mask );
 
-    if (status) status = map_view( &view, NULL, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits );
+    if (status) status = map_view( &view, NULL, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits,
+                                   granularity_mask );
     if (status) goto done;
 
     status = map_image_into_view( view, filename, unix_fd, base, image_info->header_size,
@@ -2576,7 +2900,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_PTR z
 
     server_enter_uninterrupted_section( &virtual_mutex, &sigset );
 
-    res = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits );
+    res = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits, granularity_mask );
     if (res) goto done;
 
     TRACE( "handle=%p size=%lx offset=%x%08x\n", handle, size, offset.u.HighPart, offset.u.LowPart );
@@ -2840,6 +3164,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
             if (sec[i].Characteristics & IMAGE_SCN_MEM_WRITE) flags |= VPROT_WRITE;
             set_page_vprot( (char *)base + sec[i].VirtualAddress, sec[i].Misc.VirtualSize, flags );
         }
+        view->region_count = 0;
 
         SERVER_START_REQ( map_view )
         {
@@ -3114,7 +3439,8 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     server_enter_uninterrupted_section( &virtual_mutex, &sigset );
 
     if ((status = map_view( &view, NULL, size + extra_size, FALSE,
-                            VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, zero_bits )) != STATUS_SUCCESS)
+                            VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, zero_bits,
+                            granularity_mask )) != STATUS_SUCCESS)
         goto done;
 
 #ifdef VALGRIND_STACK_REGISTER
@@ -3125,6 +3451,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     set_page_vprot( view->base, page_size, VPROT_COMMITTED );
     set_page_vprot( (char *)view->base + page_size, page_size,
                     VPROT_READ | VPROT_WRITE | VPROT_COMMITTED | VPROT_GUARD );
+    view->region_count = 0;
     mprotect_range( view->base, 2 * page_size, 0, 0 );
     VIRTUAL_DEBUG_DUMP_VIEW( view );
 
@@ -3135,11 +3462,13 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
         /* shrink the first view and create a second one for the extra size */
         /* this allows the app to free the stack without freeing the thread start portion */
         view->size -= extra_size;
+        view->region_count = 0;
         status = create_view( &extra_view, (char *)view->base + view->size, extra_size,
                               VPROT_READ | VPROT_WRITE | VPROT_COMMITTED );
         if (status != STATUS_SUCCESS)
         {
             view->size += extra_size;
+            view->region_count = 0;
             delete_view( view );
             goto done;
         }
@@ -3225,8 +3554,10 @@ static BOOL is_inside_thread_stack( void *ptr, struct thread_stack_info *stack )
  */
 static NTSTATUS grow_thread_stack( char *page, struct thread_stack_info *stack_info )
 {
+    struct file_view *view = find_view( page, 0 );
     NTSTATUS ret = 0;
 
+    if (view) view->region_count = 0;
     set_page_vprot_bits( page, page_size, 0, VPROT_GUARD );
     mprotect_range( page, page_size, 0, 0 );
     if (page >= stack_info->start + page_size + stack_info->guaranteed)
@@ -3267,6 +3598,9 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
         struct thread_stack_info stack_info;
         if (!is_inside_thread_stack( page, &stack_info ))
         {
+            struct file_view *view = find_view( page, 0 );
+
+            if (view) view->region_count = 0;
             set_page_vprot_bits( page, page_size, 0, VPROT_GUARD );
             mprotect_range( page, page_size, 0, 0 );
             ret = STATUS_GUARD_PAGE_VIOLATION;
@@ -3795,12 +4129,22 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
     /* Compute the alloc type flags */
 
     if (!(type & (MEM_COMMIT | MEM_RESERVE | MEM_RESET)) ||
-        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET)))
+        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET | MEM_LARGE_PAGES)))
     {
         WARN("called with wrong alloc type flags (%08x) !\n", type);
         return STATUS_INVALID_PARAMETER;
     }
 
+    /* large pages are always committed, and aligned on the large page size */
+    if ((type & MEM_LARGE_PAGES) &&
+        ((type & (MEM_COMMIT | MEM_RESERVE)) != (MEM_COMMIT | MEM_RESERVE) ||
+         (type & MEM_WRITE_WATCH) || is_dos_memory || (size & large_page_mask) ||
+         ((UINT_PTR)base & large_page_mask)))
+    {
+        WARN("invalid large page allocation %p-%p type %08x\n", base, (char *)base + size, type);
+        return STATUS_INVALID_PARAMETER;
+    }
+
     /* Reserve the memory */
 
     server_enter_uninterrupted_section( &virtual_mutex, &sigset );
@@ -3810,14 +4154,28 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
         if (!(status = get_vprot_flags( protect, &vprot, FALSE )))
         {
             if (type & MEM_COMMIT) vprot |= VPROT_COMMITTED;
-            if (type & MEM_WRITE_WATCH) vprot |= VPROT_WRITEWATCH;
+            if (type & MEM_WRITE_WATCH)
+            {
+                init_write_watches();
+                vprot |= VPROT_WRITEWATCH;
+            }
             if (protect & PAGE_NOCACHE) vprot |= SEC_NOCACHE;
 
             if (vprot & VPROT_WRITECOPY) status = STATUS_INVALID_PAGE_PROTECTION;
             else if (is_dos_memory) status = allocate_dos_memory( &view, vprot );
-            else status = map_view( &view, base, size, type & MEM_TOP_DOWN, vprot, zero_bits );
+            else status = map_view( &view, base, size, type & MEM_TOP_DOWN, vprot, zero_bits,
+                                    (type & MEM_LARGE_PAGES) ? large_page_mask : granularity_mask );
 
-            if (status == STATUS_SUCCESS) base = view->base;
+            if (status == STATUS_SUCCESS)
+            {
+                base = view->base;
+                if ((type & MEM_LARGE_PAGES) && (status = map_large_pages( view ))) delete_view( view );
+            }
+            if (status == STATUS_SUCCESS)
+            {
+                /* new mappings are reported as entirely soft-dirty */
+                if ((vprot & VPROT_WRITEWATCH) && use_soft_dirty) reset_soft_dirty( view->base, view->size );
+            }
         }
     }
     else if (type & MEM_RESET)
@@ -4185,7 +4543,7 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
     {
         BYTE vprot;
 
-        info->RegionSize = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
+        info->RegionSize = get_region_size( view, base, &vprot );
         info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
         info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
         info->AllocationProtect = get_win32_prot( view->protect, view->protect );
@@ -4305,6 +4663,9 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                 p->VirtualAttributes.ShareCount = 1; /* FIXME */
             if (p->VirtualAttributes.Valid)
                 p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
+            /* huge pages can't be swapped out */
+            if (p->VirtualAttributes.Valid && (view->protect & SEC_LARGE_PAGES))
+                p->VirtualAttributes.Locked = p->VirtualAttributes.LargePage = 1;
         }
     }
     server_leave_uninterrupted_section( &virtual_mutex, &sigset );
@@ -4791,6 +5152,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
         char *addr = base;
         char *end = addr + size;
 
+        if (use_soft_dirty) update_soft_dirty( base, size );
         while (pos < *count && addr < end)
         {
             if (!(get_page_vprot( addr ) & VPROT_WRITEWATCH)) addresses[pos++] = addr;
@@ -60,6 +60,14 @@ static RTL_CRITICAL_SECTION vcomp_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 #define VCOMP_DYNAMIC_FLAGS_GUIDED      0x03
 #define VCOMP_DYNAMIC_FLAGS_INCREMENT   0x40
 
+/* dynamic state layout: generation in the high 31 bits, then the initializing flag,
+ * and the number of dispatched iterations in the low 32 bits */
+#define VCOMP_DYNAMIC_INITIALIZING      ((LONG64)1 << 32)
+#define VCOMP_DYNAMIC_GENERATION_SHIFT  33
+
+/* number of iterations to spin before blocking */
+#define VCOMP_SPIN_COUNT                4000
+
 struct vcomp_thread_data
 {
     struct vcomp_team_data  *team;
@@ -87,9 +95,8 @@ struct vcomp_thread_data
 
 struct vcomp_team_data
 {
-    CONDITION_VARIABLE      cond;
     int                     num_threads;
-    int                     finished_threads;
+    LONG                    finished_threads;
 
     /* callback arguments */
     int                     nargs;
@@ -97,22 +104,23 @@ struct vcomp_team_data
     va_list                 valist;
 
     /* barrier */
-    unsigned int            barrier;
-    int                     barrier_count;
+    LONG                    barrier;
+    LONG                    barrier_count;
 };
 
 struct vcomp_task_data
 {
     /* single */
-    unsigned int            single;
+    LONG                    single;
 
     /* section */
+    SRWLOCK                 lock;
     unsigned int            section;
     int                     num_sections;
     int                     section_index;
 
-    /* dynamic */
-    unsigned int            dynamic;
+    /* dynamic, see VCOMP_DYNAMIC_INITIALIZING */
+    LONG64                  dynamic_state;
     unsigned int            dynamic_first;
     unsigned int            dynamic_last;
     unsigned int            dynamic_iterations;
@@ -410,7 +418,8 @@ static struct vcomp_thread_data *vcomp_init_thread_data(void)
 
     data->task.single           = 0;
     data->task.section          = 0;
-    data->task.dynamic          = 0;
+    data->task.dynamic_state    = 0;
+    InitializeSRWLock(&data->task.lock);
 
     thread_data = &data->thread;
     thread_data->team           = NULL;
@@ -427,6 +436,20 @@ static struct vcomp_thread_data *vcomp_init_thread_data(void)
     return thread_data;
 }
 
+/* spin for a while, then block until the value changes */
+static void vcomp_wait_for_change(LONG volatile *addr, LONG value)
+{
+    unsigned int i;
+
+    for (i = 0; i < VCOMP_SPIN_COUNT; i++)
+    {
+        if (ReadAcquire(addr) != value) return;
+        YieldProcessor();
+    }
+    while (ReadAcquire(addr) == value)
+        RtlWaitOnAddress((const void *)addr, &value, sizeof(value), NULL);
+}
+
 static void vcomp_free_thread_data(void)
 {
     struct vcomp_thread_data *thread_data = vcomp_get_thread_data();
@@ -1057,26 +1080,22 @@ void CDECL _vcomp_flush(void)
 void CDECL _vcomp_barrier(void)
 {
     struct vcomp_team_data *team_data = vcomp_init_thread_data()->team;
+    LONG barrier;
 
     TRACE("()\n");
 
     if (!team_data)
         return;
 
-    EnterCriticalSection(&vcomp_section);
-    if (++team_data->barrier_count >= team_data->num_threads)
+    /* the generation cannot change before all threads arrived, including this one */
+    barrier = ReadAcquire(&team_data->barrier);
+    if (InterlockedIncrement(&team_data->barrier_count) >= team_data->num_threads)
     {
-        team_data->barrier++;
         team_data->barrier_count = 0;
-        WakeAllConditionVariable(&team_data->cond);
+        InterlockedIncrement(&team_data->barrier);
+        RtlWakeAddressAll((const void *)&team_data->barrier);
     }
-    else
-    {
-        unsigned int barrier = team_data->barrier;
-        while (team_data->barrier == barrier)
-            SleepConditionVariableCS(&team_data->cond, &vcomp_section, INFINITE);
-    }
-    LeaveCriticalSection(&vcomp_section);
+    else vcomp_wait_for_change(&team_data->barrier, barrier);
 }
 
 void CDECL _vcomp_set_num_threads(int num_threads)
@@ -1102,20 +1121,20 @@ int CDECL _vcomp_single_begin(int flags)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int ret = FALSE;
+    LONG single, prev;
 
     TRACE("(%x): semi-stub\n", flags);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->single++;
-    if ((int)(thread_data->single - task_data->single) > 0)
+    single = ReadAcquire(&task_data->single);
+    while ((int)(thread_data->single - single) > 0)
     {
-        task_data->single = thread_data->single;
-        ret = TRUE;
+        /* the first thread to reach the single region executes it */
+        prev = InterlockedCompareExchange(&task_data->single, thread_data->single, single);
+        if (prev == single) return TRUE;
+        single = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
-
-    return ret;
+    return FALSE;
 }
 
 void CDECL _vcomp_single_end(void)
@@ -1131,7 +1150,7 @@ void CDECL _vcomp_sections_init(int n)
 
     TRACE("(%d)\n", n);
 
-    EnterCriticalSection(&vcomp_section);
+    AcquireSRWLockExclusive(&task_data->lock);
     thread_data->section++;
     if ((int)(thread_data->section - task_data->section) > 0)
     {
@@ -1139,7 +1158,7 @@ void CDECL _vcomp_sections_init(int n)
         task_data->num_sections  = n;
         task_data->section_index = 0;
     }
-    LeaveCriticalSection(&vcomp_section);
+    ReleaseSRWLockExclusive(&task_data->lock);
 }
 
 int CDECL _vcomp_sections_next(void)
@@ -1150,13 +1169,13 @@ int CDECL _vcomp_sections_next(void)
 
     TRACE("()\n");
 
-    EnterCriticalSection(&vcomp_section);
+    AcquireSRWLockExclusive(&task_data->lock);
     if (thread_data->section == task_data->section &&
         task_data->section_index != task_data->num_sections)
     {
         i = task_data->section_index++;
     }
-    LeaveCriticalSection(&vcomp_section);
+    ReleaseSRWLockExclusive(&task_data->lock);
     return i;
 }
 
@@ -1412,6 +1431,16 @@ void CDECL _vcomp_for_static_end(void)
     /* nothing to do here */
 }
 
+static inline LONG64 make_dynamic_state(unsigned int generation)
+{
+    return (ULONG64)generation << VCOMP_DYNAMIC_GENERATION_SHIFT;
+}
+
+static inline unsigned int dynamic_state_generation(LONG64 state)
+{
+    return (ULONG64)state >> VCOMP_DYNAMIC_GENERATION_SHIFT;
+}
+
 void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsigned int last,
                                    int step, unsigned int chunksize)
 {
@@ -1422,6 +1451,7 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
     int num_threads = team_data ? team_data->num_threads : 1;
     int thread_num = thread_data->thread_num;
     unsigned int type = flags & ~VCOMP_DYNAMIC_FLAGS_INCREMENT;
+    LONG64 state, new_state, prev;
 
     TRACE("(%u, %u, %u, %d, %u)\n", flags, first, last, step, chunksize);
 
@@ -1467,19 +1497,27 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
             type = VCOMP_DYNAMIC_FLAGS_GUIDED;
         }
 
-        EnterCriticalSection(&vcomp_section);
         thread_data->dynamic++;
         thread_data->dynamic_type = type;
-        if ((int)(thread_data->dynamic - task_data->dynamic) > 0)
+
+        /* the first thread to reach the loop initializes it, generations are compared modulo 2^31 */
+        state = InterlockedCompareExchange64(&task_data->dynamic_state, 0, 0);
+        while ((int)((thread_data->dynamic - dynamic_state_generation(state)) << 1) > 0)
         {
-            task_data->dynamic              = thread_data->dynamic;
-            task_data->dynamic_first        = first;
-            task_data->dynamic_last         = last;
-            task_data->dynamic_iterations   = iterations;
-            task_data->dynamic_step         = step;
-            task_data->dynamic_chunksize    = chunksize;
+            new_state = make_dynamic_state(thread_data->dynamic) | VCOMP_DYNAMIC_INITIALIZING;
+            prev = InterlockedCompareExchange64(&task_data->dynamic_state, new_state, state);
+            if (prev == state)
+            {
+                task_data->dynamic_first        = first;
+                task_data->dynamic_last         = last;
+                task_data->dynamic_iterations   = iterations;
+                task_data->dynamic_step         = step;
+                task_data->dynamic_chunksize    = chunksize;
+                InterlockedCompareExchange64(&task_data->dynamic_state, make_dynamic_state(thread_data->dynamic), new_state);
+                break;
+            }
+            state = prev;
         }
-        LeaveCriticalSection(&vcomp_section);
     }
 }
 
@@ -1502,26 +1540,43 @@ int CDECL _vcomp_for_dynamic_next(unsigned int *begin, unsigned int *end)
     else if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_CHUNKED ||
              thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED)
     {
-        unsigned int iterations = 0;
-        EnterCriticalSection(&vcomp_section);
-        if (thread_data->dynamic == task_data->dynamic &&
-            task_data->dynamic_iterations != 0)
+        unsigned int iterations, dispatched, remaining;
+        LONG64 state;
+
+        /* Chunks are dispatched by atomically updating the number of dispatched iterations.
+         * The loop parameters are only valid as long as the state is unchanged, since the
+         * initializing thread of the next loop first marks the state as initializing. */
+        for (;;)
         {
-            iterations = min(task_data->dynamic_iterations, task_data->dynamic_chunksize);
+            state = InterlockedCompareExchange64(&task_data->dynamic_state, 0, 0);
+            if (dynamic_state_generation(state) != dynamic_state_generation(make_dynamic_state(thread_data->dynamic)))
+                return 0;
+
+            if (state & VCOMP_DYNAMIC_INITIALIZING)
+            {
+                YieldProcessor();
+                continue;
+            }
+            dispatched = (unsigned int)state;
+
+            remaining = task_data->dynamic_iterations - dispatched;
+            iterations = min(remaining, task_data->dynamic_chunksize);
             if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED &&
-                task_data->dynamic_iterations > num_threads * task_data->dynamic_chunksize)
+                remaining > num_threads * task_data->dynamic_chunksize)
             {
-                iterations = (task_data->dynamic_iterations + num_threads - 1) / num_threads;
+                iterations = (remaining + num_threads - 1) / num_threads;
             }
-            *begin = task_data->dynamic_first;
-            *end   = task_data->dynamic_first + (iterations - 1) * task_data->dynamic_step;
-            task_data->dynamic_iterations -= iterations;
-            task_data->dynamic_first      += iterations * task_data->dynamic_step;
-            if (!task_data->dynamic_iterations)
+            if (!iterations)
+                return 0;
+
+            *begin = task_data->dynamic_first + dispatched * task_data->dynamic_step;
+            *end   = *begin + (iterations - 1) * task_data->dynamic_step;
+            if (iterations == remaining)
                 *end = task_data->dynamic_last;
+
+            if (InterlockedCompareExchange64(&task_data->dynamic_state, state + iterations, state) == state)
+                return 1;
         }
-        LeaveCriticalSection(&vcomp_section);
-        return iterations != 0;
     }
 
     return 0;
@@ -1536,6 +1591,9 @@ int CDECL omp_in_parallel(void)
 static DWORD WINAPI _vcomp_fork_worker(void *param)
 {
     struct vcomp_thread_data *thread_data = param;
+    unsigned int i;
+    int num_threads;
+
     vcomp_set_thread_data(thread_data);
 
     TRACE("starting worker thread for %p\n", thread_data);
@@ -1553,8 +1611,19 @@ static DWORD WINAPI _vcomp_fork_worker(void *param)
             thread_data->team = NULL;
             list_remove(&thread_data->entry);
             list_add_tail(&vcomp_idle_threads, &thread_data->entry);
-            if (++team->finished_threads >= team->num_threads)
-                WakeAllConditionVariable(&team->cond);
+            LeaveCriticalSection(&vcomp_section);
+
+            /* the team data is owned by the master thread, don't access it after signaling */
+            num_threads = team->num_threads;
+            if (InterlockedIncrement(&team->finished_threads) >= num_threads)
+                RtlWakeAddressAll((const void *)&team->finished_threads);
+
+            /* stay warm for a while, back to back parallel regions are common */
+            for (i = 0; i < VCOMP_SPIN_COUNT && !*(struct vcomp_team_data * volatile *)&thread_data->team; i++)
+                YieldProcessor();
+
+            EnterCriticalSection(&vcomp_section);
+            continue;
         }
 
         if (!SleepConditionVariableCS(&thread_data->cond, &vcomp_section, 5000) &&
@@ -1594,7 +1663,6 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     else
         num_threads = vcomp_num_threads;
 
-    InitializeConditionVariable(&team_data.cond);
     team_data.num_threads       = 1;
     team_data.finished_threads  = 0;
     team_data.nargs             = nargs;
@@ -1605,7 +1673,8 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
 
     task_data.single            = 0;
     task_data.section           = 0;
-    task_data.dynamic           = 0;
+    task_data.dynamic_state     = 0;
+    InitializeSRWLock(&task_data.lock);
 
     thread_data.team            = &team_data;
     thread_data.task            = &task_data;
@@ -1687,13 +1756,13 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
 
     if (team_data.num_threads > 1)
     {
-        EnterCriticalSection(&vcomp_section);
-
-        team_data.finished_threads++;
-        while (team_data.finished_threads < team_data.num_threads)
-            SleepConditionVariableCS(&team_data.cond, &vcomp_section, INFINITE);
+        LONG finished = InterlockedIncrement(&team_data.finished_threads);
 
-        LeaveCriticalSection(&vcomp_section);
+        while (finished < team_data.num_threads)
+        {
+            vcomp_wait_for_change(&team_data.finished_threads, finished);
+            finished = ReadAcquire(&team_data.finished_threads);
+        }
         assert(list_empty(&thread_data.entry));
     }
 
@@ -595,7 +595,7 @@ static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *sr
 
     offset.x = src_rect->left - dst_rect->left;
     offset.y = src_rect->top  - dst_rect->top;
-    dst->funcs->blend_rects( dst, clipped_rects.count, clipped_rects.rects, src, &offset, blend );
+    blend_rects_parallel( dst, clipped_rects.count, clipped_rects.rects, src, &offset, blend );
 
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
@@ -682,15 +682,11 @@ static void get_gradient_triangle_vertices( const GRADIENT_TRIANGLE *tri, const
 
 static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, const RECT *bounds )
 {
-    int i;
     struct clipped_rects clipped_rects;
-    BOOL ret = TRUE;
+    BOOL ret;
 
     if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
-    for (i = 0; i < clipped_rects.count; i++)
-    {
-        if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
-    }
+    ret = gradient_rects_parallel( dib, clipped_rects.count, clipped_rects.rects, v, mode );
     free_clipped_rects( &clipped_rects );
     return ret;
 }
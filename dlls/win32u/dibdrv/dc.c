@@ -23,6 +23,7 @@
 #endif
 
 #include <assert.h>
+#include <pthread.h>
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -322,6 +323,260 @@ void add_clipped_bounds( dibdrv_physdev *dev, const RECT *rect, HRGN clip )
     add_bounds_rect( dev->bounds, &rc );
 }
 
+/* Large blends and fills can optionally be split into bands of rows processed
+ * by a pool of helper threads. The helpers are Wine threads started through a
+ * PE entry point that calls band_thread(), so that page faults on DIB sections,
+ * e.g. for write watches, are handled the same way as in the calling thread.
+ */
+
+#define MIN_BAND_PIXELS  (256 * 1024)  /* don't bother splitting smaller operations */
+#define MIN_BAND_HEIGHT  16
+#define MAX_BAND_THREADS 16
+#define BANDS_PER_THREAD 4             /* helps balancing the load between threads */
+
+struct band_job
+{
+    void          (*proc)( struct band_job *job, const RECT *rc );
+    const RECT     *rects;        /* rectangles of the operation */
+    int             count;
+    int             top;          /* first row of the operation */
+    int             bottom;       /* last row + 1 */
+    int             height;       /* height of each band */
+    int             bands;        /* total number of bands */
+    LONG            next;         /* next band to process */
+    unsigned int    users;        /* number of helper threads using the job */
+    const dib_info *dib;
+    const dib_info *src;
+    const POINT    *offset;
+    BLENDFUNCTION   blend;
+    DWORD           and, xor;
+    const TRIVERTEX *vert;
+    int             mode;
+    BOOL            ret;          /* cleared if an operation fails, or a band faults */
+};
+
+static pthread_mutex_t band_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t band_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t band_done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t band_init_once = PTHREAD_ONCE_INIT;
+static struct band_job *band_job;      /* job currently being processed */
+static unsigned int band_serial;       /* incremented for every new job */
+static unsigned int band_threads = 1;  /* number of threads, including the calling one */
+static PRTL_THREAD_START_ROUTINE band_thread_start;  /* PE entry point of the helper threads */
+
+static void process_bands( struct band_job *job )
+{
+    RECT rc;
+    LONG band;
+    int i, top, bottom;
+
+    while ((band = InterlockedIncrement( &job->next ) - 1) < job->bands)
+    {
+        top = job->top + band * job->height;
+        bottom = min( top + job->height, job->bottom );
+        for (i = 0; i < job->count; i++)
+        {
+            rc = job->rects[i];
+            rc.top = max( rc.top, top );
+            rc.bottom = min( rc.bottom, bottom );
+            if (rc.top < rc.bottom) job->proc( job, &rc );
+        }
+    }
+}
+
+/***********************************************************************
+ *           band_thread_init
+ *
+ * Set the PE entry point used to start the helper threads.
+ */
+NTSTATUS band_thread_init( void *args )
+{
+    band_thread_start = args;
+    return 0;
+}
+
+/***********************************************************************
+ *           band_thread
+ *
+ * Main loop of the helper threads. args points to the job being processed by the
+ * thread; the PE side calls us again with it if a page fault aborted the previous call.
+ */
+NTSTATUS band_thread( void *args )
+{
+    struct band_job **current = args;
+    struct band_job *job;
+    unsigned int serial;
+
+    pthread_mutex_lock( &band_mutex );
+    serial = band_serial;
+    if ((job = *current))
+    {
+        WARN( "fault while processing job %p\n", job );
+        job->ret = FALSE;
+        *current = NULL;
+        if (!--job->users) pthread_cond_signal( &band_done_cond );
+    }
+    for (;;)
+    {
+        while (!band_job || band_serial == serial) pthread_cond_wait( &band_start_cond, &band_mutex );
+        serial = band_serial;
+        *current = job = band_job;
+        job->users++;
+        pthread_mutex_unlock( &band_mutex );
+
+        process_bands( job );
+
+        pthread_mutex_lock( &band_mutex );
+        *current = NULL;
+        if (!--job->users) pthread_cond_signal( &band_done_cond );
+    }
+    return 0;
+}
+
+static void init_band_threads(void)
+{
+    unsigned int count = 0, i, size;
+    char buffer[offsetof( KEY_VALUE_PARTIAL_INFORMATION, Data[32 * sizeof(WCHAR)] )];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (void *)buffer;
+    HANDLE handle;
+    HKEY hkey;
+
+    if (!band_thread_start) return;  /* not supported in wow64 mode */
+
+    /* @@ Wine registry key: HKCU\Software\Wine\GDI */
+    if (!(hkey = reg_open_hkcu_key( "Software\\Wine\\GDI" ))) return;
+    if ((size = query_reg_ascii_value( hkey, "DibThreads", info, sizeof(buffer) )))
+    {
+        if (info->Type == REG_DWORD && size == sizeof(DWORD)) count = *(DWORD *)info->Data;
+        else if (info->Type == REG_SZ)
+        {
+            const WCHAR *str = (const WCHAR *)info->Data;
+            for (i = 0; i < size / sizeof(WCHAR) && str[i] >= '0' && str[i] <= '9'; i++)
+                count = min( count * 10 + str[i] - '0', MAX_BAND_THREADS );
+        }
+    }
+    NtClose( hkey );
+
+    count = min( count, min( system_info.NumberOfProcessors, MAX_BAND_THREADS ));
+    if (count <= 1) return;
+
+    for (i = 1; i < count; i++)
+    {
+        if (NtCreateThreadEx( &handle, THREAD_ALL_ACCESS, NULL, NtCurrentProcess(), band_thread_start,
+                              NULL, THREAD_CREATE_FLAGS_HIDE_FROM_DEBUGGER, 0, 0, 0, NULL )) break;
+        NtClose( handle );
+    }
+
+    band_threads = i;
+    TRACE( "using %u threads for large operations\n", band_threads );
+}
+
+/* run the job in parallel bands if it's large enough, return FALSE if the caller should do it */
+static BOOL run_band_job( struct band_job *job, const dib_info *dib, int count, const RECT *rects )
+{
+    unsigned int pixels = 0;
+    int i;
+
+    pthread_once( &band_init_once, init_band_threads );
+    if (band_threads <= 1 || !count) return FALSE;
+
+    job->top = rects[0].top;
+    job->bottom = rects[0].bottom;
+    for (i = 0; i < count && pixels < MIN_BAND_PIXELS; i++)
+        pixels += (rects[i].right - rects[i].left) * (rects[i].bottom - rects[i].top);
+    if (pixels < MIN_BAND_PIXELS) return FALSE;
+    for (i = 1; i < count; i++)
+    {
+        job->top = min( job->top, rects[i].top );
+        job->bottom = max( job->bottom, rects[i].bottom );
+    }
+    job->height = max( MIN_BAND_HEIGHT, (job->bottom - job->top + band_threads * BANDS_PER_THREAD - 1) /
+                                        (band_threads * BANDS_PER_THREAD) );
+    job->bands = (job->bottom - job->top + job->height - 1) / job->height;
+    if (job->bands <= 1) return FALSE;
+
+    job->rects = rects;
+    job->count = count;
+    job->next = 0;
+    job->users = 0;
+
+    pthread_mutex_lock( &band_mutex );
+    if (band_job)  /* already in use by another thread */
+    {
+        pthread_mutex_unlock( &band_mutex );
+        return FALSE;
+    }
+    band_job = job;
+    band_serial++;
+    pthread_cond_broadcast( &band_start_cond );
+    pthread_mutex_unlock( &band_mutex );
+
+    process_bands( job );
+
+    pthread_mutex_lock( &band_mutex );
+    while (job->users) pthread_cond_wait( &band_done_cond, &band_mutex );
+    band_job = NULL;
+    pthread_mutex_unlock( &band_mutex );
+    return TRUE;
+}
+
+static void solid_rect_band( struct band_job *job, const RECT *rc )
+{
+    job->dib->funcs->solid_rects( job->dib, 1, rc, job->and, job->xor );
+}
+
+void solid_rects_parallel( const dib_info *dib, int num, const RECT *rects, DWORD and, DWORD xor )
+{
+    struct band_job job;
+
+    job.proc = solid_rect_band;
+    job.dib  = dib;
+    job.src  = NULL;
+    job.and  = and;
+    job.xor  = xor;
+    if (!run_band_job( &job, dib, num, rects )) dib->funcs->solid_rects( dib, num, rects, and, xor );
+}
+
+static void blend_rect_band( struct band_job *job, const RECT *rc )
+{
+    job->dib->funcs->blend_rects( job->dib, 1, rc, job->src, job->offset, job->blend );
+}
+
+void blend_rects_parallel( const dib_info *dst, int num, const RECT *rects, const dib_info *src,
+                           const POINT *offset, BLENDFUNCTION blend )
+{
+    struct band_job job;
+
+    job.proc   = blend_rect_band;
+    job.dib    = dst;
+    job.src    = src;
+    job.offset = offset;
+    job.blend  = blend;
+    if (!run_band_job( &job, dst, num, rects )) dst->funcs->blend_rects( dst, num, rects, src, offset, blend );
+}
+
+static void gradient_rect_band( struct band_job *job, const RECT *rc )
+{
+    if (!job->dib->funcs->gradient_rect( job->dib, rc, job->vert, job->mode )) job->ret = FALSE;
+}
+
+BOOL gradient_rects_parallel( const dib_info *dib, int num, const RECT *rects, const TRIVERTEX *v, int mode )
+{
+    struct band_job job;
+    int i;
+
+    job.proc = gradient_rect_band;
+    job.dib  = dib;
+    job.src  = NULL;
+    job.vert = v;
+    job.mode = mode;
+    job.ret  = TRUE;
+    if (run_band_job( &job, dib, num, rects )) return job.ret;
+
+    for (i = 0; i < num; i++) if (!dib->funcs->gradient_rect( dib, &rects[i], v, mode )) return FALSE;
+    return TRUE;
+}
+
 /**********************************************************************
  *	     dibdrv_CreateDC
  */
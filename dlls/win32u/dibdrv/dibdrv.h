@@ -260,6 +260,12 @@ extern int get_dib_rect( const dib_info *dib, RECT *rc ) DECLSPEC_HIDDEN;
 extern int clip_rect_to_dib( const dib_info *dib, RECT *rc ) DECLSPEC_HIDDEN;
 extern int get_clipped_rects( const dib_info *dib, const RECT *rc, HRGN clip, struct clipped_rects *clip_rects ) DECLSPEC_HIDDEN;
 extern void add_clipped_bounds( dibdrv_physdev *dev, const RECT *rect, HRGN clip ) DECLSPEC_HIDDEN;
+extern void solid_rects_parallel( const dib_info *dib, int num, const RECT *rects,
+                                  DWORD and, DWORD xor ) DECLSPEC_HIDDEN;
+extern void blend_rects_parallel( const dib_info *dst, int num, const RECT *rects, const dib_info *src,
+                                  const POINT *offset, BLENDFUNCTION blend ) DECLSPEC_HIDDEN;
+extern BOOL gradient_rects_parallel( const dib_info *dib, int num, const RECT *rects,
+                                     const TRIVERTEX *v, int mode ) DECLSPEC_HIDDEN;
 extern int clip_line(const POINT *start, const POINT *end, const RECT *clip,
                      const bres_params *params, POINT *pt1, POINT *pt2) DECLSPEC_HIDDEN;
 extern void release_cached_font( struct cached_font *font ) DECLSPEC_HIDDEN;
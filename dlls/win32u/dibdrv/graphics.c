@@ -47,18 +47,41 @@ enum glyph_type
 #define GLYPH_CACHE_PAGE_SIZE  0x100
 #define GLYPH_CACHE_PAGES      (0x10000 / GLYPH_CACHE_PAGE_SIZE)
 
+/* glyph bitmaps are packed into slabs that are only freed with the font */
+struct glyph_slab
+{
+    struct glyph_slab *next;
+    SIZE_T             size;   /* size of the data */
+    SIZE_T             used;   /* amount of data already in use */
+    BYTE               data[1];
+};
+
+#define GLYPH_SLAB_SIZE  0x4000
+
 struct cached_font
 {
-    struct list           entry;
+    struct list           entry;       /* entry in the LRU list */
+    struct list           hash_entry;  /* entry in the hash table */
     LONG                  ref;
     DWORD                 hash;
     LOGFONTW              lf;
     XFORM                 xform;
     UINT                  aa_flags;
+    SIZE_T                size;        /* memory used by the font and its glyphs */
+    struct glyph_slab    *slabs;
     struct cached_glyph **glyphs[GLYPH_NBTYPES][GLYPH_CACHE_PAGES];
 };
 
-static struct list font_cache = LIST_INIT( font_cache );
+#define FONT_CACHE_HASH_SIZE  256
+#define FONT_CACHE_MAX_SIZE   (8 * 1024 * 1024)  /* memory limit for the unused fonts */
+
+static struct list font_cache = LIST_INIT( font_cache );  /* most recently used first */
+static struct list font_cache_hash_table[FONT_CACHE_HASH_SIZE];
+static SIZE_T font_cache_size;  /* total memory used by the cached fonts */
+
+/* statistics, only used for tracing */
+static unsigned int font_cache_hits, font_cache_misses;
+static LONG glyph_cache_hits, glyph_cache_misses;
 
 static pthread_mutex_t font_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -525,9 +548,9 @@ static DWORD font_cache_hash( struct cached_font *font )
 
     hash ^= font->aa_flags;
     for(i = 0, ptr = (DWORD*)&font->xform; i < sizeof(XFORM)/sizeof(DWORD); i++, ptr++)
-        hash ^= *ptr;
+        hash = (hash << 5 | hash >> 27) ^ *ptr;
     for(i = 0, ptr = (DWORD*)&font->lf; i < 7; i++, ptr++)
-        hash ^= *ptr;
+        hash = (hash << 5 | hash >> 27) ^ *ptr;
     for(i = 0, ptr = (DWORD*)font->lf.lfFaceName; i < LF_FACESIZE/2; i++, ptr++) {
         two_chars = *ptr;
         pwc = (WCHAR *)&two_chars;
@@ -535,7 +558,7 @@ static DWORD font_cache_hash( struct cached_font *font )
         *pwc = towupper(*pwc);
         pwc++;
         *pwc = towupper(*pwc);
-        hash ^= two_chars;
+        hash = (hash << 5 | hash >> 27) ^ two_chars;
         if (!*pwc) break;
     }
     return hash;
@@ -551,10 +574,44 @@ static int font_cache_cmp( const struct cached_font *p1, const struct cached_fon
     return ret;
 }
 
+/* free a font that is no longer in use, font_cache_lock must be held */
+static void free_cached_font( struct cached_font *font )
+{
+    struct glyph_slab *slab, *next;
+    UINT i, j;
+
+    for (i = 0; i < GLYPH_NBTYPES; i++)
+        for (j = 0; j < GLYPH_CACHE_PAGES; j++) free( font->glyphs[i][j] );
+    for (slab = font->slabs; slab; slab = next)
+    {
+        next = slab->next;
+        free( slab );
+    }
+    list_remove( &font->entry );
+    list_remove( &font->hash_entry );
+    font_cache_size -= font->size;
+    free( font );
+}
+
+/* evict the least recently used fonts until we are below the limit, font_cache_lock must be held */
+static void trim_font_cache(void)
+{
+    struct cached_font *font, *prev;
+
+    LIST_FOR_EACH_ENTRY_SAFE_REV( font, prev, &font_cache, struct cached_font, entry )
+    {
+        if (font_cache_size <= FONT_CACHE_MAX_SIZE) break;
+        if (font->ref) continue;
+        TRACE( "evicting %p (%lu bytes)\n", font, font->size );
+        free_cached_font( font );
+    }
+}
+
 static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 {
-    struct cached_font font, *ptr, *last_unused = NULL;
-    UINT i = 0, j, k;
+    struct cached_font font, *ptr;
+    struct list *bucket;
+    UINT i;
 
     NtGdiExtGetObjectW( hfont, sizeof(font.lf), &font.lf );
     font.xform = dc->xformWorld2Vport;
@@ -570,37 +627,22 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
     font.hash = font_cache_hash( &font );
 
     pthread_mutex_lock( &font_cache_lock );
-    LIST_FOR_EACH_ENTRY( ptr, &font_cache, struct cached_font, entry )
+    if (!font_cache_hash_table[0].next)
+        for (i = 0; i < FONT_CACHE_HASH_SIZE; i++) list_init( &font_cache_hash_table[i] );
+
+    bucket = &font_cache_hash_table[font.hash % FONT_CACHE_HASH_SIZE];
+    LIST_FOR_EACH_ENTRY( ptr, bucket, struct cached_font, hash_entry )
     {
         if (!font_cache_cmp( &font, ptr ))
         {
             InterlockedIncrement( &ptr->ref );
             list_remove( &ptr->entry );
+            font_cache_hits++;
             goto done;
         }
-        if (!ptr->ref)
-        {
-            i++;
-            last_unused = ptr;
-        }
     }
 
-    if (i > 5)  /* keep at least 5 of the most-recently used fonts around */
-    {
-        ptr = last_unused;
-        for (i = 0; i < GLYPH_NBTYPES; i++)
-        {
-            for (j = 0; j < GLYPH_CACHE_PAGES; j++)
-            {
-                if (!ptr->glyphs[i][j]) continue;
-                for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
-                    free( ptr->glyphs[i][j][k] );
-                free( ptr->glyphs[i][j] );
-            }
-        }
-        list_remove( &ptr->entry );
-    }
-    else if (!(ptr = malloc( sizeof(*ptr) )))
+    if (!(ptr = malloc( sizeof(*ptr) )))
     {
         pthread_mutex_unlock( &font_cache_lock );
         return NULL;
@@ -608,7 +650,15 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 
     *ptr = font;
     ptr->ref = 1;
+    ptr->size = sizeof(*ptr);
+    ptr->slabs = NULL;
     memset( ptr->glyphs, 0, sizeof(ptr->glyphs) );
+    list_add_head( bucket, &ptr->hash_entry );
+    font_cache_size += ptr->size;
+    font_cache_misses++;
+    trim_font_cache();
+    TRACE( "%lu bytes, font hits %u misses %u, glyph hits %d misses %d\n", font_cache_size,
+           font_cache_hits, font_cache_misses, glyph_cache_hits, glyph_cache_misses );
 done:
     list_add_head( &font_cache, &ptr->entry );
     pthread_mutex_unlock( &font_cache_lock );
@@ -621,31 +671,73 @@ void release_cached_font( struct cached_font *font )
     if (font) InterlockedDecrement( &font->ref );
 }
 
+/* allocate space for a glyph in the font slabs, font_cache_lock must be held */
+static struct cached_glyph *alloc_glyph( struct cached_font *font, SIZE_T size )
+{
+    struct glyph_slab *slab = font->slabs;
+    void *ret;
+
+    size = (size + 7) & ~7;
+    if (!slab || slab->size - slab->used < size)
+    {
+        SIZE_T slab_size = size > GLYPH_SLAB_SIZE / 4 ? size : GLYPH_SLAB_SIZE;
+
+        if (!(slab = malloc( FIELD_OFFSET( struct glyph_slab, data[slab_size] )))) return NULL;
+        slab->size = slab_size;
+        slab->used = 0;
+        font->size += slab_size;
+        font_cache_size += slab_size;
+        if (font->slabs && slab_size == size)
+        {
+            /* large glyphs get their own slab, keep filling the current one */
+            slab->next = font->slabs->next;
+            font->slabs->next = slab;
+        }
+        else
+        {
+            slab->next = font->slabs;
+            font->slabs = slab;
+        }
+    }
+    ret = slab->data + slab->used;
+    slab->used += size;
+    return ret;
+}
+
 static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT index, UINT flags,
-                                              struct cached_glyph *glyph )
+                                              struct cached_glyph *glyph, SIZE_T size )
 {
     struct cached_glyph *ret;
     enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
     UINT page = index / GLYPH_CACHE_PAGE_SIZE;
     UINT entry = index % GLYPH_CACHE_PAGE_SIZE;
 
+    pthread_mutex_lock( &font_cache_lock );
+    glyph_cache_misses++;
     if (!font->glyphs[type][page])
     {
         struct cached_glyph **ptr;
 
-        ptr = calloc( 1, GLYPH_CACHE_PAGE_SIZE * sizeof(*ptr) );
-        if (!ptr)
-        {
-            free( glyph );
-            return NULL;
-        }
-        if (InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page], ptr, NULL ))
-            free( ptr );
+        if (!(ptr = calloc( 1, GLYPH_CACHE_PAGE_SIZE * sizeof(*ptr) ))) goto failed;
+        font->size += GLYPH_CACHE_PAGE_SIZE * sizeof(*ptr);
+        font_cache_size += GLYPH_CACHE_PAGE_SIZE * sizeof(*ptr);
+        InterlockedExchangePointer( (void **)&font->glyphs[type][page], ptr );
+    }
+    if (!(ret = font->glyphs[type][page][entry]))  /* not added by another thread in the meantime */
+    {
+        if (!(ret = alloc_glyph( font, size ))) goto failed;
+        memcpy( ret, glyph, size );
+        InterlockedExchangePointer( (void **)&font->glyphs[type][page][entry], ret );
+        trim_font_cache();
     }
-    ret = InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page][entry], glyph, NULL );
-    if (!ret) ret = glyph;
-    else free( glyph );
+    pthread_mutex_unlock( &font_cache_lock );
+    free( glyph );
     return ret;
+
+failed:
+    pthread_mutex_unlock( &font_cache_lock );
+    free( glyph );
+    return NULL;
 }
 
 static struct cached_glyph *get_cached_glyph( struct cached_font *font, UINT index, UINT flags )
@@ -804,7 +896,7 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
 
 done:
     glyph->metrics = metrics;
-    return add_cached_glyph( font, index, flags, glyph );
+    return add_cached_glyph( font, index, flags, glyph, FIELD_OFFSET( struct cached_glyph, bits[size] ));
 }
 
 static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT x, INT y,
@@ -815,6 +907,7 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
     struct cached_glyph *glyph;
     dib_info glyph_dib;
     DWORD text_color;
+    LONG hits = 0;
     struct font_intensities intensity;
 
     glyph_dib.bit_count    = get_glyph_depth( font->aa_flags );
@@ -832,8 +925,8 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
 
     for (i = 0; i < count; i++)
     {
-        if (!(glyph = get_cached_glyph( font, str[i], flags )) &&
-            !(glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) continue;
+        if ((glyph = get_cached_glyph( font, str[i], flags ))) hits++;
+        else if (!(glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) continue;
 
         glyph_dib.width       = glyph->metrics.gmBlackBoxX;
         glyph_dib.height      = glyph->metrics.gmBlackBoxY;
@@ -860,6 +953,7 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
             y += glyph->metrics.gmCellIncY;
         }
     }
+    if (TRACE_ON(dib)) InterlockedExchangeAdd( &glyph_cache_hits, hits );
 }
 
 BOOL render_aa_text_bitmapinfo( DC *dc, BITMAPINFO *info, struct gdi_image_bits *bits,
@@ -1197,7 +1291,7 @@ BOOL CDECL dibdrv_PatBlt( PHYSDEV dev, struct bitblt_coords *dst, DWORD rop )
     case R2_WHITE: xor = ~0u;
         /* fall through */
     case R2_BLACK:
-        pdev->dib.funcs->solid_rects( &pdev->dib, clipped_rects.count, clipped_rects.rects, and, xor );
+        solid_rects_parallel( &pdev->dib, clipped_rects.count, clipped_rects.rects, and, xor );
         /* fall through */
     case R2_NOP:
         break;
@@ -29,8 +29,29 @@
 
 #include "wine/debug.h"
 
+/* the SSE2 code is compiled for all x86 builds, and selected at run time */
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__GNUC__) || defined(__clang__))
+#include <emmintrin.h>
+#define SSE2_FUNC __attribute__((target("sse2")))
+#endif
+
 WINE_DEFAULT_DEBUG_CHANNEL(dib);
 
+#ifdef SSE2_FUNC
+static BOOL use_sse2;
+#endif
+
+void init_dib_primitives(void)
+{
+#ifdef SSE2_FUNC
+    SYSTEM_CPU_INFORMATION info;
+
+    if (!NtQuerySystemInformation( SystemCpuInformation, &info, sizeof(info), NULL ))
+        use_sse2 = !!(info.ProcessorFeatureBits & CPU_FEATURE_SSE2);
+    TRACE( "SSE2 primitives %s\n", use_sse2 ? "enabled" : "disabled" );
+#endif
+}
+
 /* Bayer matrices for dithering */
 
 static const BYTE bayer_4x4[4][4] =
@@ -4682,6 +4703,141 @@ static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BL
             blend_color( dst_r, src >> 16, blend.SourceConstantAlpha ) << 16);
 }
 
+#ifdef SSE2_FUNC
+
+/* exact equivalent of (val + 127) / 255 on 16-bit lanes, for val <= 255 * 255 */
+static inline SSE2_FUNC __m128i div255_epu16( __m128i val )
+{
+    val = _mm_add_epi16( val, _mm_set1_epi16( 127 ));
+    return _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( val, _mm_set1_epi16( 1 )), _mm_srli_epi16( val, 8 )), 8 );
+}
+
+/* replicate the alpha channel of each pixel of unpacked 16-bit lanes */
+static inline SSE2_FUNC __m128i broadcast_alpha_epu16( __m128i val )
+{
+    return _mm_shufflehi_epi16( _mm_shufflelo_epi16( val, 0xff ), 0xff );
+}
+
+/* blend 4 pixels in 8888 layout, with the same results as the blend_argb* functions */
+/* returns FALSE if a channel overflows into the next one with non-premultiplied sources */
+static inline SSE2_FUNC BOOL blend_pixels_8888_sse2( __m128i *ret, __m128i d, __m128i s, BLENDFUNCTION blend )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16( 255 );
+    const __m128i alpha = _mm_set1_epi16( blend.SourceConstantAlpha );
+    const __m128i inv_alpha = _mm_set1_epi16( 255 - blend.SourceConstantAlpha );
+    __m128i s_lo = _mm_unpacklo_epi8( s, zero ), s_hi = _mm_unpackhi_epi8( s, zero );
+    __m128i d_lo = _mm_unpacklo_epi8( d, zero ), d_hi = _mm_unpackhi_epi8( d, zero );
+
+    if (blend.AlphaFormat & AC_SRC_ALPHA)
+    {
+        if (blend.SourceConstantAlpha != 255)
+        {
+            s_lo = div255_epu16( _mm_mullo_epi16( s_lo, alpha ));
+            s_hi = div255_epu16( _mm_mullo_epi16( s_hi, alpha ));
+        }
+        d_lo = _mm_add_epi16( s_lo, div255_epu16( _mm_mullo_epi16( d_lo,
+                              _mm_sub_epi16( max, broadcast_alpha_epu16( s_lo )))));
+        d_hi = _mm_add_epi16( s_hi, div255_epu16( _mm_mullo_epi16( d_hi,
+                              _mm_sub_epi16( max, broadcast_alpha_epu16( s_hi )))));
+        if (_mm_movemask_epi8( _mm_or_si128( _mm_cmpgt_epi16( d_lo, max ), _mm_cmpgt_epi16( d_hi, max ))))
+            return FALSE;
+    }
+    else
+    {
+        d_lo = div255_epu16( _mm_add_epi16( _mm_mullo_epi16( s_lo, alpha ), _mm_mullo_epi16( d_lo, inv_alpha )));
+        d_hi = div255_epu16( _mm_add_epi16( _mm_mullo_epi16( s_hi, alpha ), _mm_mullo_epi16( d_hi, inv_alpha )));
+    }
+    *ret = _mm_packus_epi16( d_lo, d_hi );
+    return TRUE;
+}
+
+/* blend a row of 8888 pixels 4 at a time */
+/* src_alpha is ORed into the source pixels when they don't have an alpha channel */
+/* returns the number of pixels that have been processed */
+static SSE2_FUNC int blend_row_8888_sse2( DWORD *dst, const DWORD *src, int len, BLENDFUNCTION blend, DWORD src_alpha )
+{
+    __m128i s, d;
+    int x, i;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        s = _mm_or_si128( _mm_loadu_si128( (const __m128i *)(src + x) ), _mm_set1_epi32( src_alpha ));
+        d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        if (blend_pixels_8888_sse2( &d, d, s, blend ))
+        {
+            _mm_storeu_si128( (__m128i *)(dst + x), d );
+            continue;
+        }
+        for (i = x; i < x + 4; i++)
+        {
+            if (blend.SourceConstantAlpha == 255) dst[i] = blend_argb( dst[i], src[i] );
+            else dst[i] = blend_argb_alpha( dst[i], src[i], blend.SourceConstantAlpha );
+        }
+    }
+    return x;
+}
+
+/* blend a row of 32-bpp pixels with 8-bit channels 4 at a time, with the same results as blend_rgb */
+/* the channels are moved to the 8888 layout, where the alpha channel is ignored */
+/* returns the number of pixels that have been processed */
+static SSE2_FUNC int blend_row_32_sse2( const dib_info *dib, DWORD *dst, const DWORD *src, int len,
+                                        BLENDFUNCTION blend )
+{
+    const __m128i byte = _mm_set1_epi32( 0xff );
+    const __m128i red = _mm_cvtsi32_si128( dib->red_shift );
+    const __m128i green = _mm_cvtsi32_si128( dib->green_shift );
+    const __m128i blue = _mm_cvtsi32_si128( dib->blue_shift );
+    __m128i s, d, ret;
+    int x, i;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        d = _mm_or_si128( _mm_or_si128(
+                _mm_slli_epi32( _mm_and_si128( _mm_srl_epi32( d, red ), byte ), 16 ),
+                _mm_slli_epi32( _mm_and_si128( _mm_srl_epi32( d, green ), byte ), 8 )),
+                _mm_and_si128( _mm_srl_epi32( d, blue ), byte ));
+        if (blend_pixels_8888_sse2( &ret, d, s, blend ))
+        {
+            ret = _mm_or_si128( _mm_or_si128(
+                    _mm_sll_epi32( _mm_and_si128( _mm_srli_epi32( ret, 16 ), byte ), red ),
+                    _mm_sll_epi32( _mm_and_si128( _mm_srli_epi32( ret, 8 ), byte ), green )),
+                    _mm_sll_epi32( _mm_and_si128( ret, byte ), blue ));
+            _mm_storeu_si128( (__m128i *)(dst + x), ret );
+            continue;
+        }
+        for (i = x; i < x + 4; i++)
+        {
+            DWORD val = blend_rgb( dst[i] >> dib->red_shift, dst[i] >> dib->green_shift,
+                                   dst[i] >> dib->blue_shift, src[i], blend );
+            dst[i] = ((( val        & 0xff) << dib->blue_shift) |
+                      (((val >> 8)  & 0xff) << dib->green_shift) |
+                      (((val >> 16) & 0xff) << dib->red_shift));
+        }
+    }
+    return x;
+}
+
+#endif  /* SSE2_FUNC */
+
+static inline int blend_row_8888( DWORD *dst, const DWORD *src, int len, BLENDFUNCTION blend, DWORD src_alpha )
+{
+#ifdef SSE2_FUNC
+    if (use_sse2) return blend_row_8888_sse2( dst, src, len, blend, src_alpha );
+#endif
+    return 0;
+}
+
+static inline int blend_row_32( const dib_info *dib, DWORD *dst, const DWORD *src, int len, BLENDFUNCTION blend )
+{
+#ifdef SSE2_FUNC
+    if (use_sse2) return blend_row_32_sse2( dib, dst, src, len, blend );
+#endif
+    return 0;
+}
+
 static void blend_rects_8888(const dib_info *dst, int num, const RECT *rc,
                              const dib_info *src, const POINT *offset, BLENDFUNCTION blend)
 {
@@ -4692,24 +4848,26 @@ static void blend_rects_8888(const dib_info *dst, int num, const RECT *rc,
         DWORD *src_ptr = get_pixel_ptr_32( src, rc->left + offset->x, rc->top + offset->y );
         DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
 
+        int width = rc->right - rc->left;
+
         if (blend.AlphaFormat & AC_SRC_ALPHA)
         {
             if (blend.SourceConstantAlpha == 255)
                 for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                    for (x = 0; x < rc->right - rc->left; x++)
+                    for (x = blend_row_8888( dst_ptr, src_ptr, width, blend, 0 ); x < width; x++)
                         dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
             else
                 for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                    for (x = 0; x < rc->right - rc->left; x++)
+                    for (x = blend_row_8888( dst_ptr, src_ptr, width, blend, 0 ); x < width; x++)
                         dst_ptr[x] = blend_argb_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
         }
         else if (src->compression == BI_RGB)
             for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                for (x = 0; x < rc->right - rc->left; x++)
+                for (x = blend_row_8888( dst_ptr, src_ptr, width, blend, 0 ); x < width; x++)
                     dst_ptr[x] = blend_argb_constant_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
         else
             for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                for (x = 0; x < rc->right - rc->left; x++)
+                for (x = blend_row_8888( dst_ptr, src_ptr, width, blend, 0xff000000 ); x < width; x++)
                     dst_ptr[x] = blend_argb_no_src_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
     }
 }
@@ -4728,7 +4886,7 @@ static void blend_rects_32(const dib_info *dst, int num, const RECT *rc,
         {
             for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
             {
-                for (x = 0; x < rc->right - rc->left; x++)
+                for (x = blend_row_32( dst, dst_ptr, src_ptr, rc->right - rc->left, blend ); x < rc->right - rc->left; x++)
                 {
                     DWORD val = blend_rgb( dst_ptr[x] >> dst->red_shift,
                                            dst_ptr[x] >> dst->green_shift,
@@ -6133,21 +6291,61 @@ static inline DWORD aa_rgb( BYTE r_dst, BYTE g_dst, BYTE b_dst, DWORD text, cons
             aa_color( r_dst, text >> 16, range->r_min, range->r_max ) << 16);
 }
 
+static inline void draw_glyph_pixels_8888( DWORD *dst_ptr, const BYTE *glyph_ptr, int start, int end,
+                                           DWORD text_pixel, const struct intensity_range *ranges )
+{
+    int x;
+
+    for (x = start; x < end; x++)
+    {
+        if (glyph_ptr[x] <= 1) continue;
+        if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
+        dst_ptr[x] = aa_rgb( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x], text_pixel, ranges + glyph_ptr[x] );
+    }
+}
+
+#ifdef SSE2_FUNC
+/* skip transparent runs and fill opaque runs 16 pixels at a time */
+/* returns the number of pixels that have been processed */
+static SSE2_FUNC int draw_glyph_row_8888_sse2( DWORD *dst_ptr, const BYTE *glyph_ptr, int width,
+                                               DWORD text_pixel, const struct intensity_range *ranges )
+{
+    const __m128i one = _mm_set1_epi8( 1 ), full = _mm_set1_epi8( 16 ), text = _mm_set1_epi32( text_pixel );
+    __m128i val;
+    int x;
+
+    for (x = 0; x + 16 <= width; x += 16)
+    {
+        val = _mm_loadu_si128( (const __m128i *)(glyph_ptr + x) );
+        if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( val, one ), val )) == 0xffff) continue;
+        if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_max_epu8( val, full ), val )) == 0xffff)
+        {
+            _mm_storeu_si128( (__m128i *)(dst_ptr + x), text );
+            _mm_storeu_si128( (__m128i *)(dst_ptr + x + 4), text );
+            _mm_storeu_si128( (__m128i *)(dst_ptr + x + 8), text );
+            _mm_storeu_si128( (__m128i *)(dst_ptr + x + 12), text );
+            continue;
+        }
+        draw_glyph_pixels_8888( dst_ptr, glyph_ptr, x, x + 16, text_pixel, ranges );
+    }
+    return x;
+}
+#endif
+
 static void draw_glyph_8888( const dib_info *dib, const RECT *rect, const dib_info *glyph,
                              const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
 {
     DWORD *dst_ptr = get_pixel_ptr_32( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
-    int x, y;
+    int x, y, width = rect->right - rect->left;
 
     for (y = rect->top; y < rect->bottom; y++)
     {
-        for (x = 0; x < rect->right - rect->left; x++)
-        {
-            if (glyph_ptr[x] <= 1) continue;
-            if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
-            dst_ptr[x] = aa_rgb( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x], text_pixel, ranges + glyph_ptr[x] );
-        }
+        x = 0;
+#ifdef SSE2_FUNC
+        if (use_sse2) x = draw_glyph_row_8888_sse2( dst_ptr, glyph_ptr, width, text_pixel, ranges );
+#endif
+        draw_glyph_pixels_8888( dst_ptr, glyph_ptr, x, width, text_pixel, ranges );
         dst_ptr += dib->stride / 4;
         glyph_ptr += glyph->stride;
     }
@@ -1999,9 +1999,19 @@ static struct gdi_font *alloc_gdi_font( const WCHAR *file, void *data_ptr, SIZE_
     return font;
 }
 
+struct glyph_metrics
+{
+    GLYPHMETRICS gm;
+    ABC          abc;  /* metrics of the unrotated char */
+    LONG         init;
+};
+
+#define GM_BLOCK_SIZE 128
+#define GM_BLOCKS     (0x10000 / GM_BLOCK_SIZE)
+
 static void free_gdi_font( struct gdi_font *font )
 {
-    DWORD i;
+    DWORD i, j;
     struct gdi_font *child, *child_next;
 
     if (font->private) font_funcs->destroy_font( font );
@@ -2011,12 +2021,16 @@ static void free_gdi_font( struct gdi_font *font )
         list_remove( &child->entry );
         free_gdi_font( child );
     }
-    for (i = 0; i < font->gm_size; i++) free( font->gm[i] );
+    for (i = 0; i < ARRAY_SIZE(font->gm); i++)
+    {
+        if (!font->gm[i]) continue;
+        for (j = 0; j < GM_BLOCKS; j++) free( font->gm[i][j] );
+        free( font->gm[i] );
+    }
     free( font->otm.otmpFamilyName );
     free( font->otm.otmpStyleName );
     free( font->otm.otmpFaceName );
     free( font->otm.otmpFullName );
-    free( font->gm );
     free( font->kern_pairs );
     free( font->gsub_table );
     free( font );
@@ -2048,58 +2062,52 @@ static struct gdi_font *create_gdi_font( const struct gdi_font_face *face, const
     return font;
 }
 
-struct glyph_metrics
-{
-    GLYPHMETRICS gm;
-    ABC          abc;  /* metrics of the unrotated char */
-    BOOL         init;
-};
-
-#define GM_BLOCK_SIZE 128
+/* The metrics are cached by the char or glyph index passed by the caller. Blocks
+ * and entries are only added while holding the font lock, and published after
+ * being filled, so that lookups can be done without locking. */
 
 /* TODO: GGO format support */
-static BOOL get_gdi_font_glyph_metrics( struct gdi_font *font, UINT index, GLYPHMETRICS *gm, ABC *abc )
+static BOOL get_gdi_font_glyph_metrics( struct gdi_font *font, UINT glyph, UINT format,
+                                        GLYPHMETRICS *gm, ABC *abc )
 {
-    UINT block = index / GM_BLOCK_SIZE;
-    UINT entry = index % GM_BLOCK_SIZE;
+    struct glyph_metrics **blocks = font->gm[!!(format & GGO_GLYPH_INDEX)];
+    struct glyph_metrics *block;
+    UINT entry = glyph % GM_BLOCK_SIZE;
 
-    if (block < font->gm_size && font->gm[block] && font->gm[block][entry].init)
-    {
-        *gm  = font->gm[block][entry].gm;
-        *abc = font->gm[block][entry].abc;
+    if (!blocks || glyph >= GM_BLOCKS * GM_BLOCK_SIZE) return FALSE;
+    if (!(block = blocks[glyph / GM_BLOCK_SIZE]) || !ReadAcquire( &block[entry].init )) return FALSE;
 
-        TRACE( "cached gm: %u, %u, %s, %d, %d abc: %d, %u, %d\n",
-               gm->gmBlackBoxX, gm->gmBlackBoxY, wine_dbgstr_point( &gm->gmptGlyphOrigin ),
-               gm->gmCellIncX, gm->gmCellIncY, abc->abcA, abc->abcB, abc->abcC );
-        return TRUE;
-    }
+    *gm  = block[entry].gm;
+    *abc = block[entry].abc;
 
-    return FALSE;
+    TRACE( "cached gm: %u, %u, %s, %d, %d abc: %d, %u, %d\n",
+           gm->gmBlackBoxX, gm->gmBlackBoxY, wine_dbgstr_point( &gm->gmptGlyphOrigin ),
+           gm->gmCellIncX, gm->gmCellIncY, abc->abcA, abc->abcB, abc->abcC );
+    return TRUE;
 }
 
-static void set_gdi_font_glyph_metrics( struct gdi_font *font, UINT index,
+/* font_lock must be held */
+static void set_gdi_font_glyph_metrics( struct gdi_font *font, UINT glyph, UINT format,
                                         const GLYPHMETRICS *gm, const ABC *abc )
 {
-    UINT block = index / GM_BLOCK_SIZE;
-    UINT entry = index % GM_BLOCK_SIZE;
+    struct glyph_metrics **blocks = font->gm[!!(format & GGO_GLYPH_INDEX)];
+    struct glyph_metrics *block;
+    UINT entry = glyph % GM_BLOCK_SIZE;
 
-    if (block >= font->gm_size)
+    if (glyph >= GM_BLOCKS * GM_BLOCK_SIZE) return;
+    if (!blocks)
     {
-        struct glyph_metrics **ptr;
-
-        if (!(ptr = realloc( font->gm, (block + 1) * sizeof(*ptr) ))) return;
-        memset( ptr + font->gm_size, 0, (block + 1 - font->gm_size) * sizeof(*ptr) );
-        font->gm_size = block + 1;
-        font->gm = ptr;
+        if (!(blocks = calloc( GM_BLOCKS, sizeof(*blocks) ))) return;
+        InterlockedExchangePointer( (void **)&font->gm[!!(format & GGO_GLYPH_INDEX)], blocks );
     }
-    if (!font->gm[block])
+    if (!(block = blocks[glyph / GM_BLOCK_SIZE]))
     {
-        font->gm[block] = calloc( sizeof(**font->gm), GM_BLOCK_SIZE );
-        if (!font->gm[block]) return;
+        if (!(block = calloc( GM_BLOCK_SIZE, sizeof(*block) ))) return;
+        InterlockedExchangePointer( (void **)&blocks[glyph / GM_BLOCK_SIZE], block );
     }
-    font->gm[block][entry].gm   = *gm;
-    font->gm[block][entry].abc  = *abc;
-    font->gm[block][entry].init = TRUE;
+    block[entry].gm  = *gm;
+    block[entry].abc = *abc;
+    WriteRelease( &block[entry].init, TRUE );
 }
 
 
@@ -3358,12 +3366,19 @@ static DWORD get_glyph_outline( struct gdi_font *font, UINT glyph, UINT format,
                                 GLYPHMETRICS *gm_ret, ABC *abc_ret, DWORD buflen, void *buf,
                                 const MAT2 *mat )
 {
+    struct gdi_font *base_font = font;
     GLYPHMETRICS gm;
     ABC abc;
     DWORD ret = 1;
-    UINT index = glyph;
+    UINT index = glyph, orig_format = format;
     BOOL tategaki = (*get_gdi_font_name( font ) == '@');
 
+    if (mat && !memcmp( mat, &identity, sizeof(*mat) )) mat = NULL;
+
+    if ((format & ~GGO_GLYPH_INDEX) == GGO_METRICS && !mat &&
+        get_gdi_font_glyph_metrics( font, glyph, format, &gm, &abc ))
+        goto done;
+
     if (format & GGO_GLYPH_INDEX)
     {
         /* Windows bitmap font, e.g. Small Fonts, uses ANSI character code
@@ -3385,16 +3400,11 @@ static DWORD get_glyph_outline( struct gdi_font *font, UINT glyph, UINT format,
         }
     }
 
-    if (mat && !memcmp( mat, &identity, sizeof(*mat) )) mat = NULL;
-
-    if (format == GGO_METRICS && !mat && get_gdi_font_glyph_metrics( font, index, &gm, &abc ))
-        goto done;
-
     ret = font_funcs->get_glyph_outline( font, index, format, &gm, &abc, buflen, buf, mat, tategaki );
     if (ret == GDI_ERROR) return ret;
 
     if (format == GGO_METRICS && !mat)
-        set_gdi_font_glyph_metrics( font, index, &gm, &abc );
+        set_gdi_font_glyph_metrics( base_font, glyph, orig_format, &gm, &abc );
 
 done:
     if (gm_ret) *gm_ret = gm;
@@ -3402,6 +3412,28 @@ done:
     return ret;
 }
 
+/* retrieve the ABC widths of a string of glyphs, or of a range if glyphs is NULL,
+ * only taking the font lock if some of them are not cached yet */
+static void get_glyph_abc_widths( struct gdi_font *font, UINT format, UINT first, UINT count,
+                                  const WORD *glyphs, ABC *abc )
+{
+    GLYPHMETRICS gm;
+    UINT i;
+
+    for (i = 0; i < count; i++)
+        if (!get_gdi_font_glyph_metrics( font, glyphs ? glyphs[i] : first + i, format, &gm, &abc[i] )) break;
+    if (i == count) return;
+
+    pthread_mutex_lock( &font_lock );
+    for ( ; i < count; i++)
+    {
+        if (get_glyph_outline( font, glyphs ? glyphs[i] : first + i, format,
+                               NULL, &abc[i], 0, NULL, NULL ) == GDI_ERROR)
+            memset( &abc[i], 0, sizeof(abc[i]) );
+    }
+    pthread_mutex_unlock( &font_lock );
+}
+
 
 /*************************************************************
  * font_FontIsLinked
@@ -3426,7 +3458,6 @@ static BOOL CDECL font_GetCharABCWidths( PHYSDEV dev, UINT first, UINT count,
                                          WCHAR *chars, ABC *buffer )
 {
     struct font_physdev *physdev = get_font_dev( dev );
-    UINT c, i;
 
     if (!physdev->font)
     {
@@ -3436,13 +3467,7 @@ static BOOL CDECL font_GetCharABCWidths( PHYSDEV dev, UINT first, UINT count,
 
     TRACE( "%p, %u, %u, %p\n", physdev->font, first, count, buffer );
 
-    pthread_mutex_lock( &font_lock );
-    for (i = 0; i < count; i++)
-    {
-        c = chars ? chars[i] : first + i;
-        get_glyph_outline( physdev->font, c, GGO_METRICS, NULL, &buffer[i], 0, NULL, NULL );
-    }
-    pthread_mutex_unlock( &font_lock );
+    get_glyph_abc_widths( physdev->font, GGO_METRICS, first, count, chars, buffer );
     return TRUE;
 }
 
@@ -3453,7 +3478,6 @@ static BOOL CDECL font_GetCharABCWidths( PHYSDEV dev, UINT first, UINT count,
 static BOOL CDECL font_GetCharABCWidthsI( PHYSDEV dev, UINT first, UINT count, WORD *gi, ABC *buffer )
 {
     struct font_physdev *physdev = get_font_dev( dev );
-    UINT c;
 
     if (!physdev->font)
     {
@@ -3463,11 +3487,7 @@ static BOOL CDECL font_GetCharABCWidthsI( PHYSDEV dev, UINT first, UINT count, W
 
     TRACE( "%p, %u, %u, %p\n", physdev->font, first, count, buffer );
 
-    pthread_mutex_lock( &font_lock );
-    for (c = 0; c < count; c++, buffer++)
-        get_glyph_outline( physdev->font, gi ? gi[c] : first + c, GGO_METRICS | GGO_GLYPH_INDEX,
-                           NULL, buffer, 0, NULL, NULL );
-    pthread_mutex_unlock( &font_lock );
+    get_glyph_abc_widths( physdev->font, GGO_METRICS | GGO_GLYPH_INDEX, first, count, gi, buffer );
     return TRUE;
 }
 
@@ -3479,8 +3499,8 @@ static BOOL CDECL font_GetCharWidth( PHYSDEV dev, UINT first, UINT count,
                                      const WCHAR *chars, INT *buffer )
 {
     struct font_physdev *physdev = get_font_dev( dev );
-    UINT c, i;
-    ABC abc;
+    ABC abc[64];
+    UINT i, j, n;
 
     if (!physdev->font)
     {
@@ -3490,16 +3510,12 @@ static BOOL CDECL font_GetCharWidth( PHYSDEV dev, UINT first, UINT count,
 
     TRACE( "%p, %d, %d, %p\n", physdev->font, first, count, buffer );
 
-    pthread_mutex_lock( &font_lock );
-    for (i = 0; i < count; i++)
+    for (i = 0; i < count; i += n)
     {
-        c = chars ? chars[i] : i + first;
-        if (get_glyph_outline( physdev->font, c, GGO_METRICS, NULL, &abc, 0, NULL, NULL ) == GDI_ERROR)
-            buffer[i] = 0;
-        else
-            buffer[i] = abc.abcA + abc.abcB + abc.abcC;
+        n = min( count - i, ARRAY_SIZE(abc) );
+        get_glyph_abc_widths( physdev->font, GGO_METRICS, first + i, n, chars ? chars + i : NULL, abc );
+        for (j = 0; j < n; j++) buffer[i + j] = abc[j].abcA + abc[j].abcB + abc[j].abcC;
     }
-    pthread_mutex_unlock( &font_lock );
     return TRUE;
 }
 
@@ -3692,11 +3708,20 @@ static DWORD CDECL font_GetKerningPairs( PHYSDEV dev, DWORD count, KERNINGPAIR *
         return dev->funcs->pGetKerningPairs( dev, count, pairs );
     }
 
-    pthread_mutex_lock( &font_lock );
-    if (physdev->font->kern_count == -1)
-        physdev->font->kern_count = font_funcs->get_kerning_pairs( physdev->font,
-                                                                   &physdev->font->kern_pairs );
-    pthread_mutex_unlock( &font_lock );
+    /* the pairs are never modified once kern_count is set, so no locking is needed after that */
+    if (ReadAcquire( (LONG *)&physdev->font->kern_count ) == -1)
+    {
+        pthread_mutex_lock( &font_lock );
+        if (physdev->font->kern_count == -1)
+        {
+            KERNINGPAIR *kern_pairs = NULL;
+            int kern_count = font_funcs->get_kerning_pairs( physdev->font, &kern_pairs );
+
+            physdev->font->kern_pairs = kern_pairs;
+            WriteRelease( (LONG *)&physdev->font->kern_count, kern_count );
+        }
+        pthread_mutex_unlock( &font_lock );
+    }
 
     if (count && pairs)
     {
@@ -3839,8 +3864,8 @@ static UINT CDECL font_GetTextCharsetInfo( PHYSDEV dev, FONTSIGNATURE *fs, DWORD
 static BOOL CDECL font_GetTextExtentExPoint( PHYSDEV dev, const WCHAR *str, INT count, INT *dxs )
 {
     struct font_physdev *physdev = get_font_dev( dev );
-    INT i, pos;
-    ABC abc;
+    ABC abc[64];
+    INT i, j, n, pos = 0;
 
     if (!physdev->font)
     {
@@ -3850,14 +3875,16 @@ static BOOL CDECL font_GetTextExtentExPoint( PHYSDEV dev, const WCHAR *str, INT
 
     TRACE( "%p, %s, %d\n", physdev->font, debugstr_wn(str, count), count );
 
-    pthread_mutex_lock( &font_lock );
-    for (i = pos = 0; i < count; i++)
+    for (i = 0; i < count; i += n)
     {
-        get_glyph_outline( physdev->font, str[i], GGO_METRICS, NULL, &abc, 0, NULL, NULL );
-        pos += abc.abcA + abc.abcB + abc.abcC;
-        dxs[i] = pos;
+        n = min( count - i, ARRAY_SIZE(abc) );
+        get_glyph_abc_widths( physdev->font, GGO_METRICS, 0, n, str + i, abc );
+        for (j = 0; j < n; j++)
+        {
+            pos += abc[j].abcA + abc[j].abcB + abc[j].abcC;
+            dxs[i + j] = pos;
+        }
     }
-    pthread_mutex_unlock( &font_lock );
     return TRUE;
 }
 
@@ -3868,8 +3895,8 @@ static BOOL CDECL font_GetTextExtentExPoint( PHYSDEV dev, const WCHAR *str, INT
 static BOOL CDECL font_GetTextExtentExPointI( PHYSDEV dev, const WORD *indices, INT count, INT *dxs )
 {
     struct font_physdev *physdev = get_font_dev( dev );
-    INT i, pos;
-    ABC abc;
+    ABC abc[64];
+    INT i, j, n, pos = 0;
 
     if (!physdev->font)
     {
@@ -3879,15 +3906,16 @@ static BOOL CDECL font_GetTextExtentExPointI( PHYSDEV dev, const WORD *indices,
 
     TRACE( "%p, %p, %d\n", physdev->font, indices, count );
 
-    pthread_mutex_lock( &font_lock );
-    for (i = pos = 0; i < count; i++)
+    for (i = 0; i < count; i += n)
     {
-        get_glyph_outline( physdev->font, indices[i], GGO_METRICS | GGO_GLYPH_INDEX,
-                           NULL, &abc, 0, NULL, NULL );
-        pos += abc.abcA + abc.abcB + abc.abcC;
-        dxs[i] = pos;
+        n = min( count - i, ARRAY_SIZE(abc) );
+        get_glyph_abc_widths( physdev->font, GGO_METRICS | GGO_GLYPH_INDEX, 0, n, indices + i, abc );
+        for (j = 0; j < n; j++)
+        {
+            pos += abc[j].abcA + abc[j].abcB + abc[j].abcC;
+            dxs[i + j] = pos;
+        }
     }
-    pthread_mutex_unlock( &font_lock );
     return TRUE;
 }
 
@@ -1166,6 +1166,293 @@ struct unix_face
     struct bitmap_font_size size;
 };
 
+/* Persistent index of the faces found in the font files, so that every process
+ * doesn't have to parse all the files again. It's mapped read-only by all the
+ * processes of the prefix, and replaced atomically when the font files change.
+ */
+
+#define FONT_INDEX_MAGIC    0x58444946  /* "FIDX" */
+#define FONT_INDEX_VERSION  2
+#define FONT_INDEX_NO_NAME  0xffff
+
+struct font_index_header
+{
+    DWORD         magic;
+    DWORD         version;
+    DWORD         build;         /* hash of the Wine and FreeType versions that parsed the fonts */
+    DWORD         lcid;          /* locale used for the names */
+    DWORD         size;          /* total size of the file */
+    DWORD         count;         /* number of entries */
+    DWORD         hash_size;     /* number of hash buckets, a power of 2 */
+    DWORD         buckets[1];    /* offset of the last entry of each bucket */
+};
+
+struct font_index_entry
+{
+    DWORD         next;          /* offset of the previous entry in the same bucket */
+    DWORD         hash;
+    ULONGLONG     file_size;
+    ULONGLONG     mtime;
+    DWORD         face_index;
+    DWORD         num_faces;
+    DWORD         ntm_flags;
+    DWORD         font_version;
+    FONTSIGNATURE fs;
+    WORD          len[5];        /* size of the unix name and of the names, FONT_INDEX_NO_NAME if missing */
+    char          data[1];       /* unix name, then the family, second, style and full names */
+};
+
+static const struct font_index_header *font_index;  /* current index, NULL if missing or invalid */
+static char *font_index_path;
+static BYTE *font_index_new;       /* entries of the updated index */
+static SIZE_T font_index_new_size, font_index_new_alloc;
+static UINT font_index_new_count;
+static BOOL font_index_recording;  /* entries are being collected for the updated index */
+static BOOL font_index_dirty;      /* some files weren't found in the current index */
+
+static DWORD hash_font_index_key( const char *unix_name, UINT face_index )
+{
+    DWORD hash = 2166136261u ^ face_index;
+
+    while (*unix_name) hash = (hash ^ (BYTE)*unix_name++) * 16777619;
+    return hash;
+}
+
+/* invalidate the index when Wine or FreeType is upgraded, since the parsed data may differ;
+ * development builds share the same version, so FONT_INDEX_VERSION still needs to be bumped
+ * when the parsing code changes */
+static DWORD get_font_index_build(void)
+{
+    const char *version = PACKAGE_VERSION;
+    DWORD hash = 2166136261u ^ FT_SimpleVersion;
+
+    while (*version) hash = (hash ^ (BYTE)*version++) * 16777619;
+    return hash;
+}
+
+static DWORD get_font_index_names_offset( const struct font_index_entry *entry )
+{
+    return (offsetof( struct font_index_entry, data[entry->len[0]] ) + 1) & ~1;
+}
+
+static DWORD get_font_index_entry_size( const struct font_index_entry *entry )
+{
+    DWORD i, size = get_font_index_names_offset( entry );
+
+    for (i = 1; i < ARRAY_SIZE(entry->len); i++)
+        if (entry->len[i] != FONT_INDEX_NO_NAME) size += entry->len[i];
+    return (size + 7) & ~7;
+}
+
+static void open_font_index(void)
+{
+    const struct font_index_header *header;
+    const char *dir = ntdll_get_config_dir();
+    struct stat st;
+    void *ptr;
+    int fd;
+
+    if (!dir || !(font_index_path = malloc( strlen(dir) + sizeof("/font_index") ))) return;
+    strcpy( font_index_path, dir );
+    strcat( font_index_path, "/font_index" );
+    font_index_recording = TRUE;
+
+    if ((fd = open( font_index_path, O_RDONLY )) == -1) return;
+    if (!fstat( fd, &st ) && st.st_size >= sizeof(*header) && st.st_size < 0x7fffffff &&
+        (ptr = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 )) != MAP_FAILED)
+    {
+        header = ptr;
+        if (header->magic == FONT_INDEX_MAGIC && header->version == FONT_INDEX_VERSION &&
+            header->build == get_font_index_build() && header->lcid == system_lcid && header->size == st.st_size &&
+            header->hash_size && !(header->hash_size & (header->hash_size - 1)) &&
+            header->hash_size <= (header->size - offsetof( struct font_index_header, buckets )) / sizeof(DWORD))
+        {
+            TRACE( "using %s with %u entries\n", debugstr_a(font_index_path), header->count );
+            font_index = header;
+        }
+        else munmap( ptr, st.st_size );
+    }
+    close( fd );
+}
+
+static const struct font_index_entry *find_font_index_entry( const char *unix_name, UINT face_index,
+                                                             const struct stat *st )
+{
+    const struct font_index_entry *entry;
+    DWORD hash, pos, len = strlen( unix_name );
+
+    if (!font_index) return NULL;
+
+    hash = hash_font_index_key( unix_name, face_index );
+    for (pos = font_index->buckets[hash & (font_index->hash_size - 1)]; pos; pos = entry->next)
+    {
+        /* the entries of a bucket are chained backwards, anything else means the file is corrupted */
+        if (pos % 8 || pos > font_index->size - offsetof( struct font_index_entry, data )) break;
+        entry = (const struct font_index_entry *)((const char *)font_index + pos);
+        if (entry->next >= pos || get_font_index_entry_size( entry ) > font_index->size - pos) break;
+        if (entry->hash != hash || entry->face_index != face_index || entry->len[0] != len) continue;
+        if (memcmp( entry->data, unix_name, len )) continue;
+        if (entry->file_size != st->st_size || entry->mtime != st->st_mtime) break;
+        return entry;
+    }
+    return NULL;
+}
+
+static void append_font_index_entry( const struct font_index_entry *entry )
+{
+    DWORD size = get_font_index_entry_size( entry );
+
+    if (!font_index_recording) return;
+    if (font_index_new_size + size > font_index_new_alloc)
+    {
+        SIZE_T new_alloc = max( font_index_new_alloc * 2, font_index_new_size + size + 0x10000 );
+        BYTE *ptr = realloc( font_index_new, new_alloc );
+
+        if (!ptr)
+        {
+            font_index_recording = FALSE;
+            return;
+        }
+        font_index_new = ptr;
+        font_index_new_alloc = new_alloc;
+    }
+    memcpy( font_index_new + font_index_new_size, entry, size );
+    font_index_new_size += size;
+    font_index_new_count++;
+}
+
+static void add_font_index_entry( const char *unix_name, UINT face_index, const struct stat *st,
+                                  const struct unix_face *face )
+{
+    const WCHAR *names[4] = { face->family_name, face->second_name, face->style_name, face->full_name };
+    struct font_index_entry *entry;
+    DWORD i, len = strlen( unix_name ), size;
+    char *ptr;
+
+    if (!font_index_recording) return;
+    font_index_dirty = TRUE;
+
+    if (len >= FONT_INDEX_NO_NAME) return;
+    size = (offsetof( struct font_index_entry, data[len] ) + 1) & ~1;
+    for (i = 0; i < ARRAY_SIZE(names); i++) if (names[i]) size += lstrlenW( names[i] ) * sizeof(WCHAR);
+    if (!(entry = calloc( 1, (size + 7) & ~7 ))) return;
+
+    entry->hash         = hash_font_index_key( unix_name, face_index );
+    entry->file_size    = st->st_size;
+    entry->mtime        = st->st_mtime;
+    entry->face_index   = face_index;
+    entry->num_faces    = face->num_faces;
+    entry->ntm_flags    = face->ntm_flags;
+    entry->font_version = face->font_version;
+    entry->fs           = face->fs;
+    entry->len[0]       = len;
+    memcpy( entry->data, unix_name, len );
+
+    ptr = (char *)entry + get_font_index_names_offset( entry );
+    for (i = 0; i < ARRAY_SIZE(names); i++)
+    {
+        if (!names[i])
+        {
+            entry->len[i + 1] = FONT_INDEX_NO_NAME;
+            continue;
+        }
+        entry->len[i + 1] = lstrlenW( names[i] ) * sizeof(WCHAR);
+        memcpy( ptr, names[i], entry->len[i + 1] );
+        ptr += entry->len[i + 1];
+    }
+    append_font_index_entry( entry );
+    free( entry );
+}
+
+static struct unix_face *unix_face_from_font_index( const struct font_index_entry *entry )
+{
+    struct unix_face *This;
+    WCHAR **names[4];
+    const char *ptr;
+    DWORD i;
+
+    if (!(This = calloc( 1, sizeof(*This) ))) return NULL;
+    names[0] = &This->family_name;
+    names[1] = &This->second_name;
+    names[2] = &This->style_name;
+    names[3] = &This->full_name;
+
+    ptr = (const char *)entry + get_font_index_names_offset( entry );
+    for (i = 0; i < ARRAY_SIZE(names); i++)
+    {
+        if (entry->len[i + 1] == FONT_INDEX_NO_NAME) continue;
+        if (!(*names[i] = malloc( entry->len[i + 1] + sizeof(WCHAR) ))) goto failed;
+        memcpy( *names[i], ptr, entry->len[i + 1] );
+        (*names[i])[entry->len[i + 1] / sizeof(WCHAR)] = 0;
+        ptr += entry->len[i + 1];
+    }
+    This->scalable     = TRUE;
+    This->num_faces    = entry->num_faces;
+    This->ntm_flags    = entry->ntm_flags;
+    This->font_version = entry->font_version;
+    This->fs           = entry->fs;
+    return This;
+
+failed:
+    for (i = 0; i < ARRAY_SIZE(names); i++) free( *names[i] );
+    free( This );
+    return NULL;
+}
+
+/* write the updated index if the font files changed, and stop collecting entries */
+static void write_font_index(void)
+{
+    struct font_index_header *header = NULL;
+    struct font_index_entry *entry;
+    DWORD hash_size = 16, header_size, pos, *bucket;
+    char *tmp_path = NULL;
+    int fd;
+
+    if (!font_index_recording) goto done;
+    font_index_recording = FALSE;
+    if (!font_index_dirty && font_index && font_index->count == font_index_new_count) goto done;
+
+    while (hash_size < font_index_new_count) hash_size *= 2;
+    header_size = (offsetof( struct font_index_header, buckets[hash_size] ) + 7) & ~7;
+    if (header_size + font_index_new_size >= 0x7fffffff) goto done;
+    if (!(header = calloc( 1, header_size ))) goto done;
+
+    header->magic     = FONT_INDEX_MAGIC;
+    header->version   = FONT_INDEX_VERSION;
+    header->build     = get_font_index_build();
+    header->lcid      = system_lcid;
+    header->size      = header_size + font_index_new_size;
+    header->count     = font_index_new_count;
+    header->hash_size = hash_size;
+    for (pos = 0; pos < font_index_new_size; pos += get_font_index_entry_size( entry ))
+    {
+        entry = (struct font_index_entry *)(font_index_new + pos);
+        bucket = &header->buckets[entry->hash & (hash_size - 1)];
+        entry->next = *bucket;
+        *bucket = header_size + pos;
+    }
+
+    if (!(tmp_path = malloc( strlen( font_index_path ) + sizeof(".XXXXXX") ))) goto done;
+    strcpy( tmp_path, font_index_path );
+    strcat( tmp_path, ".XXXXXX" );
+    if ((fd = mkstemp( tmp_path )) == -1) goto done;
+    if (write( fd, header, header_size ) != header_size ||
+        write( fd, font_index_new, font_index_new_size ) != font_index_new_size ||
+        close( fd ) || rename( tmp_path, font_index_path ))
+    {
+        WARN( "failed to write %s\n", debugstr_a(font_index_path) );
+        unlink( tmp_path );
+    }
+    else TRACE( "wrote %s with %u entries\n", debugstr_a(font_index_path), font_index_new_count );
+
+done:
+    free( tmp_path );
+    free( header );
+    free( font_index_new );
+    font_index_new = NULL;
+    font_index_new_size = font_index_new_alloc = 0;
+}
+
 static struct unix_face *unix_face_create( const char *unix_name, void *data_ptr, DWORD data_size,
                                            UINT face_index, DWORD flags )
 {
@@ -1173,6 +1460,7 @@ static struct unix_face *unix_face_create( const char *unix_name, void *data_ptr
 
     const struct ttc_sfnt_v1 *ttc_sfnt_v1;
     const struct tt_name_v0 *tt_name_v0;
+    const struct font_index_entry *entry;
     struct unix_face *This;
     struct stat st;
     DWORD face_count;
@@ -1183,6 +1471,13 @@ static struct unix_face *unix_face_create( const char *unix_name, void *data_ptr
 
     if (unix_name)
     {
+        if (stat( unix_name, &st ) == -1) return NULL;
+        if ((entry = find_font_index_entry( unix_name, face_index, &st )))
+        {
+            TRACE( "found in index\n" );
+            append_font_index_entry( entry );
+            return unix_face_from_font_index( entry );
+        }
         if ((fd = open( unix_name, O_RDONLY )) == -1) return NULL;
         if (fstat( fd, &st ) == -1)
         {
@@ -1241,6 +1536,7 @@ static struct unix_face *unix_face_create( const char *unix_name, void *data_ptr
             lstrcatW( This->full_name, This->style_name );
             WARN( "full name not found, using %s instead\n", debugstr_w(This->full_name) );
         }
+        if (unix_name) add_font_index_entry( unix_name, face_index, &st, This );
     }
     else if ((This->ft_face = new_ft_face( unix_name, data_ptr, data_size, face_index, flags & ADDFONT_ALLOW_BITMAP )))
     {
@@ -1888,6 +2184,7 @@ static void freetype_load_fonts(void)
 #elif defined(__ANDROID__)
     ReadFontDir("/system/fonts", TRUE);
 #endif
+    write_font_index();
 }
 
 /* Some fonts have large usWinDescent values, as a result of storing signed short
@@ -4252,6 +4549,7 @@ const struct font_backend_funcs *init_freetype_lib(void)
     init_fontconfig();
 #endif
     NtQueryDefaultLocale( FALSE, &system_lcid );
+    open_font_index();
     return &font_funcs;
 }
 
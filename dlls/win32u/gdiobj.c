@@ -1164,6 +1164,7 @@ void gdi_init(void)
     pthread_mutexattr_destroy( &attr );
 
     NtQuerySystemInformation( SystemBasicInformation, &system_info, sizeof(system_info), NULL );
+    init_dib_primitives();
     init_gdi_shared();
     if (!gdi_shared) return;
 
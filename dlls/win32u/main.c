@@ -46,6 +46,15 @@ void __cdecl __wine_spec_unimplemented_stub( const char *module, const char *fun
     for (;;) RtlRaiseException( &record );
 }
 
+/* helper thread for large DIB operations, see band_thread() */
+static DWORD WINAPI dib_band_thread( void *arg )
+{
+    void *job = NULL;
+
+    for (;;) __wine_unix_call( win32u_handle, 3, &job );
+    return 0;
+}
+
 BOOL WINAPI DllMain( HINSTANCE inst, DWORD reason, void *reserved )
 {
     switch (reason)
@@ -58,6 +67,7 @@ BOOL WINAPI DllMain( HINSTANCE inst, DWORD reason, void *reserved )
         {
             __wine_unix_call( win32u_handle, 0, &__wine_syscall_dispatcher );
             wrappers_init( win32u_handle );
+            __wine_unix_call( win32u_handle, 2, dib_band_thread );
         }
         break;
     }
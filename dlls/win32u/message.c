@@ -24,7 +24,16 @@
 #pragma makedep unix
 #endif
 
+#include "config.h"
+
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
 #include "win32u_private.h"
@@ -1777,6 +1786,80 @@ static BOOL process_hardware_message( MSG *msg, UINT hw_id, const struct hardwar
     return ret;
 }
 
+/***********************************************************************
+ *           get_queue_shm
+ *
+ * Get the shared memory where the server publishes the queue status, creating it if needed.
+ */
+static const volatile struct queue_shm *get_queue_shm(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+#if defined(__linux__) && defined(__NR_memfd_create) && defined(F_ADD_SEALS)
+    NTSTATUS status;
+    HANDLE handle;
+    void *ptr;
+    int fd;
+
+    if (thread_info->queue_shm || thread_info->queue_shm_failed) return thread_info->queue_shm;
+    thread_info->queue_shm_failed = TRUE;
+
+    if ((fd = syscall( __NR_memfd_create, "wine-queue", MFD_CLOEXEC | MFD_ALLOW_SEALING )) == -1)
+        return NULL;
+    if (!ftruncate( fd, sizeof(struct queue_shm) ) &&
+        !fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL ) &&
+        (ptr = mmap( NULL, sizeof(struct queue_shm), PROT_READ, MAP_SHARED, fd, 0 )) != MAP_FAILED)
+    {
+        if (!(status = wine_server_fd_to_handle( fd, GENERIC_READ | GENERIC_WRITE, 0, &handle )))
+        {
+            SERVER_START_REQ( init_queue_shm )
+            {
+                req->handle = wine_server_obj_handle( handle );
+                status = wine_server_call( req );
+            }
+            SERVER_END_REQ;
+            NtClose( handle );
+        }
+        if (!status) thread_info->queue_shm = ptr;
+        else munmap( ptr, sizeof(struct queue_shm) );
+    }
+    close( fd );
+    thread_info->queue_shm_failed = !thread_info->queue_shm;
+#endif
+    return thread_info->queue_shm;
+}
+
+/***********************************************************************
+ *           cleanup_queue_shm
+ */
+void cleanup_queue_shm(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+
+    if (thread_info->queue_shm) munmap( (void *)thread_info->queue_shm, sizeof(struct queue_shm) );
+    thread_info->queue_shm = NULL;
+}
+
+/***********************************************************************
+ *           get_shared_queue_bits
+ *
+ * Read the queue status from shared memory, if the queue has already been set up to use it.
+ */
+BOOL get_shared_queue_bits( UINT *wake_bits, UINT *changed_bits )
+{
+    const volatile struct queue_shm *shm = get_user_thread_info()->queue_shm;
+    unsigned int seq;
+
+    if (!shm) return FALSE;
+    do
+    {
+        while ((seq = __atomic_load_n( &shm->seq, __ATOMIC_ACQUIRE )) & 1) YieldProcessor();
+        *wake_bits    = shm->wake_bits;
+        *changed_bits = shm->changed_bits;
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    } while (__atomic_load_n( &shm->seq, __ATOMIC_RELAXED ) != seq);
+    return TRUE;
+}
+
 /***********************************************************************
  *           peek_message
  *
@@ -1794,11 +1877,25 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
     void *buffer;
     size_t buffer_size = 1024;
 
-    if (!(buffer = malloc( buffer_size ))) return -1;
-
     if (!first && !last) last = ~0;
     if (hwnd == HWND_BROADCAST) hwnd = HWND_TOPMOST;
 
+    /* check the shared queue status first, so that polling an empty queue doesn't
+     * need the server; it still needs to see us from time to time to know we aren't
+     * hung, and it signals the process idle event when the broadcast window is used */
+    if (hwnd != HWND_TOPMOST && NtGetTickCount() - thread_info->last_get_msg < 3000)
+    {
+        UINT wake_bits, changed_bits, filter = flags >> 16;
+
+        if (!filter) filter = QS_ALLINPUT;
+        if (filter & QS_POSTMESSAGE) filter |= QS_ALLPOSTMESSAGE | QS_HOTKEY | QS_TIMER;
+        if (get_queue_shm() && get_shared_queue_bits( &wake_bits, &changed_bits ) &&
+            !(wake_bits & (filter | QS_SENDMESSAGE)))
+            return 0;
+    }
+
+    if (!(buffer = malloc( buffer_size ))) return -1;
+
     for (;;)
     {
         NTSTATUS res;
@@ -1818,6 +1915,7 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
             req->wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
             req->changed_mask = changed_mask;
             wine_server_set_reply( req, buffer, buffer_size );
+            thread_info->last_get_msg = NtGetTickCount();
             if (!(res = wine_server_call( req )))
             {
                 size = wine_server_reply_size( reply );
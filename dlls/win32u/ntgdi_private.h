@@ -217,6 +217,7 @@ extern UINT set_dib_dc_color_table( HDC hdc, UINT startpos, UINT entries,
                                     const RGBQUAD *colors ) DECLSPEC_HIDDEN;
 extern void dibdrv_set_window_surface( DC *dc, struct window_surface *surface ) DECLSPEC_HIDDEN;
 extern struct opengl_funcs *dibdrv_get_wgl_driver(void) DECLSPEC_HIDDEN;
+extern void init_dib_primitives(void) DECLSPEC_HIDDEN;
 
 /* driver.c */
 extern const struct gdi_dc_funcs null_driver DECLSPEC_HIDDEN;
@@ -251,8 +252,7 @@ struct gdi_font
     struct list            entry;
     struct list            unused_entry;
     DWORD                  refcount;
-    DWORD                  gm_size;
-    struct glyph_metrics **gm;
+    struct glyph_metrics **gm[2];  /* metrics cache by char and by glyph index, can be read without locking */
     OUTLINETEXTMETRICW     otm;
     KERNINGPAIR           *kern_pairs;
     int                    kern_count;
@@ -134,6 +134,9 @@ struct user_thread_info
     DWORD                         kbd_layout_id;          /* Current keyboard layout ID */
     struct rawinput_thread_data  *rawinput;               /* RawInput thread local data / buffer */
     UINT                          spy_indent;             /* Current spy indent */
+    const volatile struct queue_shm *queue_shm;           /* Queue status shared with the server */
+    BOOL                          queue_shm_failed;       /* Queue status can't be shared */
+    DWORD                         last_get_msg;           /* Time of last get_message server call */
 };
 
 C_ASSERT( sizeof(struct user_thread_info) <= sizeof(((TEB *)0)->Win32ClientInfo) );
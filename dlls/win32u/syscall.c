@@ -323,6 +323,8 @@ unixlib_entry_t __wine_unix_call_funcs[] =
 {
     init,
     callbacks_init,
+    band_thread_init,
+    band_thread,
 };
 
 #ifdef _WIN64
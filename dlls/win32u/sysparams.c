@@ -5366,6 +5366,7 @@ static void thread_detach(void)
 
     destroy_thread_windows();
     cleanup_imm_thread();
+    cleanup_queue_shm();
     NtClose( thread_info->server_queue );
 
     exiting_thread_id = 0;
@@ -24,6 +24,8 @@
 #endif
 
 #include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -39,6 +41,78 @@ WINE_DEFAULT_DEBUG_CHANNEL(win);
 
 static void *user_handles[NB_USER_HANDLES];
 
+static const volatile struct window_shm *window_shm;
+static BOOL window_shm_failed;
+
+/* map the window data published by the server */
+static const volatile struct window_shm *get_window_shm(void)
+{
+    const SIZE_T size = WINDOW_SHM_COUNT * sizeof(struct window_shm);
+    HANDLE handle = 0;
+    NTSTATUS status;
+    void *ptr;
+    int fd;
+
+    if (window_shm || window_shm_failed) return window_shm;
+
+    SERVER_START_REQ( get_window_shm )
+    {
+        if (!(status = wine_server_call( req ))) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (!status)
+    {
+        status = wine_server_handle_to_fd( handle, FILE_READ_DATA, &fd, NULL );
+        NtClose( handle );
+    }
+    if (status)
+    {
+        WARN( "failed to get window shared memory, status %#x\n", (int)status );
+        window_shm_failed = TRUE;
+        return NULL;
+    }
+    ptr = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED)
+    {
+        window_shm_failed = TRUE;
+        return NULL;
+    }
+    if (InterlockedCompareExchangePointer( (void **)&window_shm, ptr, NULL )) munmap( ptr, size );
+    return window_shm;
+}
+
+/***********************************************************************
+ *           get_shared_window_data
+ *
+ * Read the window data published by the server. Return FALSE if the shared memory
+ * isn't available; otherwise data->handle is 0 if the window doesn't exist.
+ */
+static BOOL get_shared_window_data( HWND hwnd, struct window_shm *data )
+{
+    const volatile struct window_shm *shm = get_window_shm(), *entry;
+    UINT index = USER_HANDLE_TO_INDEX( hwnd );
+    unsigned int seq;
+
+    if (!shm) return FALSE;
+    data->handle = 0;
+    if (index >= NB_USER_HANDLES) return TRUE;
+
+    entry = &shm[index];
+    do
+    {
+        while ((seq = __atomic_load_n( &entry->seq, __ATOMIC_ACQUIRE )) & 1) YieldProcessor();
+        *data = *(const struct window_shm *)entry;
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    } while (__atomic_load_n( &entry->seq, __ATOMIC_RELAXED ) != seq);
+
+    /* truncated handles match any generation, same as on the server side */
+    if (data->handle != HandleToUlong( hwnd ) &&
+        (LOWORD(data->handle) != LOWORD(hwnd) || (HIWORD(hwnd) && HIWORD(hwnd) != 0xffff)))
+        data->handle = 0;
+    return TRUE;
+}
+
 #define SWP_AGG_NOGEOMETRYCHANGE \
     (SWP_NOSIZE | SWP_NOCLIENTSIZE | SWP_NOZORDER)
 #define SWP_AGG_NOPOSCHANGE \
@@ -205,6 +279,14 @@ HWND get_full_window_handle( HWND hwnd )
     }
     else  /* may belong to another process */
     {
+        struct window_shm data;
+
+        if (get_shared_window_data( hwnd, &data ))
+        {
+            if (data.handle) return UlongToHandle( data.handle );
+            RtlSetLastWin32Error( ERROR_INVALID_WINDOW_HANDLE );
+            return hwnd;
+        }
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -290,6 +372,7 @@ HWND is_current_process_window( HWND hwnd )
 /* see IsWindow */
 BOOL is_window( HWND hwnd )
 {
+    struct window_shm data;
     WND *win;
     BOOL ret;
 
@@ -303,6 +386,11 @@ BOOL is_window( HWND hwnd )
     }
 
     /* check other processes */
+    if (get_shared_window_data( hwnd, &data ))
+    {
+        if (!data.handle) RtlSetLastWin32Error( ERROR_INVALID_WINDOW_HANDLE );
+        return data.handle != 0;
+    }
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -315,6 +403,7 @@ BOOL is_window( HWND hwnd )
 /* see GetWindowThreadProcessId */
 DWORD get_window_thread( HWND hwnd, DWORD *process )
 {
+    struct window_shm data;
     WND *ptr;
     DWORD tid = 0;
 
@@ -334,6 +423,16 @@ DWORD get_window_thread( HWND hwnd, DWORD *process )
     }
 
     /* check other processes */
+    if (get_shared_window_data( hwnd, &data ))
+    {
+        if (!data.handle)
+        {
+            RtlSetLastWin32Error( ERROR_INVALID_WINDOW_HANDLE );
+            return 0;
+        }
+        if (process) *process = data.pid;
+        return data.tid;
+    }
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -361,7 +460,17 @@ HWND get_parent( HWND hwnd )
     if (win == WND_DESKTOP) return 0;
     if (win == WND_OTHER_PROCESS)
     {
-        LONG style = get_window_long( hwnd, GWL_STYLE );
+        struct window_shm data;
+        LONG style;
+
+        if (get_shared_window_data( hwnd, &data ))
+        {
+            if (!data.handle) RtlSetLastWin32Error( ERROR_INVALID_WINDOW_HANDLE );
+            else if (data.style & WS_POPUP) retval = UlongToHandle( data.owner );
+            else if (data.style & WS_CHILD) retval = UlongToHandle( data.parent );
+            return retval;
+        }
+        style = get_window_long( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -1018,6 +1127,17 @@ static LONG_PTR get_window_long_size( HWND hwnd, INT offset, UINT size, BOOL ans
             RtlSetLastWin32Error( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if (offset == GWL_STYLE || offset == GWL_EXSTYLE)
+        {
+            struct window_shm data;
+
+            if (get_shared_window_data( hwnd, &data ))
+            {
+                if (!data.handle) RtlSetLastWin32Error( ERROR_INVALID_WINDOW_HANDLE );
+                else retval = offset == GWL_STYLE ? data.style : data.ex_style;
+                return retval;
+            }
+        }
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -1536,6 +1656,90 @@ static void mirror_rect( const RECT *window_rect, RECT *rect )
  *
  * Get the window and client rectangles.
  */
+/***********************************************************************
+ *           get_shared_window_rects
+ *
+ * Compute the window rectangles of another process window from the shared window data,
+ * the same way the server does it. Return FALSE if the server needs to be asked.
+ */
+static BOOL get_shared_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_rect,
+                                     RECT *client_rect, UINT dpi, BOOL *ret )
+{
+    struct window_shm data, parent;
+    RECT window, client;
+    UINT depth = 0;
+
+    if (!get_shared_window_data( hwnd, &data )) return FALSE;
+    if (!data.handle)
+    {
+        RtlSetLastWin32Error( ERROR_INVALID_WINDOW_HANDLE );
+        *ret = FALSE;
+        return TRUE;
+    }
+    /* DPI scaling depends on the monitor, leave it to the server */
+    if (data.dpi != dpi) return FALSE;
+
+    SetRect( &window, data.window_rect.left, data.window_rect.top,
+             data.window_rect.right, data.window_rect.bottom );
+    SetRect( &client, data.client_rect.left, data.client_rect.top,
+             data.client_rect.right, data.client_rect.bottom );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        OffsetRect( &window, -data.client_rect.left, -data.client_rect.top );
+        OffsetRect( &client, -data.client_rect.left, -data.client_rect.top );
+        if (data.ex_style & WS_EX_LAYOUTRTL)
+        {
+            RECT rect = { data.client_rect.left, data.client_rect.top,
+                          data.client_rect.right, data.client_rect.bottom };
+            mirror_rect( &rect, &window );
+        }
+        break;
+    case COORDS_WINDOW:
+        OffsetRect( &window, -data.window_rect.left, -data.window_rect.top );
+        OffsetRect( &client, -data.window_rect.left, -data.window_rect.top );
+        if (data.ex_style & WS_EX_LAYOUTRTL)
+        {
+            RECT rect = { data.window_rect.left, data.window_rect.top,
+                          data.window_rect.right, data.window_rect.bottom };
+            mirror_rect( &rect, &client );
+        }
+        break;
+    case COORDS_PARENT:
+        if (!data.parent) break;
+        if (!get_shared_window_data( UlongToHandle( data.parent ), &parent ) || !parent.handle)
+            return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            RECT rect = { parent.client_rect.left, parent.client_rect.top,
+                          parent.client_rect.right, parent.client_rect.bottom };
+            mirror_rect( &rect, &window );
+            mirror_rect( &rect, &client );
+        }
+        break;
+    case COORDS_SCREEN:
+        for (parent.parent = data.parent; parent.parent; )
+        {
+            /* the ancestors are read one by one, give up if the tree looks inconsistent */
+            if (!get_shared_window_data( UlongToHandle( parent.parent ), &parent ) || !parent.handle ||
+                ++depth > 256)
+                return FALSE;
+            if (!parent.parent) break;  /* desktop window */
+            OffsetRect( &window, parent.client_rect.left, parent.client_rect.top );
+            OffsetRect( &client, parent.client_rect.left, parent.client_rect.top );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+
+    if (window_rect) *window_rect = window;
+    if (client_rect) *client_rect = client;
+    *ret = TRUE;
+    return TRUE;
+}
+
 BOOL get_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_rect,
                        RECT *client_rect, UINT dpi )
 {
@@ -1641,6 +1845,7 @@ BOOL get_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_re
     }
 
 other_process:
+    if (get_shared_window_rects( hwnd, relative, window_rect, client_rect, dpi, &ret )) return ret;
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -439,6 +439,29 @@ struct object_type_info
 
 };
 
+
+struct inproc_sync_slot
+{
+    __int64       value;
+    int           seq;
+    int           waiters;
+    unsigned int  generation;
+    unsigned int  type;
+    unsigned int  max;
+    unsigned int  __pad;
+};
+
+enum inproc_sync_type
+{
+    INPROC_SYNC_NONE,
+    INPROC_SYNC_EVENT,
+    INPROC_SYNC_MUTEX,
+    INPROC_SYNC_SEMAPHORE
+};
+
+#define INPROC_SYNC_DETACHED   0x8000000000000000ull
+#define INPROC_SYNC_MAX_SLOTS  0x10000
+
 enum select_op
 {
     SELECT_NONE,
@@ -1357,13 +1380,15 @@ struct create_event_request
     unsigned int access;
     int          manual_reset;
     int          initial_state;
+    int          inproc;
     /* VARARG(objattr,object_attributes); */
+    char __pad_28[4];
 };
 struct create_event_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int inproc_index;
 };
 
 
@@ -1448,14 +1473,14 @@ struct create_mutex_request
     struct request_header __header;
     unsigned int access;
     int          owned;
+    int          inproc;
     /* VARARG(objattr,object_attributes); */
-    char __pad_20[4];
 };
 struct create_mutex_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int inproc_index;
 };
 
 
@@ -1513,13 +1538,15 @@ struct create_semaphore_request
     unsigned int access;
     unsigned int initial;
     unsigned int max;
+    int          inproc;
     /* VARARG(objattr,object_attributes); */
+    char __pad_28[4];
 };
 struct create_semaphore_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int inproc_index;
 };
 
 
@@ -1568,6 +1595,20 @@ struct open_semaphore_reply
 
 
 
+struct init_inproc_sync_request
+{
+    struct request_header __header;
+    int          fd;
+    unsigned int count;
+    char __pad_20[4];
+};
+struct init_inproc_sync_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct create_file_request
 {
     struct request_header __header;
@@ -2674,6 +2715,27 @@ struct get_queue_status_reply
 
 
 
+struct queue_shm
+{
+    unsigned int seq;
+    unsigned int wake_bits;
+    unsigned int changed_bits;
+    unsigned int __pad;
+};
+
+
+struct init_queue_shm_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct init_queue_shm_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct get_process_idle_event_request
 {
     struct request_header __header;
@@ -3149,6 +3211,38 @@ struct set_window_owner_reply
 
 
 
+struct window_shm
+{
+    unsigned int   seq;
+    user_handle_t  handle;
+    thread_id_t    tid;
+    process_id_t   pid;
+    user_handle_t  parent;
+    user_handle_t  owner;
+    unsigned int   style;
+    unsigned int   ex_style;
+    unsigned int   dpi;
+    unsigned int   __pad;
+    rectangle_t    window_rect;
+    rectangle_t    client_rect;
+};
+#define WINDOW_SHM_COUNT ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1)
+
+
+struct get_window_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_window_shm_reply
+{
+    struct reply_header __header;
+    obj_handle_t   handle;
+    char __pad_12[4];
+};
+
+
+
 struct get_window_info_request
 {
     struct request_header __header;
@@ -5064,6 +5158,16 @@ struct add_completion_reply
 
 
 
+struct completion_packet
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    int           __pad;
+};
+
+
 struct remove_completion_request
 {
     struct request_header __header;
@@ -5076,6 +5180,7 @@ struct remove_completion_reply
     apc_param_t   cvalue;
     apc_param_t   information;
     unsigned int  status;
+    /* VARARG(packets,completion_packets); */
     char __pad_36[4];
 };
 
@@ -5095,6 +5200,56 @@ struct query_completion_reply
 
 
 
+struct create_wait_completion_packet_request
+{
+    struct request_header __header;
+    unsigned int access;
+    /* VARARG(objattr,object_attributes); */
+};
+struct create_wait_completion_packet_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+
+struct associate_wait_completion_packet_request
+{
+    struct request_header __header;
+    obj_handle_t  packet;
+    obj_handle_t  completion;
+    obj_handle_t  handle;
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    char __pad_52[4];
+};
+struct associate_wait_completion_packet_reply
+{
+    struct reply_header __header;
+    int           signaled;
+    char __pad_12[4];
+};
+
+
+
+struct cancel_wait_completion_packet_request
+{
+    struct request_header __header;
+    obj_handle_t  packet;
+    int           remove_signaled;
+    char __pad_20[4];
+};
+struct cancel_wait_completion_packet_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct set_completion_info_request
 {
     struct request_header __header;
@@ -5475,6 +5630,48 @@ struct get_next_thread_reply
 };
 
 
+#define SERVER_STATS_HIST_SIZE 24
+
+
+struct request_stats
+{
+    unsigned int     req;
+    unsigned int     count;
+    unsigned __int64 total_time;
+    unsigned int     time_hist[SERVER_STATS_HIST_SIZE];
+    unsigned int     wait_hist[SERVER_STATS_HIST_SIZE];
+};
+
+
+struct process_stats
+{
+    process_id_t     pid;
+    unsigned int     count;
+    timeout_t        elapsed;
+};
+
+
+struct get_server_stats_request
+{
+    struct request_header __header;
+    unsigned int flags;
+};
+struct get_server_stats_reply
+{
+    struct reply_header __header;
+    int          enabled;
+    char __pad_12[4];
+    timeout_t    elapsed;
+    data_size_t  req_size;
+    /* VARARG(req_stats,request_stats,req_size); */
+    /* VARARG(process_stats,process_stats); */
+    char __pad_28[4];
+};
+#define SERVER_STATS_ENABLE   0x01
+#define SERVER_STATS_DISABLE  0x02
+#define SERVER_STATS_RESET    0x04
+
+
 enum request
 {
     REQ_new_process,
@@ -5520,6 +5717,7 @@ enum request
     REQ_release_semaphore,
     REQ_query_semaphore,
     REQ_open_semaphore,
+    REQ_init_inproc_sync,
     REQ_create_file,
     REQ_open_file_object,
     REQ_alloc_file_handle,
@@ -5587,6 +5785,7 @@ enum request
     REQ_set_queue_fd,
     REQ_set_queue_mask,
     REQ_get_queue_status,
+    REQ_init_queue_shm,
     REQ_get_process_idle_event,
     REQ_send_message,
     REQ_post_quit_message,
@@ -5614,6 +5813,7 @@ enum request
     REQ_destroy_window,
     REQ_get_desktop_window,
     REQ_set_window_owner,
+    REQ_get_window_shm,
     REQ_get_window_info,
     REQ_set_window_info,
     REQ_set_parent,
@@ -5729,6 +5929,9 @@ enum request
     REQ_add_completion,
     REQ_remove_completion,
     REQ_query_completion,
+    REQ_create_wait_completion_packet,
+    REQ_associate_wait_completion_packet,
+    REQ_cancel_wait_completion_packet,
     REQ_set_completion_info,
     REQ_add_fd_completion,
     REQ_set_fd_completion_mode,
@@ -5754,6 +5957,7 @@ enum request
     REQ_suspend_process,
     REQ_resume_process,
     REQ_get_next_thread,
+    REQ_get_server_stats,
     REQ_NB_REQUESTS
 };
 
@@ -5804,6 +6008,7 @@ union generic_request
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
     struct open_semaphore_request open_semaphore_request;
+    struct init_inproc_sync_request init_inproc_sync_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
     struct alloc_file_handle_request alloc_file_handle_request;
@@ -5871,6 +6076,7 @@ union generic_request
     struct set_queue_fd_request set_queue_fd_request;
     struct set_queue_mask_request set_queue_mask_request;
     struct get_queue_status_request get_queue_status_request;
+    struct init_queue_shm_request init_queue_shm_request;
     struct get_process_idle_event_request get_process_idle_event_request;
     struct send_message_request send_message_request;
     struct post_quit_message_request post_quit_message_request;
@@ -5898,6 +6104,7 @@ union generic_request
     struct destroy_window_request destroy_window_request;
     struct get_desktop_window_request get_desktop_window_request;
     struct set_window_owner_request set_window_owner_request;
+    struct get_window_shm_request get_window_shm_request;
     struct get_window_info_request get_window_info_request;
     struct set_window_info_request set_window_info_request;
     struct set_parent_request set_parent_request;
@@ -6013,6 +6220,9 @@ union generic_request
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
     struct query_completion_request query_completion_request;
+    struct create_wait_completion_packet_request create_wait_completion_packet_request;
+    struct associate_wait_completion_packet_request associate_wait_completion_packet_request;
+    struct cancel_wait_completion_packet_request cancel_wait_completion_packet_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
     struct set_fd_completion_mode_request set_fd_completion_mode_request;
@@ -6038,6 +6248,7 @@ union generic_request
     struct suspend_process_request suspend_process_request;
     struct resume_process_request resume_process_request;
     struct get_next_thread_request get_next_thread_request;
+    struct get_server_stats_request get_server_stats_request;
 };
 union generic_reply
 {
@@ -6086,6 +6297,7 @@ union generic_reply
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
     struct open_semaphore_reply open_semaphore_reply;
+    struct init_inproc_sync_reply init_inproc_sync_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
     struct alloc_file_handle_reply alloc_file_handle_reply;
@@ -6153,6 +6365,7 @@ union generic_reply
     struct set_queue_fd_reply set_queue_fd_reply;
     struct set_queue_mask_reply set_queue_mask_reply;
     struct get_queue_status_reply get_queue_status_reply;
+    struct init_queue_shm_reply init_queue_shm_reply;
     struct get_process_idle_event_reply get_process_idle_event_reply;
     struct send_message_reply send_message_reply;
     struct post_quit_message_reply post_quit_message_reply;
@@ -6180,6 +6393,7 @@ union generic_reply
     struct destroy_window_reply destroy_window_reply;
     struct get_desktop_window_reply get_desktop_window_reply;
     struct set_window_owner_reply set_window_owner_reply;
+    struct get_window_shm_reply get_window_shm_reply;
     struct get_window_info_reply get_window_info_reply;
     struct set_window_info_reply set_window_info_reply;
     struct set_parent_reply set_parent_reply;
@@ -6295,6 +6509,9 @@ union generic_reply
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
     struct query_completion_reply query_completion_reply;
+    struct create_wait_completion_packet_reply create_wait_completion_packet_reply;
+    struct associate_wait_completion_packet_reply associate_wait_completion_packet_reply;
+    struct cancel_wait_completion_packet_reply cancel_wait_completion_packet_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
     struct set_fd_completion_mode_reply set_fd_completion_mode_reply;
@@ -6320,11 +6537,12 @@ union generic_reply
     struct suspend_process_reply suspend_process_reply;
     struct resume_process_reply resume_process_reply;
     struct get_next_thread_reply get_next_thread_reply;
+    struct get_server_stats_reply get_server_stats_reply;
 };
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 755
+#define SERVER_PROTOCOL_VERSION 762
 
 /* ### protocol_version end ### */
 
@@ -39,6 +39,7 @@
 #include "object.h"
 #include "file.h"
 #include "handle.h"
+#include "thread.h"
 #include "request.h"
 
 
@@ -98,6 +99,60 @@ struct comp_msg
     apc_param_t   cvalue;
     apc_param_t   information;
     unsigned int  status;
+    struct wait_completion_packet *packet;  /* wait packet that queued the message, if any */
+};
+
+static const WCHAR wait_packet_name[] = {'W','a','i','t','C','o','m','p','l','e','t','i','o','n','P','a','c','k','e','t'};
+
+struct type_descr wait_completion_packet_type =
+{
+    { wait_packet_name, sizeof(wait_packet_name) }, /* name */
+    IO_COMPLETION_ALL_ACCESS,                       /* valid_access */
+    {                                               /* mapping */
+        STANDARD_RIGHTS_READ | IO_COMPLETION_QUERY_STATE,
+        STANDARD_RIGHTS_WRITE | IO_COMPLETION_MODIFY_STATE,
+        STANDARD_RIGHTS_EXECUTE | SYNCHRONIZE,
+        IO_COMPLETION_ALL_ACCESS
+    },
+};
+
+struct wait_completion_packet
+{
+    struct object       obj;
+    struct thread_wait *wait;        /* pending wait on the target object */
+    struct completion  *completion;  /* port the packet is associated with */
+    struct comp_msg    *msg;         /* message queued to the port once signaled */
+    apc_param_t         ckey;
+    apc_param_t         cvalue;
+    apc_param_t         information;
+    unsigned int        status;
+};
+
+static void wait_packet_dump( struct object *obj, int verbose );
+static void wait_packet_destroy( struct object *obj );
+
+static const struct object_ops wait_packet_ops =
+{
+    sizeof(struct wait_completion_packet), /* size */
+    &wait_completion_packet_type,  /* type */
+    wait_packet_dump,          /* dump */
+    no_add_queue,              /* add_queue */
+    NULL,                      /* remove_queue */
+    NULL,                      /* signaled */
+    NULL,                      /* satisfied */
+    no_signal,                 /* signal */
+    no_get_fd,                 /* get_fd */
+    default_map_access,        /* map_access */
+    default_get_sd,            /* get_sd */
+    default_set_sd,            /* set_sd */
+    default_get_full_name,     /* get_full_name */
+    no_lookup_name,            /* lookup_name */
+    directory_link_name,       /* link_name */
+    default_unlink_name,       /* unlink_name */
+    no_open_file,              /* open_file */
+    no_kernel_obj_list,        /* get_kernel_obj_list */
+    no_close_handle,           /* close_handle */
+    wait_packet_destroy        /* destroy */
 };
 
 static void completion_destroy( struct object *obj)
@@ -107,6 +162,7 @@ static void completion_destroy( struct object *obj)
 
     LIST_FOR_EACH_ENTRY_SAFE( tmp, next, &completion->queue, struct comp_msg, queue_entry )
     {
+        assert( !tmp->packet );  /* packets hold a reference to the port while queued */
         free( tmp );
     }
 }
@@ -149,22 +205,107 @@ struct completion *get_completion_obj( struct process *process, obj_handle_t han
     return (struct completion *) get_handle_obj( process, handle, access, &completion_ops );
 }
 
-void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
-                     unsigned int status, apc_param_t information )
+static struct comp_msg *queue_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
+                                          unsigned int status, apc_param_t information,
+                                          struct wait_completion_packet *packet )
 {
     struct comp_msg *msg = mem_alloc( sizeof( *msg ) );
 
     if (!msg)
-        return;
+        return NULL;
 
     msg->ckey = ckey;
     msg->cvalue = cvalue;
     msg->status = status;
     msg->information = information;
+    msg->packet = packet;
 
     list_add_tail( &completion->queue, &msg->queue_entry );
     completion->depth++;
-    wake_up( &completion->obj, 1 );
+    return msg;
+}
+
+void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
+                     unsigned int status, apc_param_t information )
+{
+    if (queue_completion( completion, ckey, cvalue, status, information, NULL ))
+        wake_up( &completion->obj, 1 );
+}
+
+/* detach a dequeued message from its wait packet */
+static void dequeue_completion_msg( struct comp_msg *msg )
+{
+    struct wait_completion_packet *packet = msg->packet;
+
+    if (!packet) return;
+    packet->msg = NULL;
+    release_object( packet->completion );
+    packet->completion = NULL;
+}
+
+static void wait_packet_dump( struct object *obj, int verbose )
+{
+    struct wait_completion_packet *packet = (struct wait_completion_packet *)obj;
+
+    assert( obj->ops == &wait_packet_ops );
+    fprintf( stderr, "WaitCompletionPacket wait=%p queued=%d\n", packet->wait, packet->msg != NULL );
+}
+
+/* called when the object a packet is waiting on gets signaled */
+static void wait_packet_signaled( void *arg, unsigned int status )
+{
+    struct wait_completion_packet *packet = arg;
+    struct completion *completion = packet->completion;
+
+    packet->wait = NULL;
+    if ((packet->msg = queue_completion( completion, packet->ckey, packet->cvalue,
+                                         packet->status, packet->information, packet )))
+    {
+        wake_up( &completion->obj, 1 );
+    }
+    else
+    {
+        release_object( completion );
+        packet->completion = NULL;
+    }
+}
+
+/* cancel a pending wait or queued message, returns 1 if anything was removed */
+static int cancel_wait_packet( struct wait_completion_packet *packet, int remove_signaled )
+{
+    struct completion *completion = packet->completion;
+
+    if (packet->wait)
+    {
+        remove_object_wait( packet->wait );
+        packet->wait = NULL;
+    }
+    else if (packet->msg && remove_signaled)
+    {
+        list_remove( &packet->msg->queue_entry );
+        completion->depth--;
+        free( packet->msg );
+        packet->msg = NULL;
+    }
+    else return 0;
+
+    release_object( completion );
+    packet->completion = NULL;
+    return 1;
+}
+
+static void wait_packet_destroy( struct object *obj )
+{
+    struct wait_completion_packet *packet = (struct wait_completion_packet *)obj;
+
+    assert( obj->ops == &wait_packet_ops );
+    cancel_wait_packet( packet, 1 );
+}
+
+static struct wait_completion_packet *get_wait_packet_obj( struct process *process, obj_handle_t handle,
+                                                           unsigned int access )
+{
+    return (struct wait_completion_packet *)get_handle_obj( process, handle, access, &wait_packet_ops );
 }
 
 /* create a completion */
@@ -213,8 +354,10 @@ DECL_HANDLER(add_completion)
 DECL_HANDLER(remove_completion)
 {
     struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    struct completion_packet *packets;
     struct list *entry;
     struct comp_msg *msg;
+    unsigned int i, count;
 
     if (!completion) return;
 
@@ -230,7 +373,28 @@ DECL_HANDLER(remove_completion)
         reply->cvalue = msg->cvalue;
         reply->status = msg->status;
         reply->information = msg->information;
+        dequeue_completion_msg( msg );
         free( msg );
+
+        /* dequeue as many of the following packets as the client has room for */
+        count = min( completion->depth, get_reply_max_size() / sizeof(*packets) );
+        if (count && (packets = set_reply_data_size( count * sizeof(*packets) )))
+        {
+            for (i = 0; i < count; i++)
+            {
+                entry = list_head( &completion->queue );
+                list_remove( entry );
+                completion->depth--;
+                msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
+                packets[i].ckey        = msg->ckey;
+                packets[i].cvalue      = msg->cvalue;
+                packets[i].information = msg->information;
+                packets[i].status      = msg->status;
+                packets[i].__pad       = 0;
+                dequeue_completion_msg( msg );
+                free( msg );
+            }
+        }
     }
 
     release_object( completion );
@@ -247,3 +411,88 @@ DECL_HANDLER(query_completion)
 
     release_object( completion );
 }
+
+/* create a wait completion packet */
+DECL_HANDLER(create_wait_completion_packet)
+{
+    struct wait_completion_packet *packet;
+    struct unicode_str name;
+    struct object *root;
+    const struct security_descriptor *sd;
+    const struct object_attributes *objattr = get_req_object_attributes( &sd, &name, &root );
+
+    if (!objattr) return;
+
+    if ((packet = create_named_object( root, &wait_packet_ops, &name, objattr->attributes, sd )))
+    {
+        if (get_error() != STATUS_OBJECT_NAME_EXISTS)
+        {
+            packet->wait = NULL;
+            packet->completion = NULL;
+            packet->msg = NULL;
+        }
+        reply->handle = alloc_handle( current->process, packet, req->access, objattr->attributes );
+        release_object( packet );
+    }
+
+    if (root) release_object( root );
+}
+
+/* queue a wait completion packet to a port once an object is signaled */
+DECL_HANDLER(associate_wait_completion_packet)
+{
+    struct wait_completion_packet *packet;
+    struct completion *completion;
+    struct object *obj;
+
+    if (!(packet = get_wait_packet_obj( current->process, req->packet, IO_COMPLETION_MODIFY_STATE ))) return;
+
+    if (packet->wait || packet->msg)
+    {
+        set_error( STATUS_INVALID_PARAMETER_1 );
+        release_object( packet );
+        return;
+    }
+    if (!(completion = get_completion_obj( current->process, req->completion, IO_COMPLETION_MODIFY_STATE )))
+    {
+        release_object( packet );
+        return;
+    }
+    if (!(obj = get_handle_obj( current->process, req->handle, SYNCHRONIZE, NULL )))
+    {
+        release_object( completion );
+        release_object( packet );
+        return;
+    }
+
+    packet->ckey        = req->ckey;
+    packet->cvalue      = req->cvalue;
+    packet->information = req->information;
+    packet->status      = req->status;
+    packet->completion  = completion;  /* reference is held until the packet is dequeued or cancelled */
+
+    if (!(packet->wait = add_object_wait( current, obj, wait_packet_signaled, packet )))
+    {
+        if (!get_error()) set_error( STATUS_OBJECT_TYPE_MISMATCH );
+        packet->completion = NULL;
+        release_object( completion );
+    }
+    else reply->signaled = check_object_wait( packet->wait );
+
+    release_object( obj );
+    release_object( packet );
+}
+
+/* cancel the wait of a wait completion packet */
+DECL_HANDLER(cancel_wait_completion_packet)
+{
+    struct wait_completion_packet *packet;
+
+    if (!(packet = get_wait_packet_obj( current->process, req->packet, IO_COMPLETION_MODIFY_STATE ))) return;
+
+    if (cancel_wait_packet( packet, req->remove_signaled )) set_error( STATUS_SUCCESS );
+    else if (packet->msg) set_error( STATUS_PENDING );
+    else set_error( STATUS_CANCELLED );
+
+    release_object( packet );
+}
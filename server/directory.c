@@ -161,6 +161,7 @@ static struct type_descr *types[] =
     &file_type,
     &mapping_type,
     &key_type,
+    &wait_completion_packet_type,
 };
 
 static void object_type_dump( struct object *obj, int verbose )
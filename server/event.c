@@ -56,6 +56,7 @@ struct event
     struct list    kernel_object;   /* list of kernel object pointers */
     int            manual_reset;    /* is it a manual reset event? */
     int            signaled;        /* event has been signaled */
+    struct inproc_sync inproc;      /* in-process synchronization slot */
 };
 
 static void event_dump( struct object *obj, int verbose );
@@ -63,6 +64,7 @@ static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int event_signal( struct object *obj, unsigned int access);
 static struct list *event_get_kernel_obj_list( struct object *obj );
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
@@ -85,7 +87,7 @@ static const struct object_ops event_ops =
     no_open_file,              /* open_file */
     event_get_kernel_obj_list, /* get_kernel_obj_list */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -150,6 +152,9 @@ struct event *create_event( struct object *root, const struct unicode_str *name,
             list_init( &event->kernel_object );
             event->manual_reset = manual_reset;
             event->signaled     = initial_state;
+            event->inproc.page  = NULL;
+            event->inproc.index = 0;
+            event->inproc.detached = 0;
         }
     }
     return event;
@@ -160,8 +165,17 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
     return (struct event *)get_handle_obj( process, handle, access, &event_ops );
 }
 
+/* take over the state of the event from its in-process slot */
+static void event_detach( struct event *event )
+{
+    __int64 value;
+
+    if (inproc_sync_detach( &event->inproc, &value )) event->signaled = (value != 0);
+}
+
 static void pulse_event( struct event *event )
 {
+    event_detach( event );
     event->signaled = 1;
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
@@ -170,6 +184,7 @@ static void pulse_event( struct event *event )
 
 void set_event( struct event *event )
 {
+    event_detach( event );
     event->signaled = 1;
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
@@ -177,21 +192,29 @@ void set_event( struct event *event )
 
 void reset_event( struct event *event )
 {
+    event_detach( event );
     event->signaled = 0;
 }
 
 static void event_dump( struct object *obj, int verbose )
 {
     struct event *event = (struct event *)obj;
+    __int64 value;
+
     assert( obj->ops == &event_ops );
-    fprintf( stderr, "Event manual=%d signaled=%d\n",
-             event->manual_reset, event->signaled );
+    if (inproc_sync_peek( &event->inproc, &value ))
+        fprintf( stderr, "Event manual=%d signaled=%d inproc=%u\n",
+                 event->manual_reset, value != 0, event->inproc.index );
+    else
+        fprintf( stderr, "Event manual=%d signaled=%d\n",
+                 event->manual_reset, event->signaled );
 }
 
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
+    event_detach( event );
     return event->signaled;
 }
 
@@ -199,6 +222,7 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
+    event_detach( event );
     /* Reset if it's an auto-reset event */
     if (!event->manual_reset) event->signaled = 0;
 }
@@ -223,6 +247,13 @@ static struct list *event_get_kernel_obj_list( struct object *obj )
     return &event->kernel_object;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    inproc_sync_free( &event->inproc );
+}
+
 struct keyed_event *create_keyed_event( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -293,8 +324,16 @@ DECL_HANDLER(create_event)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, event, req->access, objattr->attributes );
         else
+        {
+            /* only private objects with full access can be handled by the client */
+            int inproc = req->inproc && !name.len && !root && !(objattr->attributes & OBJ_INHERIT) &&
+                         (map_access( req->access, &event_type.mapping ) & EVENT_ALL_ACCESS) == EVENT_ALL_ACCESS &&
+                         inproc_sync_alloc( &event->inproc, INPROC_SYNC_EVENT, event->signaled, event->manual_reset );
+
             reply->handle = alloc_handle_no_access_check( current->process, event,
                                                           req->access, objattr->attributes );
+            if (reply->handle && inproc) reply->inproc_index = event->inproc.index;
+        }
         release_object( event );
     }
 
@@ -316,6 +355,7 @@ DECL_HANDLER(event_op)
     struct event *event;
 
     if (!(event = get_event_obj( current->process, req->handle, EVENT_MODIFY_STATE ))) return;
+    event_detach( event );
     reply->state = event->signaled;
     switch(req->op)
     {
@@ -341,6 +381,7 @@ DECL_HANDLER(query_event)
     struct event *event;
 
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
+    event_detach( event );
 
     reply->manual_reset = event->manual_reset;
     reply->state = event->signaled;
@@ -0,0 +1,219 @@
+/*
+ * Server-side support for in-process synchronization objects
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Unnamed events, mutexes and semaphores created by a process that asked for
+ * it get a slot in a shared memory block provided by that process. As long as
+ * the object is only used through the handle returned on creation, the client
+ * manipulates its state directly with atomic operations and waits on it with
+ * futexes. As soon as the server needs to know about the state of the object
+ * (server-side wait, use by another process or through another handle, thread
+ * termination, etc.), the object is detached from its slot, and from then on
+ * it's entirely managed by the server as any other object.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "handle.h"
+#include "process.h"
+#include "thread.h"
+#include "request.h"
+
+struct inproc_sync_page
+{
+    unsigned int             refcount;  /* number of users of the page (process and allocated slots) */
+    struct inproc_sync_slot *slots;     /* shared memory mapping */
+    unsigned int             count;     /* number of slots in the mapping */
+    unsigned int            *free;      /* stack of free slot indices */
+    unsigned int             free_count;
+    unsigned int             next;      /* next never used slot index */
+};
+
+static void release_page( struct inproc_sync_page *page )
+{
+    if (--page->refcount) return;
+    munmap( page->slots, page->count * sizeof(*page->slots) );
+    free( page->free );
+    free( page );
+}
+
+static void wake_slot( struct inproc_sync_slot *slot )
+{
+    __atomic_add_fetch( &slot->seq, 1, __ATOMIC_SEQ_CST );
+#if defined(__linux__) && defined(__NR_futex)
+    syscall( __NR_futex, &slot->seq, 1 /* FUTEX_WAKE */, INT_MAX, NULL, 0, 0 );
+#endif
+}
+
+/* allocate a slot for a newly created object of the current process */
+int inproc_sync_alloc( struct inproc_sync *sync, enum inproc_sync_type type, __int64 value, unsigned int max )
+{
+    struct inproc_sync_page *page = current->process->inproc_sync;
+    struct inproc_sync_slot *slot;
+    unsigned int index;
+
+    sync->page = NULL;
+    sync->index = 0;
+    sync->detached = 0;
+
+    if (!page) return 0;
+    if (page->free_count) index = page->free[--page->free_count];
+    else if (page->next < page->count) index = page->next++;
+    else return 0;
+
+    slot = &page->slots[index];
+    slot->type = type;
+    slot->max = max;
+    slot->waiters = 0;
+    __atomic_add_fetch( &slot->generation, 1, __ATOMIC_SEQ_CST );
+    __atomic_store_n( &slot->value, value, __ATOMIC_SEQ_CST );
+
+    page->refcount++;
+    sync->page = page;
+    sync->index = index;
+    return 1;
+}
+
+/* take over the state of the object from the client, returns 0 if already done */
+int inproc_sync_detach( struct inproc_sync *sync, __int64 *value )
+{
+    struct inproc_sync_slot *slot;
+    __int64 old;
+
+    if (!sync->page || sync->detached) return 0;
+
+    slot = &sync->page->slots[sync->index];
+    old = __atomic_load_n( &slot->value, __ATOMIC_SEQ_CST );
+    while (!(old & INPROC_SYNC_DETACHED))
+    {
+        if (__atomic_compare_exchange_n( &slot->value, &old, old | INPROC_SYNC_DETACHED,
+                                         0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+            break;
+    }
+    /* wake client waiters so that they restart their wait through the server */
+    wake_slot( slot );
+
+    *value = old & ~INPROC_SYNC_DETACHED;
+    sync->detached = 1;
+    return 1;
+}
+
+/* read the client-side state of an attached object, returns 0 if detached */
+int inproc_sync_peek( const struct inproc_sync *sync, __int64 *value )
+{
+    __int64 old;
+
+    if (!sync->page || sync->detached) return 0;
+    old = __atomic_load_n( &sync->page->slots[sync->index].value, __ATOMIC_SEQ_CST );
+    if (old & INPROC_SYNC_DETACHED) return 0;
+    *value = old;
+    return 1;
+}
+
+/* check whether an object is still attached to the slots of the given process */
+int inproc_sync_is_attached( const struct inproc_sync *sync, struct process *process )
+{
+    return sync->page && !sync->detached && sync->page == process->inproc_sync;
+}
+
+/* release the slot of a destroyed object */
+void inproc_sync_free( struct inproc_sync *sync )
+{
+    struct inproc_sync_page *page = sync->page;
+    struct inproc_sync_slot *slot;
+
+    if (!page) return;
+
+    slot = &page->slots[sync->index];
+    __atomic_store_n( &slot->value, INPROC_SYNC_DETACHED, __ATOMIC_SEQ_CST );
+    __atomic_add_fetch( &slot->generation, 1, __ATOMIC_SEQ_CST );
+    slot->type = INPROC_SYNC_NONE;
+    wake_slot( slot );
+
+    page->free[page->free_count++] = sync->index;
+    sync->page = NULL;
+    sync->index = 0;
+    release_page( page );
+}
+
+/* release the process reference to its page */
+void inproc_sync_release_process( struct process *process )
+{
+    if (!process->inproc_sync) return;
+    release_page( process->inproc_sync );
+    process->inproc_sync = NULL;
+}
+
+/* provide the shared memory used for in-process synchronization objects */
+DECL_HANDLER(init_inproc_sync)
+{
+    struct inproc_sync_page *page;
+    data_size_t size = req->count * sizeof(struct inproc_sync_slot);
+    void *ptr;
+    int fd;
+
+    if ((fd = thread_get_inflight_fd( current, req->fd )) == -1)
+    {
+        set_error( STATUS_INVALID_HANDLE );
+        return;
+    }
+
+    if (current->process->inproc_sync) set_error( STATUS_ACCESS_DENIED );
+    else if (!req->count || req->count > INPROC_SYNC_MAX_SLOTS) set_error( STATUS_INVALID_PARAMETER );
+    else if ((ptr = map_client_shared_memory( fd, size )))
+    {
+        if (!(page = mem_alloc( sizeof(*page) )))
+            munmap( ptr, size );
+        else if (!(page->free = mem_alloc( req->count * sizeof(*page->free) )))
+        {
+            free( page );
+            munmap( ptr, size );
+        }
+        else
+        {
+            page->refcount   = 1;
+            page->slots      = ptr;
+            page->count      = req->count;
+            page->free_count = 0;
+            page->next       = 1;  /* index 0 is never used */
+            current->process->inproc_sync = page;
+        }
+    }
+    close( fd );
+}
@@ -262,6 +262,28 @@ int grow_file( int unix_fd, file_pos_t new_size )
     return 0;
 }
 
+/* map shared memory provided by a client, which must be sealed against shrinking */
+void *map_client_shared_memory( int unix_fd, data_size_t size )
+{
+#ifdef F_GET_SEALS
+    int seals = fcntl( unix_fd, F_GET_SEALS );
+    struct stat st;
+    void *ptr;
+
+    if (seals == -1 || !(seals & F_SEAL_SHRINK) || fstat( unix_fd, &st ) == -1 || st.st_size < size)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return NULL;
+    }
+    if ((ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, unix_fd, 0 )) != MAP_FAILED)
+        return ptr;
+    file_set_error();
+#else
+    set_error( STATUS_NOT_SUPPORTED );
+#endif
+    return NULL;
+}
+
 /* simplified version of mkstemps() */
 static int make_temp_file( char name[16] )
 {
@@ -297,7 +319,7 @@ static int check_current_dir_for_exec(void)
 }
 
 /* create a temp file for anonymous mappings */
-static int create_temp_file( file_pos_t size )
+int create_temp_file( file_pos_t size )
 {
     static int temp_dir_fd = -1;
     char tmpfn[16];
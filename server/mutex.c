@@ -32,6 +32,7 @@
 #include "winternl.h"
 
 #include "handle.h"
+#include "process.h"
 #include "thread.h"
 #include "request.h"
 #include "security.h"
@@ -57,8 +58,13 @@ struct mutex
     unsigned int   count;           /* recursion count */
     int            abandoned;       /* has it been abandoned? */
     struct list    entry;           /* entry in owner thread mutex list */
+    struct inproc_sync inproc;      /* in-process synchronization slot */
+    struct list    inproc_entry;    /* entry in inproc_mutexes list while attached */
 };
 
+/* mutexes whose state is currently managed by the client */
+static struct list inproc_mutexes = LIST_INIT( inproc_mutexes );
+
 static void mutex_dump( struct object *obj, int verbose );
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry );
@@ -113,6 +119,31 @@ static void do_release( struct mutex *mutex )
     wake_up( &mutex->obj, 0 );
 }
 
+/* take over the state of the mutex from its in-process slot */
+static void mutex_detach( struct mutex *mutex )
+{
+    struct thread *owner;
+    unsigned int count;
+    __int64 value;
+
+    if (!inproc_sync_detach( &mutex->inproc, &value )) return;
+    list_remove( &mutex->inproc_entry );
+    list_init( &mutex->inproc_entry );
+
+    if (!(count = (value >> 32) & 0x7fffffff)) return;
+    if (!(owner = get_thread_from_id( (unsigned int)value ))) mutex->abandoned = 1;
+    else
+    {
+        if (owner->state == TERMINATED) mutex->abandoned = 1;
+        else
+        {
+            do_grab( mutex, owner );
+            mutex->count = count;
+        }
+        release_object( owner );
+    }
+}
+
 static struct mutex *create_mutex( struct object *root, const struct unicode_str *name,
                                    unsigned int attr, int owned, const struct security_descriptor *sd )
 {
@@ -126,6 +157,10 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
             mutex->count = 0;
             mutex->owner = NULL;
             mutex->abandoned = 0;
+            mutex->inproc.page = NULL;
+            mutex->inproc.index = 0;
+            mutex->inproc.detached = 0;
+            list_init( &mutex->inproc_entry );
             if (owned) do_grab( mutex, current );
         }
     }
@@ -134,7 +169,19 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
 
 void abandon_mutexes( struct thread *thread )
 {
+    struct mutex *mutex, *next;
     struct list *ptr;
+    __int64 value;
+
+    if (thread->process->inproc_sync)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( mutex, next, &inproc_mutexes, struct mutex, inproc_entry )
+        {
+            if (!inproc_sync_is_attached( &mutex->inproc, thread->process )) continue;
+            if (!inproc_sync_peek( &mutex->inproc, &value )) continue;
+            if ((unsigned int)value == thread->id && (value >> 32)) mutex_detach( mutex );
+        }
+    }
 
     while ((ptr = list_head( &thread->mutex_list )) != NULL)
     {
@@ -149,14 +196,21 @@ void abandon_mutexes( struct thread *thread )
 static void mutex_dump( struct object *obj, int verbose )
 {
     struct mutex *mutex = (struct mutex *)obj;
+    __int64 value;
+
     assert( obj->ops == &mutex_ops );
-    fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
+    if (inproc_sync_peek( &mutex->inproc, &value ))
+        fprintf( stderr, "Mutex count=%u owner=%04x inproc=%u\n",
+                 (unsigned int)(value >> 32), (unsigned int)value, mutex->inproc.index );
+    else
+        fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
 }
 
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
+    mutex_detach( mutex );
     return (!mutex->count || (mutex->owner == get_wait_queue_thread( entry )));
 }
 
@@ -165,6 +219,7 @@ static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    mutex_detach( mutex );
     do_grab( mutex, get_wait_queue_thread( entry ));
     if (mutex->abandoned) make_wait_abandoned( entry );
     mutex->abandoned = 0;
@@ -180,6 +235,7 @@ static int mutex_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
+    mutex_detach( mutex );
     if (!mutex->count || (mutex->owner != current))
     {
         set_error( STATUS_MUTANT_NOT_OWNED );
@@ -194,6 +250,8 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    list_remove( &mutex->inproc_entry );
+    inproc_sync_free( &mutex->inproc );
     if (!mutex->count) return;
     mutex->count = 0;
     do_release( mutex );
@@ -207,16 +265,32 @@ DECL_HANDLER(create_mutex)
     struct object *root;
     const struct security_descriptor *sd;
     const struct object_attributes *objattr = get_req_object_attributes( &sd, &name, &root );
+    int inproc;
 
     if (!objattr) return;
 
-    if ((mutex = create_mutex( root, &name, objattr->attributes, req->owned, sd )))
+    /* only private objects with full access can be handled by the client */
+    inproc = req->inproc && !name.len && !root && !(objattr->attributes & OBJ_INHERIT) &&
+             (map_access( req->access, &mutex_type.mapping ) & MUTANT_ALL_ACCESS) == MUTANT_ALL_ACCESS;
+
+    if ((mutex = create_mutex( root, &name, objattr->attributes, req->owned && !inproc, sd )))
     {
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, mutex, req->access, objattr->attributes );
         else
+        {
+            if (inproc && inproc_sync_alloc( &mutex->inproc, INPROC_SYNC_MUTEX,
+                                             req->owned ? current->id | ((__int64)1 << 32) : 0, 0 ))
+                list_add_tail( &inproc_mutexes, &mutex->inproc_entry );
+            else
+            {
+                if (req->owned && inproc) do_grab( mutex, current );
+                inproc = 0;
+            }
             reply->handle = alloc_handle_no_access_check( current->process, mutex,
                                                           req->access, objattr->attributes );
+            if (reply->handle && inproc) reply->inproc_index = mutex->inproc.index;
+        }
         release_object( mutex );
     }
 
@@ -240,6 +314,7 @@ DECL_HANDLER(release_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  0, &mutex_ops )))
     {
+        mutex_detach( mutex );
         if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
         else
         {
@@ -258,6 +333,7 @@ DECL_HANDLER(query_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  MUTANT_QUERY_STATE, &mutex_ops )))
     {
+        mutex_detach( mutex );
         reply->count = mutex->count;
         reply->owned = (mutex->owner == current);
         reply->abandoned = mutex->abandoned;
@@ -219,6 +219,24 @@ extern void reset_event( struct event *event );
 
 extern void abandon_mutexes( struct thread *thread );
 
+/* in-process synchronization functions */
+
+struct inproc_sync_page;
+
+struct inproc_sync
+{
+    struct inproc_sync_page *page;      /* shared memory of the creating process */
+    unsigned int             index;     /* index of the object slot */
+    int                      detached;  /* object state has been taken over by the server */
+};
+
+extern int inproc_sync_alloc( struct inproc_sync *sync, enum inproc_sync_type type, __int64 value, unsigned int max );
+extern int inproc_sync_detach( struct inproc_sync *sync, __int64 *value );
+extern int inproc_sync_peek( const struct inproc_sync *sync, __int64 *value );
+extern int inproc_sync_is_attached( const struct inproc_sync *sync, struct process *process );
+extern void inproc_sync_free( struct inproc_sync *sync );
+extern void inproc_sync_release_process( struct process *process );
+
 /* serial functions */
 
 int get_serial_async_timeout(struct object *obj, int type, int count);
@@ -318,6 +336,7 @@ extern struct type_descr winstation_type;
 extern struct type_descr desktop_type;
 extern struct type_descr device_type;
 extern struct type_descr completion_type;
+extern struct type_descr wait_completion_packet_type;
 extern struct type_descr file_type;
 extern struct type_descr mapping_type;
 extern struct type_descr key_type;
@@ -674,6 +674,8 @@ struct process *create_process( int fd, struct process *parent, unsigned int fla
     process->peb             = 0;
     process->ldt_copy        = 0;
     process->dir_cache       = NULL;
+    process->inproc_sync     = NULL;
+    process->req_count       = 0;
     process->winstation      = 0;
     process->desktop         = 0;
     process->token           = NULL;
@@ -786,6 +788,7 @@ static void process_destroy( struct object *obj )
     free( process->rawinput_devices );
     free( process->dir_cache );
     free( process->image );
+    inproc_sync_release_process( process );
 }
 
 /* dump a process on stdout for debugging purposes */
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <poll.h>
+#include <sys/mman.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -141,6 +142,7 @@ struct msg_queue
     struct hook_table     *hooks;           /* hook table */
     timeout_t              last_get_msg;    /* time of last get message call */
     int                    keystate_lock;   /* owns an input keystate lock */
+    struct queue_shm      *shm;             /* status shared with the client */
 };
 
 struct hotkey
@@ -309,6 +311,7 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->hooks           = NULL;
         queue->last_get_msg    = current_time;
         queue->keystate_lock   = 0;
+        queue->shm             = NULL;
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
@@ -506,6 +509,18 @@ static inline int is_signaled( struct msg_queue *queue )
     return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
 }
 
+/* publish the queue bits to the client */
+static void update_queue_shm( struct msg_queue *queue )
+{
+    struct queue_shm *shm = queue->shm;
+
+    if (!shm) return;
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+    shm->wake_bits    = queue->wake_bits;
+    shm->changed_bits = queue->changed_bits;
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+}
+
 /* set some queue bits */
 static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
@@ -516,6 +531,7 @@ static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
     }
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    update_queue_shm( queue );
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -524,6 +540,7 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
 {
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
+    update_queue_shm( queue );
     if (!(queue->wake_bits & (QS_KEY | QS_MOUSEBUTTON)))
     {
         if (queue->keystate_lock) unlock_input_keystate( queue->input );
@@ -1077,6 +1094,7 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    if (queue->shm) munmap( queue->shm, sizeof(*queue->shm) );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -2461,11 +2479,33 @@ DECL_HANDLER(get_queue_status)
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
+        update_queue_shm( queue );
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
 
 
+/* provide the shared memory for the queue status */
+DECL_HANDLER(init_queue_shm)
+{
+    struct msg_queue *queue;
+    struct file *file;
+
+    if (!(file = get_file_obj( current->process, req->handle, FILE_READ_DATA | FILE_WRITE_DATA ))) return;
+
+    if ((queue = get_current_queue()))
+    {
+        if (queue->shm) set_error( STATUS_ACCESS_DENIED );
+        else if ((queue->shm = map_client_shared_memory( get_file_unix_fd( file ), sizeof(*queue->shm) )))
+        {
+            queue->shm->seq = 0;
+            update_queue_shm( queue );
+        }
+    }
+    release_object( file );
+}
+
+
 /* send a message to a thread queue */
 DECL_HANDLER(send_message)
 {
@@ -2643,6 +2683,7 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_queue_shm( queue );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
@@ -82,11 +83,15 @@ struct key
     data_size_t       classlen;    /* length of class name */
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
+    int               subkey_gap;  /* count of unused entries allocated before the subkeys array */
     struct key      **subkeys;     /* subkeys array */
+    struct name_hash *subkey_hash; /* hash index of the subkeys for keys with many subkeys */
     struct key       *wow6432node; /* Wow6432Node subkey */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
+    int               value_gap;   /* count of unused entries allocated before the values array */
     struct key_value *values;      /* values array */
+    struct name_hash *value_hash;  /* hash index of the values for keys with many values */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
@@ -114,6 +119,22 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_HASHED   64  /* min. number of subkeys or values to create a hash index */
+
+/* hash index of the subkey or value names of a key */
+/* new entries are appended to the array, which is only sorted when needed */
+/* entries are stored by position in the allocated array, which includes the gap before the first entry */
+struct name_hash
+{
+    unsigned int      size;    /* number of slots, a power of 2 */
+    unsigned int      count;   /* number of used slots */
+    int               sorted;  /* whether the indexed array is sorted */
+    struct name_hash_slot
+    {
+        unsigned int  hash;    /* hash of the name */
+        int           index;   /* position in the allocated array, -1 if the slot is free */
+    } slots[1];
+};
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -138,12 +159,30 @@ struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    char        *journal_path; /* path of the journal of changes since the last save */
+    char        *old_journal_path; /* path of the journal of changes saved in the background */
+    FILE        *journal;      /* journal file, NULL if not open */
+    struct key  *last_key;     /* key of the last journal record */
+    timeout_t    last_modif;   /* modification time of the key at the last journal record */
+    off_t        save_size;    /* size of the branch file at the last save */
+    int          full_save;    /* the branch has changes that are not in the journal */
+    int          old_journal;  /* the old journal file exists */
+    int          background_save; /* the branch is being saved in the background */
 };
 
+/* the journal is merged into the branch file once it grows larger than the file itself */
+#define MIN_JOURNAL_COMPACT_SIZE (1024 * 1024)
+
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
 
+#ifdef USE_PTRACE
+/* on platforms where the process tracing code reaps all the child processes, full saves
+ * are done in a child process, and we get its result through a pipe */
+static int background_save_fd = -1;
+#endif
+
 unsigned int supported_machines_count = 0;
 unsigned short supported_machines[8];
 unsigned short native_machine = 0;
@@ -152,6 +191,7 @@ unsigned short native_machine = 0;
 struct file_load_info
 {
     const char *filename; /* input file name */
+    int         journal;  /* loading a journal file */
     FILE       *file;     /* input file */
     char       *buffer;   /* line buffer */
     int         len;      /* buffer length */
@@ -285,12 +325,183 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
+/* compute the case-insensitive hash of a name */
+static inline unsigned int get_name_hash( const WCHAR *name, data_size_t len )
+{
+    return hash_strW( name, len, ~0u );
+}
+
+/* allocate an empty hash index large enough for count entries */
+static struct name_hash *alloc_name_hash( unsigned int count )
+{
+    struct name_hash *hash;
+    unsigned int i, size = 2 * MIN_HASHED;
+
+    while (size < 2 * count) size *= 2;
+    if (!(hash = malloc( offsetof( struct name_hash, slots[size] )))) return NULL;
+    hash->size   = size;
+    hash->count  = 0;
+    hash->sorted = 1;
+    for (i = 0; i < size; i++) hash->slots[i].index = -1;
+    return hash;
+}
+
+/* add an entry to a hash index, which must have a free slot */
+static void name_hash_add( struct name_hash *hash, unsigned int name_hash, int index )
+{
+    unsigned int i = name_hash & (hash->size - 1);
+
+    while (hash->slots[i].index != -1) i = (i + 1) & (hash->size - 1);
+    hash->slots[i].hash  = name_hash;
+    hash->slots[i].index = index;
+    hash->count++;
+}
+
+/* make sure a hash index can hold one more entry, keeping it at most half full */
+static int grow_name_hash( struct name_hash **hash_ptr )
+{
+    struct name_hash *new_hash, *hash = *hash_ptr;
+    unsigned int i;
+
+    if (2 * (hash->count + 1) <= hash->size) return 1;
+    if (!(new_hash = alloc_name_hash( hash->size ))) return 0;
+    for (i = 0; i < hash->size; i++)
+        if (hash->slots[i].index != -1) name_hash_add( new_hash, hash->slots[i].hash, hash->slots[i].index );
+    new_hash->sorted = hash->sorted;
+    free( hash );
+    *hash_ptr = new_hash;
+    return 1;
+}
+
+/* remove the entry of an array position from a hash index */
+static void name_hash_remove( struct name_hash *hash, unsigned int name_hash, int index )
+{
+    unsigned int i = name_hash & (hash->size - 1), j, home;
+
+    while (hash->slots[i].index != index) i = (i + 1) & (hash->size - 1);
+
+    /* move back the following entries of the probe sequence */
+    for (j = (i + 1) & (hash->size - 1); hash->slots[j].index != -1; j = (j + 1) & (hash->size - 1))
+    {
+        home = hash->slots[j].hash & (hash->size - 1);
+        if (((j - home) & (hash->size - 1)) < ((j - i) & (hash->size - 1))) continue;
+        hash->slots[i] = hash->slots[j];
+        i = j;
+    }
+    hash->slots[i].index = -1;
+    hash->count--;
+}
+
+/* update the array position of an entry that has been moved */
+static void name_hash_move( struct name_hash *hash, unsigned int name_hash, int old_index, int new_index )
+{
+    unsigned int i = name_hash & (hash->size - 1);
+
+    while (hash->slots[i].index != old_index) i = (i + 1) & (hash->size - 1);
+    hash->slots[i].index = new_index;
+}
+
+/* update the array positions of all the entries after the array has been moved by offset entries */
+static void name_hash_rebase( struct name_hash *hash, int offset )
+{
+    unsigned int i;
+
+    for (i = 0; i < hash->size; i++) if (hash->slots[i].index != -1) hash->slots[i].index += offset;
+}
+
+/* compare two names the same way as the sorted subkeys and values arrays */
+static int compare_names( const WCHAR *name1, data_size_t len1, const WCHAR *name2, data_size_t len2 )
+{
+    int res = memicmp_strW( name1, name2, min( len1, len2 ));
+    if (!res) res = len1 - len2;
+    return res;
+}
+
+static int compare_subkeys( const void *p1, const void *p2 )
+{
+    const struct key *key1 = *(const struct key * const *)p1;
+    const struct key *key2 = *(const struct key * const *)p2;
+    return compare_names( key1->obj.name->name, key1->obj.name->len, key2->obj.name->name, key2->obj.name->len );
+}
+
+static int compare_values( const void *p1, const void *p2 )
+{
+    const struct key_value *value1 = p1;
+    const struct key_value *value2 = p2;
+    return compare_names( value1->name, value1->namelen, value2->name, value2->namelen );
+}
+
+/* build the hash index of the subkeys of a key */
+static void hash_subkeys( struct key *key )
+{
+    struct object_name *name;
+    int i;
+
+    if (key->subkey_hash) key->subkey_hash->count = 0;
+    else if (!(key->subkey_hash = alloc_name_hash( key->last_subkey + 1 ))) return;
+    for (i = 0; i < key->subkey_hash->size; i++) key->subkey_hash->slots[i].index = -1;
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        name = key->subkeys[i]->obj.name;
+        name_hash_add( key->subkey_hash, get_name_hash( name->name, name->len ), key->subkey_gap + i );
+    }
+}
+
+/* build the hash index of the values of a key */
+static void hash_values( struct key *key )
+{
+    int i;
+
+    if (key->value_hash) key->value_hash->count = 0;
+    else if (!(key->value_hash = alloc_name_hash( key->last_value + 1 ))) return;
+    for (i = 0; i < key->value_hash->size; i++) key->value_hash->slots[i].index = -1;
+    for (i = 0; i <= key->last_value; i++)
+        name_hash_add( key->value_hash, get_name_hash( key->values[i].name, key->values[i].namelen ),
+                       key->value_gap + i );
+}
+
+/* sort the subkeys array of a key if entries have been appended to it */
+static void sort_subkeys( struct key *key )
+{
+    if (!key->subkey_hash || key->subkey_hash->sorted) return;
+    qsort( key->subkeys, key->last_subkey + 1, sizeof(*key->subkeys), compare_subkeys );
+    hash_subkeys( key );
+    key->subkey_hash->sorted = 1;
+}
+
+/* sort the values array of a key if entries have been appended to it */
+static void sort_values( struct key *key )
+{
+    if (!key->value_hash || key->value_hash->sorted) return;
+    qsort( key->values, key->last_value + 1, sizeof(*key->values), compare_values );
+    hash_values( key );
+    key->value_hash->sorted = 1;
+}
+
 /* find the named child of a given key and return its index */
 static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_hash)
+    {
+        const struct name_hash *hash = key->subkey_hash;
+        unsigned int name_hash = get_name_hash( name->str, name->len );
+        const struct object_name *subkey_name;
+
+        for (i = name_hash & (hash->size - 1); hash->slots[i].index != -1; i = (i + 1) & (hash->size - 1))
+        {
+            if (hash->slots[i].hash != name_hash) continue;
+            subkey_name = key->subkeys[hash->slots[i].index - key->subkey_gap]->obj.name;
+            if (compare_names( subkey_name->name, subkey_name->len, name->str, name->len )) continue;
+            *index = hash->slots[i].index - key->subkey_gap;
+            return key->subkeys[*index];
+        }
+        *index = key->last_subkey + 1;  /* new subkeys are appended */
+        return NULL;
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -311,16 +522,37 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     return NULL;
 }
 
-/* try to grow the array of subkeys; return 1 if OK, 0 on error */
+/* move the subkeys to the start of the allocated array */
+static void compact_subkeys( struct key *key )
+{
+    struct key **base = key->subkeys - key->subkey_gap;
+
+    if (!key->subkey_gap) return;
+    memmove( base, key->subkeys, (key->last_subkey + 1) * sizeof(*base) );
+    if (key->subkey_hash) name_hash_rebase( key->subkey_hash, -key->subkey_gap );
+    key->subkeys    = base;
+    key->subkey_gap = 0;
+}
+
+/* make room for one more subkey at the end of the array; return 1 if OK, 0 on error */
 static int grow_subkeys( struct key *key )
 {
     struct key **new_subkeys;
     int nb_subkeys;
 
+    if (key->subkey_gap + key->last_subkey + 1 < key->nb_subkeys) return 1;
+
+    /* reuse the space left by subkeys removed from the start if there is enough of it */
+    if (key->subkey_gap && key->subkey_gap >= (key->last_subkey + 1) / 2)
+    {
+        compact_subkeys( key );
+        return 1;
+    }
+
     if (key->nb_subkeys)
     {
         nb_subkeys = key->nb_subkeys + (key->nb_subkeys / 2);  /* grow by 50% */
-        if (!(new_subkeys = realloc( key->subkeys, nb_subkeys * sizeof(*new_subkeys) )))
+        if (!(new_subkeys = realloc( key->subkeys - key->subkey_gap, nb_subkeys * sizeof(*new_subkeys) )))
         {
             set_error( STATUS_NO_MEMORY );
             return 0;
@@ -331,32 +563,40 @@ static int grow_subkeys( struct key *key )
         nb_subkeys = MIN_SUBKEYS;
         if (!(new_subkeys = mem_alloc( nb_subkeys * sizeof(*new_subkeys) ))) return 0;
     }
-    key->subkeys    = new_subkeys;
+    key->subkeys    = new_subkeys + key->subkey_gap;
     key->nb_subkeys = nb_subkeys;
     return 1;
 }
 
+/* save the name and options of a key to a text file */
+static void save_key_header( const struct key *key, const struct key *base, FILE *f )
+{
+    fprintf( f, "\n[" );
+    if (key != base) dump_path( key, base, f );
+    fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
+    fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
+    if (key->class)
+    {
+        fprintf( f, "#class=\"" );
+        dump_strW( key->class, key->classlen, f, "\"\"" );
+        fprintf( f, "\"\n" );
+    }
+    if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+}
+
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    sort_subkeys( key );
+    sort_values( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
     {
-        fprintf( f, "\n[" );
-        if (key != base) dump_path( key, base, f );
-        fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
-        fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
-        if (key->class)
-        {
-            fprintf( f, "#class=\"" );
-            dump_strW( key->class, key->classlen, f, "\"\"" );
-            fprintf( f, "\"\n" );
-        }
-        if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+        save_key_header( key, base, f );
         for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
     }
     for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
@@ -583,10 +823,13 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
         return 0;
     }
 
-    if (parent_key->last_subkey + 1 == parent_key->nb_subkeys)
+    if (!grow_subkeys( parent_key )) return 0;
+    /* the object name of the new key is only set once we return, so index the existing subkeys first */
+    if (!parent_key->subkey_hash && parent_key->last_subkey + 2 >= MIN_HASHED) hash_subkeys( parent_key );
+    if (parent_key->subkey_hash && !grow_name_hash( &parent_key->subkey_hash ))
     {
-        /* need to grow the array */
-        if (!grow_subkeys( parent_key )) return 0;
+        set_error( STATUS_NO_MEMORY );
+        return 0;
     }
     tmp.str = name->name;
     tmp.len = name->len;
@@ -595,6 +838,14 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
     for (i = ++parent_key->last_subkey; i > index; i--)
         parent_key->subkeys[i] = parent_key->subkeys[i - 1];
     parent_key->subkeys[index] = (struct key *)grab_object( key );
+    if (parent_key->subkey_hash)
+    {
+        name_hash_add( parent_key->subkey_hash, get_name_hash( name->name, name->len ),
+                       parent_key->subkey_gap + index );
+        if (index && compare_names( parent_key->subkeys[index - 1]->obj.name->name,
+                                    parent_key->subkeys[index - 1]->obj.name->len, name->name, name->len ) > 0)
+            parent_key->subkey_hash->sorted = 0;
+    }
     if (is_wow6432node( name->name, name->len ) &&
         !is_wow6432node( parent_key->obj.name->name, parent_key->obj.name->len ))
         parent_key->wow6432node = key;
@@ -602,6 +853,17 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
     return 1;
 }
 
+/* move a subkey to another position of the array, keeping the hash index up to date */
+static void move_subkey( struct key *key, int from, int to )
+{
+    const struct object_name *name = key->subkeys[from]->obj.name;
+
+    key->subkeys[to] = key->subkeys[from];
+    if (key->subkey_hash)
+        name_hash_move( key->subkey_hash, get_name_hash( name->name, name->len ),
+                        key->subkey_gap + from, key->subkey_gap + to );
+}
+
 static void key_unlink_name( struct object *obj, struct object_name *name )
 {
     struct key *key = (struct key *)obj;
@@ -616,9 +878,34 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
         return;
     }
 
-    for (i = 0; i <= parent->last_subkey; i++) if (parent->subkeys[i] == key) break;
-    assert( i <= parent->last_subkey );
-    for ( ; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+    if (parent->subkey_hash)
+    {
+        /* the object name has already been cleared, so look for the key itself in the probe sequence */
+        const struct name_hash *hash = parent->subkey_hash;
+        unsigned int j, name_hash = get_name_hash( name->name, name->len );
+
+        for (j = name_hash & (hash->size - 1); ; j = (j + 1) & (hash->size - 1))
+        {
+            assert( hash->slots[j].index != -1 );
+            if (parent->subkeys[hash->slots[j].index - parent->subkey_gap] == key) break;
+        }
+        i = hash->slots[j].index - parent->subkey_gap;
+        name_hash_remove( parent->subkey_hash, name_hash, parent->subkey_gap + i );
+    }
+    else
+    {
+        for (i = 0; i <= parent->last_subkey; i++) if (parent->subkeys[i] == key) break;
+        assert( i <= parent->last_subkey );
+    }
+
+    /* close the hole by moving the shorter side of the array */
+    if (i < parent->last_subkey - i)
+    {
+        for ( ; i > 0; i--) move_subkey( parent, i - 1, i );
+        parent->subkeys++;
+        parent->subkey_gap++;
+    }
+    else for ( ; i < parent->last_subkey; i++) move_subkey( parent, i + 1, i );
     parent->last_subkey--;
     name->parent = NULL;
     if (parent->wow6432node == key) parent->wow6432node = NULL;
@@ -631,6 +918,7 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
         struct key **new_subkeys;
         nb_subkeys -= nb_subkeys / 3;  /* shrink by 33% */
         if (nb_subkeys < MIN_SUBKEYS) nb_subkeys = MIN_SUBKEYS;
+        compact_subkeys( parent );
         if (!(new_subkeys = realloc( parent->subkeys, nb_subkeys * sizeof(*new_subkeys) ))) return;
         parent->subkeys = new_subkeys;
         parent->nb_subkeys = nb_subkeys;
@@ -659,13 +947,15 @@ static void key_destroy( struct object *obj )
         free( key->values[i].name );
         free( key->values[i].data );
     }
-    free( key->values );
+    free( key->values - key->value_gap );
+    free( key->value_hash );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->obj.name->parent = NULL;
         release_object( key->subkeys[i] );
     }
-    free( key->subkeys );
+    free( key->subkeys - key->subkey_gap );
+    free( key->subkey_hash );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -693,11 +983,15 @@ static struct key *create_key_object( struct object *parent, const struct unicod
             key->flags       = 0;
             key->last_subkey = -1;
             key->nb_subkeys  = 0;
+            key->subkey_gap  = 0;
             key->subkeys     = NULL;
+            key->subkey_hash = NULL;
             key->wow6432node = NULL;
             key->nb_values   = 0;
             key->last_value  = -1;
+            key->value_gap   = 0;
             key->values      = NULL;
+            key->value_hash  = NULL;
             key->modif       = modif;
             list_init( &key->notify_list );
 
@@ -738,6 +1032,99 @@ static void make_clean( struct key *key )
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
+/* find the saved branch containing a key */
+static struct save_branch_info *get_save_branch( const struct key *key )
+{
+    int i;
+
+    for ( ; key; key = get_parent( key ))
+    {
+        if (key->flags & KEY_VOLATILE) return NULL;
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].key == key) return &save_branch_info[i];
+    }
+    return NULL;
+}
+
+/* start a journal record for a change of a key, return NULL if the change isn't journaled */
+static struct save_branch_info *begin_journal_record( struct key *key, int force_header )
+{
+    struct save_branch_info *branch = get_save_branch( key );
+
+    if (!branch || !branch->journal || branch->full_save) return NULL;
+    if (force_header || branch->last_key != key || branch->last_modif != key->modif)
+    {
+        if (branch->last_key) release_object( branch->last_key );
+        branch->last_key = (struct key *)grab_object( key );
+        branch->last_modif = key->modif;
+        save_key_header( key, branch->key, branch->journal );
+    }
+    return branch;
+}
+
+/* finish a journal record, falling back to a full save on errors */
+static void end_journal_record( struct save_branch_info *branch )
+{
+    if (!ferror( branch->journal )) return;
+    if (debug_level) fprintf( stderr, "%s: write error, saving the full branch\n", branch->journal_path );
+    branch->full_save = 1;
+}
+
+/* record the creation or the options of a key in the journal */
+static void journal_key( struct key *key )
+{
+    struct save_branch_info *branch;
+
+    if (!(branch = begin_journal_record( key, 1 ))) return;
+    end_journal_record( branch );
+}
+
+/* record the deletion of a key in the journal */
+static void journal_delete_key( struct key *key )
+{
+    struct save_branch_info *branch;
+
+    if (!(branch = begin_journal_record( key, 1 ))) return;
+    fputs( "#delete\n", branch->journal );
+    release_object( branch->last_key );
+    branch->last_key = NULL;
+    end_journal_record( branch );
+}
+
+/* record the new contents of a value in the journal */
+static void journal_value( struct key *key, const struct key_value *value )
+{
+    struct save_branch_info *branch;
+
+    if (!(branch = begin_journal_record( key, 0 ))) return;
+    dump_value( value, branch->journal );
+    end_journal_record( branch );
+}
+
+/* record the deletion of a value in the journal */
+static void journal_delete_value( struct key *key, const struct unicode_str *name )
+{
+    struct save_branch_info *branch;
+
+    if (!(branch = begin_journal_record( key, 0 ))) return;
+    if (name->len)
+    {
+        fputc( '\"', branch->journal );
+        dump_strW( name->str, name->len, branch->journal, "\"\"" );
+        fputs( "\"=-\n", branch->journal );
+    }
+    else fputs( "@=-\n", branch->journal );
+    end_journal_record( branch );
+}
+
+/* the branch containing a key has changes that can't be journaled */
+static void invalidate_journal( const struct key *key )
+{
+    struct save_branch_info *branch = get_save_branch( key );
+
+    if (branch) branch->full_save = 1;
+}
+
 /* go through all the notifications and send them if necessary */
 static void check_notify( struct key *key, unsigned int change, int not_subtree )
 {
@@ -829,6 +1216,7 @@ static struct key *create_key( struct key *parent, const struct unicode_str *nam
     {
         if (parent) touch_key( get_parent( key ), REG_NOTIFY_CHANGE_NAME );
         if (debug_level > 1) dump_operation( key, NULL, "Create" );
+        journal_key( key );
     }
     return key;
 }
@@ -885,6 +1273,7 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
 
@@ -996,25 +1385,43 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
     new_name_ptr->parent = &parent->obj;
     memcpy( new_name_ptr->name, new_name->str, new_name->len );
 
-    for (cur_index = 0; cur_index <= parent->last_subkey; cur_index++)
-        if (parent->subkeys[cur_index] == key) break;
-
-    if (cur_index < index && (index - cur_index) > 1)
+    if (parent->subkey_hash)
     {
-        --index;
-        for (i = cur_index; i < index; ++i) parent->subkeys[i] = parent->subkeys[i+1];
+        /* keep the current position, the array gets sorted again when needed */
+        struct unicode_str old_name;
+
+        old_name.str = key->obj.name->name;
+        old_name.len = key->obj.name->len;
+        find_subkey( parent, &old_name, &cur_index );
+        name_hash_remove( parent->subkey_hash, get_name_hash( old_name.str, old_name.len ),
+                          parent->subkey_gap + cur_index );
+        name_hash_add( parent->subkey_hash, get_name_hash( new_name->str, new_name->len ),
+                       parent->subkey_gap + cur_index );
+        parent->subkey_hash->sorted = 0;
     }
-    else if (cur_index > index)
+    else
     {
-        for (i = cur_index; i > index; --i) parent->subkeys[i] = parent->subkeys[i-1];
+        for (cur_index = 0; cur_index <= parent->last_subkey; cur_index++)
+            if (parent->subkeys[cur_index] == key) break;
+
+        if (cur_index < index && (index - cur_index) > 1)
+        {
+            --index;
+            for (i = cur_index; i < index; ++i) parent->subkeys[i] = parent->subkeys[i+1];
+        }
+        else if (cur_index > index)
+        {
+            for (i = cur_index; i > index; --i) parent->subkeys[i] = parent->subkeys[i-1];
+        }
+        parent->subkeys[index] = key;
     }
-    parent->subkeys[index] = key;
 
     free( key->obj.name );
     key->obj.name = new_name_ptr;
 
     if (debug_level > 1) dump_operation( key, NULL, "Rename" );
     touch_key( key, REG_NOTIFY_CHANGE_NAME );
+    invalidate_journal( key );
 }
 
 /* delete a key and its values */
@@ -1047,22 +1454,44 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
+    journal_delete_key( key );
     key->flags |= KEY_DELETED;
     unlink_named_object( &key->obj );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
     return 1;
 }
 
-/* try to grow the array of values; return 1 if OK, 0 on error */
+/* move the values to the start of the allocated array */
+static void compact_values( struct key *key )
+{
+    struct key_value *base = key->values - key->value_gap;
+
+    if (!key->value_gap) return;
+    memmove( base, key->values, (key->last_value + 1) * sizeof(*base) );
+    if (key->value_hash) name_hash_rebase( key->value_hash, -key->value_gap );
+    key->values    = base;
+    key->value_gap = 0;
+}
+
+/* make room for one more value at the end of the array; return 1 if OK, 0 on error */
 static int grow_values( struct key *key )
 {
     struct key_value *new_val;
     int nb_values;
 
+    if (key->value_gap + key->last_value + 1 < key->nb_values) return 1;
+
+    /* reuse the space left by values removed from the start if there is enough of it */
+    if (key->value_gap && key->value_gap >= (key->last_value + 1) / 2)
+    {
+        compact_values( key );
+        return 1;
+    }
+
     if (key->nb_values)
     {
         nb_values = key->nb_values + (key->nb_values / 2);  /* grow by 50% */
-        if (!(new_val = realloc( key->values, nb_values * sizeof(*new_val) )))
+        if (!(new_val = realloc( key->values - key->value_gap, nb_values * sizeof(*new_val) )))
         {
             set_error( STATUS_NO_MEMORY );
             return 0;
@@ -1073,7 +1502,7 @@ static int grow_values( struct key *key )
         nb_values = MIN_VALUES;
         if (!(new_val = mem_alloc( nb_values * sizeof(*new_val) ))) return 0;
     }
-    key->values = new_val;
+    key->values = new_val + key->value_gap;
     key->nb_values = nb_values;
     return 1;
 }
@@ -1084,6 +1513,24 @@ static struct key_value *find_value( const struct key *key, const struct unicode
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_hash)
+    {
+        const struct name_hash *hash = key->value_hash;
+        unsigned int name_hash = get_name_hash( name->str, name->len );
+        const struct key_value *value;
+
+        for (i = name_hash & (hash->size - 1); hash->slots[i].index != -1; i = (i + 1) & (hash->size - 1))
+        {
+            if (hash->slots[i].hash != name_hash) continue;
+            value = &key->values[hash->slots[i].index - key->value_gap];
+            if (compare_names( value->name, value->namelen, name->str, name->len )) continue;
+            *index = hash->slots[i].index - key->value_gap;
+            return &key->values[*index];
+        }
+        *index = key->last_value + 1;  /* new values are appended */
+        return NULL;
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1116,9 +1563,11 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
         set_error( STATUS_NAME_TOO_LONG );
         return NULL;
     }
-    if (key->last_value + 1 == key->nb_values)
+    if (!grow_values( key )) return NULL;
+    if (key->value_hash && !grow_name_hash( &key->value_hash ))
     {
-        if (!grow_values( key )) return NULL;
+        set_error( STATUS_NO_MEMORY );
+        return NULL;
     }
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
     for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
@@ -1127,6 +1576,12 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    if (key->value_hash)
+    {
+        name_hash_add( key->value_hash, get_name_hash( name->str, name->len ), key->value_gap + index );
+        if (index && compare_values( value - 1, value ) > 0) key->value_hash->sorted = 0;
+    }
+    else if (key->last_value + 1 >= MIN_HASHED) hash_values( key );
     return value;
 }
 
@@ -1182,6 +1637,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
     value->data  = ptr;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
     if (debug_level > 1) dump_operation( key, value, "Set" );
+    journal_value( key, value );
 }
 
 /* get a key value */
@@ -1227,6 +1683,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         void *data;
         data_size_t namelen, maxlen;
 
+        sort_values( key );
         value = &key->values[i];
         reply->type = value->type;
         namelen = value->namelen;
@@ -1267,29 +1724,37 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
     }
 }
 
-/* delete a value */
-static void delete_value( struct key *key, const struct unicode_str *name )
+/* move a value to another position of the array, keeping the hash index up to date */
+static void move_value( struct key *key, int from, int to )
 {
-    struct key_value *value;
-    int i, index, nb_values;
+    const struct key_value *value = &key->values[from];
 
-    if (key->flags & KEY_PREDEF)
-    {
-        set_error( STATUS_INVALID_HANDLE );
-        return;
-    }
+    if (key->value_hash)
+        name_hash_move( key->value_hash, get_name_hash( value->name, value->namelen ),
+                        key->value_gap + from, key->value_gap + to );
+    key->values[to] = key->values[from];
+}
 
-    if (!(value = find_value( key, name, &index )))
-    {
-        set_error( STATUS_OBJECT_NAME_NOT_FOUND );
-        return;
-    }
-    if (debug_level > 1) dump_operation( key, value, "Delete" );
+/* remove a value from the values array of a key */
+static void remove_value( struct key *key, int index )
+{
+    struct key_value *value = &key->values[index];
+    int i, nb_values;
+
+    if (key->value_hash)
+        name_hash_remove( key->value_hash, get_name_hash( value->name, value->namelen ), key->value_gap + index );
     free( value->name );
     free( value->data );
-    for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
+
+    /* close the hole by moving the shorter side of the array */
+    if (index < key->last_value - index)
+    {
+        for (i = index; i > 0; i--) move_value( key, i - 1, i );
+        key->values++;
+        key->value_gap++;
+    }
+    else for (i = index; i < key->last_value; i++) move_value( key, i + 1, i );
     key->last_value--;
-    touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
     /* try to shrink the array */
     nb_values = key->nb_values;
@@ -1298,12 +1763,36 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         struct key_value *new_val;
         nb_values -= nb_values / 3;  /* shrink by 33% */
         if (nb_values < MIN_VALUES) nb_values = MIN_VALUES;
+        compact_values( key );
         if (!(new_val = realloc( key->values, nb_values * sizeof(*new_val) ))) return;
         key->values = new_val;
         key->nb_values = nb_values;
     }
 }
 
+/* delete a value */
+static void delete_value( struct key *key, const struct unicode_str *name )
+{
+    struct key_value *value;
+    int index;
+
+    if (key->flags & KEY_PREDEF)
+    {
+        set_error( STATUS_INVALID_HANDLE );
+        return;
+    }
+
+    if (!(value = find_value( key, name, &index )))
+    {
+        set_error( STATUS_OBJECT_NAME_NOT_FOUND );
+        return;
+    }
+    if (debug_level > 1) dump_operation( key, value, "Delete" );
+    remove_value( key, index );
+    touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
+    journal_delete_value( key, name );
+}
+
 /* get the registry key corresponding to an hkey handle */
 static struct key *get_hkey_obj( obj_handle_t hkey, unsigned int access )
 {
@@ -1504,7 +1993,9 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
             else if (*p >= 'a' && *p <= 'f') modif = (modif << 4) | (*p - 'a' + 10);
             else break;
         }
-        update_key_time( key, modif );
+        /* journal records contain the current time of existing keys */
+        if (info->journal) key->modif = modif;
+        else update_key_time( key, modif );
     }
     if (!strncmp( buffer, "#class=", 7 ))
     {
@@ -1518,6 +2009,7 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
         key->classlen = len;
     }
     if (!strncmp( buffer, "#link", 5 )) key->flags |= KEY_SYMLINK;
+    if (info->journal && !strcmp( buffer, "#delete" )) delete_key( key, 1 );
     /* ignore unknown options */
     return 1;
 }
@@ -1589,6 +2081,12 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     struct key_value *value;
 
     if (!(value = parse_value_name( key, buffer, &len, info ))) return 0;
+    if (info->journal && !strcmp( buffer + len, "-" ))
+    {
+        /* value deleted after the last save */
+        remove_value( key, value - key->values );
+        return 1;
+    }
     if (!(res = get_data_type( buffer + len, &type, &parse_type ))) goto error;
     buffer += len + res;
 
@@ -1676,7 +2174,7 @@ static int get_prefix_len( struct key *key, const char *name, struct file_load_i
 
 /* load all the keys from the input file */
 /* prefix_len is the number of key name prefixes to skip, or -1 for autodetection */
-static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len )
+static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len, int journal )
 {
     struct key *subkey = NULL;
     struct file_load_info info;
@@ -1684,6 +2182,7 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     char *p;
 
     info.filename = filename;
+    info.journal  = journal;
     info.file   = f;
     info.len    = 4;
     info.tmplen = 4;
@@ -1753,6 +2252,7 @@ static void load_registry( struct key *key, obj_handle_t handle )
     int fd;
 
     if (!(file = get_file_obj( current->process, handle, FILE_READ_DATA ))) return;
+    invalidate_journal( key );
     fd = dup( get_file_unix_fd( file ) );
     release_object( file );
     if (fd != -1)
@@ -1760,21 +2260,55 @@ static void load_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "r" );
         if (f)
         {
-            load_keys( key, NULL, f, -1 );
+            load_keys( key, NULL, f, -1, 0 );
             fclose( f );
         }
         else file_set_error();
     }
 }
 
+/* open the journal of a branch, discarding its previous contents */
+static void reset_journal( struct save_branch_info *info )
+{
+    if (info->last_key) release_object( info->last_key );
+    info->last_key = NULL;
+    if (info->journal) fclose( info->journal );
+    if ((info->journal = fopen( info->journal_path, "w" )))
+    {
+        fprintf( info->journal, "WINE REGISTRY Version 2\n" );
+        fprintf( info->journal, ";; Changes since the last save of %s\n", info->path );
+        fflush( info->journal );
+    }
+    else if (debug_level) fprintf( stderr, "%s: cannot open journal\n", info->journal_path );
+}
+
+/* replay the changes of a journal file that were not saved yet, they get merged on the next save */
+static void load_journal( struct save_branch_info *info, const char *path )
+{
+    struct stat st;
+    FILE *journal;
+
+    if (!(journal = fopen( path, "r" ))) return;
+    if (!fstat( fileno( journal ), &st ) && st.st_size > 0)
+    {
+        clear_error();
+        load_keys( info->key, path, journal, 0, 1 );
+        info->full_save = 1;
+        make_dirty( info->key );
+    }
+    fclose( journal );
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
+    struct save_branch_info *info;
+    struct stat st;
     FILE *f;
 
     if ((f = fopen( filename, "r" )))
     {
-        load_keys( key, filename, f, 0 );
+        load_keys( key, filename, f, 0, 0 );
         fclose( f );
         if (get_error() == STATUS_NOT_REGISTRY_FILE)
         {
@@ -1785,8 +2319,29 @@ static int load_init_registry_from_file( const char *filename, struct key *key )
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    info = &save_branch_info[save_branch_count];
+    memset( info, 0, sizeof(*info) );
+    info->path = filename;
+    info->key = (struct key *)grab_object( key );
+    if (!stat( filename, &st )) info->save_size = st.st_size;
+    if ((info->journal_path = malloc( strlen(filename) + 5 )) &&
+        (info->old_journal_path = malloc( strlen(filename) + 9 )))
+    {
+        sprintf( info->journal_path, "%s.log", filename );
+        sprintf( info->old_journal_path, "%s.log.old", filename );
+
+        /* a background save was interrupted, its changes come before the current journal */
+        info->old_journal = !access( info->old_journal_path, F_OK );
+        if (info->old_journal) load_journal( info, info->old_journal_path );
+        load_journal( info, info->journal_path );
+        if (!info->full_save) reset_journal( info );
+    }
+    else
+    {
+        free( info->journal_path );
+        info->journal_path = NULL;
+    }
+    save_branch_count++;
     make_object_permanent( &key->obj );
     return (f != NULL);
 }
@@ -2015,12 +2570,6 @@ static int save_branch( struct key *key, const char *path )
     int fd, count = 0, ret = 0;
     FILE *f;
 
-    if (!(key->flags & KEY_DIRTY))
-    {
-        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
-        return 1;
-    }
-
     /* test the file type */
 
     if ((fd = open( path, O_WRONLY )) != -1)
@@ -2077,19 +2626,168 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
     return ret;
 }
 
+/* flush the journal of a branch, and check if the whole branch needs to be saved */
+static int needs_full_save( struct save_branch_info *info )
+{
+    return (info->full_save || !info->journal || fflush( info->journal ) ||
+            ftell( info->journal ) >= max( info->save_size, MIN_JOURNAL_COMPACT_SIZE ));
+}
+
+/* a branch has been saved entirely, its journals are no longer needed */
+static void branch_saved( struct save_branch_info *info )
+{
+    struct stat st;
+
+    if (!stat( info->path, &st )) info->save_size = st.st_size;
+    if (info->old_journal && !unlink( info->old_journal_path )) info->old_journal = 0;
+}
+
+/* flush the journal of a branch, saving the whole branch when necessary */
+static int flush_branch( struct save_branch_info *info, int full_save )
+{
+    if (!full_save && !needs_full_save( info )) return 1;
+
+    if (info->key->flags & KEY_DIRTY)
+    {
+        if (!save_branch( info->key, info->path )) return 0;
+        make_clean( info->key );
+    }
+    else if (debug_level > 1) dump_operation( info->key, NULL, "Not saving clean" );
+    info->full_save = 0;
+    if (info->journal_path) reset_journal( info );
+    branch_saved( info );
+    return 1;
+}
+
+#ifdef USE_PTRACE
+
+/* save the branches that need it in a child process, so that requests keep being processed */
+static void start_background_save(void)
+{
+    struct save_branch_info *info;
+    int i, pid, fds[2], count = 0;
+    char status = 0;
+
+    for (i = 0; i < save_branch_count; i++)
+    {
+        info = &save_branch_info[i];
+        /* without a journal, the changes made during the save couldn't be recovered */
+        if (!info->journal_path || info->old_journal || !(info->key->flags & KEY_DIRTY)) continue;
+        if (!needs_full_save( info )) continue;
+        info->background_save = 1;
+        count++;
+    }
+    if (!count) return;
+
+    /* marking the keys clean after the fork would copy all their pages */
+    for (i = 0; i < save_branch_count; i++)
+        if (save_branch_info[i].background_save) make_clean( save_branch_info[i].key );
+
+    if (pipe( fds ) == -1) goto failed;
+    if ((pid = fork()) == -1)
+    {
+        close( fds[0] );
+        close( fds[1] );
+        goto failed;
+    }
+    if (!pid)
+    {
+        close( fds[0] );
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].background_save &&
+                save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+                status |= 1 << i;
+        write( fds[1], &status, 1 );
+        _exit( 0 );
+    }
+    close( fds[1] );
+    fcntl( fds[0], F_SETFD, FD_CLOEXEC );
+    background_save_fd = fds[0];
+
+    /* the child saves the current state, further changes go to a new journal */
+    for (i = 0; i < save_branch_count; i++)
+    {
+        info = &save_branch_info[i];
+        if (!info->background_save) continue;
+        if (debug_level > 1) fprintf( stderr, "%s: saving in process %d\n", info->path, pid );
+        info->full_save = 0;
+        if (info->journal && fclose( info->journal )) info->full_save = 1;
+        info->journal = NULL;
+        if (!rename( info->journal_path, info->old_journal_path )) info->old_journal = 1;
+        else if (errno != ENOENT) info->full_save = 1;
+        if (!info->full_save) reset_journal( info );
+    }
+    return;
+
+failed:
+    if (debug_level) fprintf( stderr, "wineserver: cannot start background save: %s\n", strerror( errno ));
+    for (i = 0; i < save_branch_count; i++)
+    {
+        if (!save_branch_info[i].background_save) continue;
+        save_branch_info[i].background_save = 0;
+        make_dirty( save_branch_info[i].key );
+    }
+}
+
+/* get the result of the background save, return 0 if it's still running and wait isn't set */
+static int finish_background_save( int wait )
+{
+    struct save_branch_info *info;
+    struct pollfd pfd;
+    char status = 0;
+    int i, ret;
+
+    if (background_save_fd == -1) return 1;
+    if (!wait)
+    {
+        pfd.fd = background_save_fd;
+        pfd.events = POLLIN;
+        if (poll( &pfd, 1, 0 ) <= 0) return 0;
+    }
+    while ((ret = read( background_save_fd, &status, 1 )) == -1 && errno == EINTR);
+    close( background_save_fd );
+    background_save_fd = -1;
+
+    for (i = 0; i < save_branch_count; i++)
+    {
+        info = &save_branch_info[i];
+        if (!info->background_save) continue;
+        info->background_save = 0;
+        if (ret == 1 && (status & (1 << i)))
+        {
+            branch_saved( info );
+            continue;
+        }
+        /* the old journal is kept until the next successful save */
+        if (debug_level) fprintf( stderr, "%s: background save failed\n", info->path );
+        info->full_save = 1;
+        make_dirty( info->key );
+    }
+    return 1;
+}
+
+#endif  /* USE_PTRACE */
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
+    struct save_branch_info *info;
     int i;
 
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
+#ifdef USE_PTRACE
+    if (finish_background_save( 0 )) start_background_save();
+#endif
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    {
+        info = &save_branch_info[i];
+        if (!info->background_save) flush_branch( info, 0 );
+        else if (info->journal) fflush( info->journal );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2107,9 +2805,12 @@ void flush_registry(void)
     int i;
 
     if (fchdir( config_dir_fd ) == -1) return;
+#ifdef USE_PTRACE
+    finish_background_save( 1 );
+#endif
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!flush_branch( &save_branch_info[i], 1 ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
@@ -2151,6 +2852,7 @@ DECL_HANDLER(create_key)
         {
             key->classlen = (key->classlen / sizeof(WCHAR)) * sizeof(WCHAR);
             if (!(key->class = memdup( class, key->classlen ))) key->classlen = 0;
+            journal_key( key );
         }
         reply->hkey = alloc_handle( current->process, key, access, objattr->attributes );
         release_object( key );
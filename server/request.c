@@ -293,6 +293,7 @@ static void call_req_handler( struct thread *thread )
 {
     union generic_reply reply;
     enum request req = thread->req.request_header.req;
+    timeout_t start = 0;
 
     current = thread;
     current->reply_size = 0;
@@ -300,12 +301,15 @@ static void call_req_handler( struct thread *thread )
     memset( &reply, 0, sizeof(reply) );
 
     if (debug_level) trace_request();
+    if (server_stats_enabled) start = begin_request_stats( thread );
 
     if (req < REQ_NB_REQUESTS)
         req_handlers[req]( &current->req, &reply );
     else
         set_error( STATUS_NOT_IMPLEMENTED );
 
+    if (start) end_request_stats( req, start );
+
     if (current)
     {
         if (current->reply_fd)
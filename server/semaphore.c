@@ -55,12 +55,14 @@ struct semaphore
     struct object  obj;    /* object header */
     unsigned int   count;  /* current count */
     unsigned int   max;    /* maximum possible count */
+    struct inproc_sync inproc;  /* in-process synchronization slot */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
@@ -83,7 +85,7 @@ static const struct object_ops semaphore_ops =
     no_open_file,                  /* open_file */
     no_kernel_obj_list,            /* get_kernel_obj_list */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -105,14 +107,26 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
             /* initialize it if it didn't already exist */
             sem->count = initial;
             sem->max   = max;
+            sem->inproc.page = NULL;
+            sem->inproc.index = 0;
+            sem->inproc.detached = 0;
         }
     }
     return sem;
 }
 
+/* take over the state of the semaphore from its in-process slot */
+static void semaphore_detach( struct semaphore *sem )
+{
+    __int64 value;
+
+    if (inproc_sync_detach( &sem->inproc, &value )) sem->count = value;
+}
+
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
+    semaphore_detach( sem );
     if (prev) *prev = sem->count;
     if (sem->count + count < sem->count || sem->count + count > sem->max)
     {
@@ -135,14 +149,21 @@ static int release_semaphore( struct semaphore *sem, unsigned int count,
 static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
+    __int64 value;
+
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d\n", sem->count, sem->max );
+    if (inproc_sync_peek( &sem->inproc, &value ))
+        fprintf( stderr, "Semaphore count=%d max=%d inproc=%u\n",
+                 (unsigned int)value, sem->max, sem->inproc.index );
+    else
+        fprintf( stderr, "Semaphore count=%d max=%d\n", sem->count, sem->max );
 }
 
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    semaphore_detach( sem );
     return (sem->count > 0);
 }
 
@@ -150,6 +171,7 @@ static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *en
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    semaphore_detach( sem );
     assert( sem->count );
     sem->count--;
 }
@@ -167,6 +189,13 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    inproc_sync_free( &sem->inproc );
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -183,8 +212,16 @@ DECL_HANDLER(create_semaphore)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, sem, req->access, objattr->attributes );
         else
+        {
+            /* only private objects with full access can be handled by the client */
+            int inproc = req->inproc && !name.len && !root && !(objattr->attributes & OBJ_INHERIT) &&
+                         (map_access( req->access, &semaphore_type.mapping ) & SEMAPHORE_ALL_ACCESS) == SEMAPHORE_ALL_ACCESS &&
+                         inproc_sync_alloc( &sem->inproc, INPROC_SYNC_SEMAPHORE, sem->count, sem->max );
+
             reply->handle = alloc_handle_no_access_check( current->process, sem,
                                                           req->access, objattr->attributes );
+            if (reply->handle && inproc) reply->inproc_index = sem->inproc.index;
+        }
         release_object( sem );
     }
 
@@ -221,6 +258,7 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
+        semaphore_detach( sem );
         reply->current = sem->count;
         reply->max = sem->max;
         release_object( sem );
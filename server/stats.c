@@ -0,0 +1,228 @@
+/*
+ * Server request statistics
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "process.h"
+#include "thread.h"
+#include "request.h"
+
+int server_stats_enabled = 0;
+
+static struct request_stats *req_stats;  /* per-request statistics, NULL if disabled */
+static timeout_t stats_reset_time;       /* absolute time of the last reset */
+
+/* return the log2 histogram bucket for a duration in ticks */
+static unsigned int get_hist_bucket( timeout_t ticks )
+{
+    unsigned int bucket = 0;
+
+    while (ticks > 0 && bucket < SERVER_STATS_HIST_SIZE - 1)
+    {
+        ticks >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static int reset_process_stats( struct process *process, void *arg )
+{
+    process->req_count = 0;
+    return 0;
+}
+
+static void reset_server_stats(void)
+{
+    unsigned int i;
+
+    memset( req_stats, 0, REQ_NB_REQUESTS * sizeof(*req_stats) );
+    for (i = 0; i < REQ_NB_REQUESTS; i++) req_stats[i].req = i;
+    enum_processes( reset_process_stats, NULL );
+    stats_reset_time = current_time;
+}
+
+/* start or stop collecting the request statistics */
+void enable_server_stats( int enable )
+{
+    if (enable && !req_stats)
+    {
+        if (!(req_stats = mem_alloc( REQ_NB_REQUESTS * sizeof(*req_stats) ))) return;
+        reset_server_stats();
+    }
+    else if (!enable && req_stats)
+    {
+        free( req_stats );
+        req_stats = NULL;
+    }
+    server_stats_enabled = (req_stats != NULL);
+}
+
+/* account for a request about to be handled, returns its start time */
+timeout_t begin_request_stats( struct thread *thread )
+{
+    thread->process->req_count++;
+    return monotonic_counter();
+}
+
+/* account for the time spent in a request handler */
+void end_request_stats( enum request req, timeout_t start )
+{
+    struct request_stats *stats;
+    timeout_t time = monotonic_counter() - start;
+
+    if (!req_stats || req >= REQ_NB_REQUESTS) return;
+
+    stats = &req_stats[req];
+    stats->count++;
+    stats->total_time += time;
+    stats->time_hist[get_hist_bucket( time )]++;
+    /* the queue wait is the time since the main loop woke up for this request */
+    stats->wait_hist[get_hist_bucket( start - monotonic_time )]++;
+}
+
+struct process_stats_data
+{
+    struct process_stats *stats;  /* buffer, NULL to compute the size */
+    data_size_t           size;   /* total size of the process statistics */
+};
+
+static int fill_process_stats( struct process *process, void *arg )
+{
+    struct process_stats_data *data = arg;
+    struct process_stats *stats;
+
+    if (!process->running_threads) return 0;
+    if (data->stats)
+    {
+        stats = (struct process_stats *)((char *)data->stats + data->size);
+        stats->pid     = process->id;
+        stats->count   = process->req_count;
+        stats->elapsed = current_time - max( process->start_time, stats_reset_time );
+    }
+    data->size += sizeof(*stats);
+    return 0;
+}
+
+static void dump_hist( const char *prefix, const unsigned int *hist )
+{
+    unsigned int i;
+
+    fprintf( stderr, "%s", prefix );
+    for (i = 0; i < SERVER_STATS_HIST_SIZE; i++)
+        if (hist[i]) fprintf( stderr, " %u:%u", i, hist[i] );
+}
+
+/* dump the request statistics to stderr */
+void dump_server_stats(void)
+{
+    struct process_stats_data data;
+    const struct request_stats *stats;
+    timeout_t elapsed;
+    unsigned int i;
+
+    if (!req_stats)
+    {
+        fprintf( stderr, "wineserver: request statistics are not enabled\n" );
+        return;
+    }
+
+    elapsed = current_time - stats_reset_time;
+    fprintf( stderr, "wineserver: request statistics over %u.%03u seconds\n",
+             (unsigned int)(elapsed / TICKS_PER_SEC), (unsigned int)(elapsed % TICKS_PER_SEC / 10000) );
+    fprintf( stderr, "wineserver: histograms are log2 buckets of 100ns ticks, as bucket:count\n" );
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+    {
+        stats = &req_stats[i];
+        if (!stats->count) continue;
+        fprintf( stderr, "%s: count=%u total=%uus avg=%uns", get_request_name( i ), stats->count,
+                 (unsigned int)(stats->total_time / 10), (unsigned int)(stats->total_time * 100 / stats->count) );
+        dump_hist( " time={", stats->time_hist );
+        dump_hist( " } wait={", stats->wait_hist );
+        fprintf( stderr, " }\n" );
+    }
+
+    data.stats = NULL;
+    data.size = 0;
+    enum_processes( fill_process_stats, &data );
+    if (!data.size || !(data.stats = malloc( data.size ))) return;
+    data.size = 0;
+    enum_processes( fill_process_stats, &data );
+
+    for (i = 0; i < data.size / sizeof(*data.stats); i++)
+    {
+        const struct process_stats *process = &data.stats[i];
+        unsigned int ms = process->elapsed / 10000;
+
+        fprintf( stderr, "process %04x: %u requests, %u/s\n", process->pid, process->count,
+                 ms ? (unsigned int)((unsigned __int64)process->count * 1000 / ms) : process->count );
+    }
+    free( data.stats );
+}
+
+/* retrieve the server request statistics */
+DECL_HANDLER(get_server_stats)
+{
+    struct process_stats_data data;
+    struct request_stats *stats;
+    unsigned int i;
+    char *ptr;
+
+    if (req->flags & SERVER_STATS_ENABLE) enable_server_stats( 1 );
+    if (req->flags & SERVER_STATS_DISABLE) enable_server_stats( 0 );
+    if ((req->flags & SERVER_STATS_RESET) && req_stats) reset_server_stats();
+
+    reply->enabled = server_stats_enabled;
+    if (!req_stats) return;
+
+    reply->elapsed = current_time - stats_reset_time;
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+        if (req_stats[i].count) reply->req_size += sizeof(*stats);
+
+    data.stats = NULL;
+    data.size = 0;
+    enum_processes( fill_process_stats, &data );
+
+    if (reply->req_size + data.size > get_reply_max_size())
+    {
+        set_error( STATUS_INFO_LENGTH_MISMATCH );
+        return;
+    }
+    if (!(ptr = set_reply_data_size( reply->req_size + data.size ))) return;
+
+    stats = (struct request_stats *)ptr;
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+        if (req_stats[i].count) *stats++ = req_stats[i];
+
+    data.stats = (struct process_stats *)(ptr + reply->req_size);
+    data.size = 0;
+    enum_processes( fill_process_stats, &data );
+}
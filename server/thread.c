@@ -67,6 +67,8 @@ struct thread_wait
     abstime_t               when;
     struct timeout_user    *user;
     int                     status;     /* status to return (unless STATUS_PENDING) */
+    object_wait_callback    callback;   /* callback for object waits, NULL for thread waits */
+    void                   *arg;        /* callback argument */
     struct wait_queue_entry queues[1];
 };
 
@@ -793,6 +795,7 @@ static int wait_on( const select_op_t *select_op, unsigned int count, struct obj
     wait->user    = NULL;
     wait->when = when;
     wait->abandoned = 0;
+    wait->callback = NULL;
     current->wait = wait;
 
     for (i = 0, entry = wait->queues; i < count; i++, entry++)
@@ -828,6 +831,66 @@ static int wait_on_handles( const select_op_t *select_op, unsigned int count, co
     return ret;
 }
 
+/* wait on a single object on behalf of a thread, calling a callback instead of waking the thread */
+struct thread_wait *add_object_wait( struct thread *thread, struct object *obj,
+                                     object_wait_callback callback, void *arg )
+{
+    struct thread_wait *wait;
+
+    if (!(wait = mem_alloc( sizeof(*wait) ))) return NULL;
+    wait->next      = NULL;
+    wait->thread    = (struct thread *)grab_object( thread );
+    wait->count     = 1;
+    wait->flags     = 0;
+    wait->select    = SELECT_WAIT;
+    wait->key       = 0;
+    wait->cookie    = 0;
+    wait->user      = NULL;
+    wait->when      = TIMEOUT_INFINITE;
+    wait->abandoned = 0;
+    wait->status    = STATUS_WAIT_0;
+    wait->callback  = callback;
+    wait->arg       = arg;
+    wait->queues[0].wait = wait;
+    if (!obj->ops->add_queue( obj, &wait->queues[0] ))
+    {
+        release_object( wait->thread );
+        free( wait );
+        return NULL;
+    }
+    return wait;
+}
+
+/* cancel an object wait */
+void remove_object_wait( struct thread_wait *wait )
+{
+    struct wait_queue_entry *entry = &wait->queues[0];
+
+    assert( wait->callback );
+    entry->obj->ops->remove_queue( entry->obj, entry );
+    release_object( wait->thread );
+    free( wait );
+}
+
+/* satisfy an object wait if the object is signaled; return 1 if the callback was called */
+int check_object_wait( struct thread_wait *wait )
+{
+    struct wait_queue_entry *entry = &wait->queues[0];
+    object_wait_callback callback = wait->callback;
+    void *arg = wait->arg;
+    unsigned int status;
+
+    assert( callback );
+    if (!entry->obj->ops->signaled( entry->obj, entry )) return 0;
+    /* there is no thread to give the ownership of a mutex to, so it is only observed */
+    if (entry->obj->ops->type != &mutex_type) entry->obj->ops->satisfied( entry->obj, entry );
+    status = wait->status;
+    if (wait->abandoned) status += STATUS_ABANDONED_WAIT_0;
+    remove_object_wait( wait );
+    callback( arg, status );
+    return 1;
+}
+
 /* check if the thread waiting condition is satisfied */
 static int check_wait( struct thread *thread )
 {
@@ -1065,7 +1128,9 @@ void wake_up( struct object *obj, int max )
     LIST_FOR_EACH( ptr, &obj->wait_queue )
     {
         struct wait_queue_entry *entry = LIST_ENTRY( ptr, struct wait_queue_entry, entry );
-        if (!(ret = wake_thread( get_wait_queue_thread( entry )))) continue;
+        if (entry->wait->callback) ret = check_object_wait( entry->wait );
+        else ret = wake_thread( get_wait_queue_thread( entry ));
+        if (!ret) continue;
         if (ret > 0 && max && !--max) break;
         /* restart at the head of the list since a wake up can change the object wait queue */
         ptr = &obj->wait_queue;
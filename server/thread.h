@@ -32,6 +32,8 @@ struct debug_obj;
 struct debug_event;
 struct msg_queue;
 
+typedef void (*object_wait_callback)( void *arg, unsigned int status );
+
 enum run_state
 {
     RUNNING,    /* running normally */
@@ -110,6 +112,10 @@ extern void set_wait_status( struct wait_queue_entry *entry, int status );
 extern void stop_thread( struct thread *thread );
 extern int wake_thread( struct thread *thread );
 extern int wake_thread_queue_entry( struct wait_queue_entry *entry );
+extern struct thread_wait *add_object_wait( struct thread *thread, struct object *obj,
+                                            object_wait_callback callback, void *arg );
+extern void remove_object_wait( struct thread_wait *wait );
+extern int check_object_wait( struct thread_wait *wait );
 extern int add_queue( struct object *obj, struct wait_queue_entry *entry );
 extern void remove_queue( struct object *obj, struct wait_queue_entry *entry );
 extern void kill_thread( struct thread *thread, int violent_death );
@@ -22,6 +22,8 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -30,6 +32,8 @@
 #include "ntuser.h"
 
 #include "object.h"
+#include "file.h"
+#include "handle.h"
 #include "request.h"
 #include "thread.h"
 #include "process.h"
@@ -201,6 +205,72 @@ static inline int is_desktop_window( const struct window *win )
     return !win->parent;  /* only desktop windows have no parent */
 }
 
+static struct window_shm *window_shm;  /* shared window data, NULL until requested */
+static int window_shm_fd = -1;
+
+static inline struct window_shm *get_window_shm_entry( user_handle_t handle )
+{
+    return &window_shm[((handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+}
+
+/* publish the window data in the shared memory */
+static void update_window_shm( struct window *win )
+{
+    struct window_shm *shm;
+
+    if (!window_shm || !win->handle) return;
+
+    shm = get_window_shm_entry( win->handle );
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+    shm->handle      = win->handle;
+    shm->tid         = win->thread ? get_thread_id( win->thread ) : 0;
+    shm->pid         = win->thread ? get_process_id( win->thread->process ) : 0;
+    shm->parent      = win->parent ? win->parent->handle : 0;
+    shm->owner       = win->owner;
+    shm->style       = win->style;
+    shm->ex_style    = win->ex_style;
+    shm->dpi         = win->dpi;
+    shm->window_rect = win->window_rect;
+    shm->client_rect = win->client_rect;
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+}
+
+/* mark the shared window data entry as free */
+static void clear_window_shm( struct window *win )
+{
+    struct window_shm *shm;
+
+    if (!window_shm || !win->handle) return;
+
+    shm = get_window_shm_entry( win->handle );
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+    shm->handle = 0;
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+}
+
+/* create the shared memory and publish the existing windows */
+static int init_window_shm(void)
+{
+    const data_size_t size = WINDOW_SHM_COUNT * sizeof(*window_shm);
+    user_handle_t handle = 0;
+    struct window *win;
+    void *ptr;
+    int fd;
+
+    if (window_shm) return 1;
+    if ((fd = create_temp_file( size )) == -1) return 0;
+    if ((ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        close( fd );
+        return 0;
+    }
+    window_shm = ptr;
+    window_shm_fd = fd;
+    while ((win = next_user_handle( &handle, USER_WINDOW ))) update_window_shm( win );
+    return 1;
+}
+
 /* check if window is orphaned */
 static int is_orphan_window( struct window *win )
 {
@@ -306,6 +376,7 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    update_window_shm( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -350,6 +421,7 @@ static int set_parent_window( struct window *win, struct window *parent )
         win->is_linked = 0;
         win->is_orphan = 1;
     }
+    update_window_shm( win );
     return 1;
 }
 
@@ -488,6 +560,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shm( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -1794,8 +1867,10 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->surface_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            update_window_shm( child );
         }
     }
+    update_window_shm( win );
 
     /* reset cursor clip rectangle when the desktop changes size */
     if (win == win->desktop->top_window) win->desktop->cursor.clip = *window_rect;
@@ -2011,6 +2086,7 @@ void free_window_handle( struct window *win )
     detach_window_thread( win );
 
     if (win->parent) set_parent_window( win, NULL );
+    clear_window_shm( win );
     free_user_handle( win->handle );
     win->handle = 0;
     release_object( win );
@@ -2066,6 +2142,7 @@ DECL_HANDLER(create_window)
     }
     win->style = req->style;
     win->ex_style = req->ex_style;
+    update_window_shm( win );
 
     reply->handle    = win->handle;
     reply->parent    = win->parent ? win->parent->handle : 0;
@@ -2077,6 +2154,26 @@ DECL_HANDLER(create_window)
 }
 
 
+/* get a handle to the shared memory where the window data is published */
+DECL_HANDLER(get_window_shm)
+{
+    struct file *file;
+    int fd;
+
+    if (!init_window_shm()) return;
+    if ((fd = dup( window_shm_fd )) == -1)
+    {
+        file_set_error();
+        return;
+    }
+    if ((file = create_file_for_fd( fd, FILE_READ_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE )))
+    {
+        reply->handle = alloc_handle( current->process, file, FILE_READ_DATA, 0 );
+        release_object( file );
+    }
+}
+
+
 /* set the parent of a window */
 DECL_HANDLER(set_parent)
 {
@@ -2133,6 +2230,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -2145,6 +2243,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -2180,6 +2279,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
 }
 
 
@@ -2254,6 +2354,7 @@ DECL_HANDLER(set_window_info)
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
+    if (req->flags & (SET_WIN_STYLE | SET_WIN_EXSTYLE)) update_window_shm( win );
 }
 
 